@@ -0,0 +1,918 @@
+// TitanKV Mini 压测工具
+// 多线程客户端，按配置的读写比例、键分布和值大小发送GET/SET，统计吞吐量和延迟分位数。
+// 两种模式：
+//   最大吞吐(闭环)：每个连接始终保持pipeline个未完成的请求，延迟从实际发送时算起；
+//   固定速率(开环，--rate)：请求按计划时间发出，延迟从计划时间算起。服务端变慢时请求来不及发出，
+//   排队的时间也计入延迟，避免协调遗漏(coordinated omission)让延迟看起来比实际好。
+#include "../include/metrics.h"
+#include "../include/resp.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 值大小分布中的一项：[min, max]内均匀分布，按weight加权选择
+struct SizeRange {
+    size_t min;
+    size_t max;
+    double weight;
+};
+
+// 压测配置
+struct BenchConfig {
+    std::string host;
+    int port;
+    size_t threads;
+    size_t connections;          // 总连接数，平均分给各线程
+    size_t pipeline;             // 每个连接最多未完成的请求数
+    double duration;             // 统计时长(秒)
+    double warmup;               // 预热时长(秒)，不计入统计
+    double read_ratio;           // GET的比例
+    uint64_t keyspace;           // 键的数量
+    std::vector<SizeRange> value_sizes;
+    bool zipf;                   // 键按Zipf分布选择(否则均匀)
+    double zipf_theta;
+    double rate;                 // 开环模式的总请求速率(次/秒)，0表示最大吞吐模式
+    bool resp;                   // RESP协议(否则文本协议)
+    bool prefill;                // 开始前写入所有键
+
+    BenchConfig()
+        : host("127.0.0.1"), port(6380), threads(4), connections(50), pipeline(1), duration(10), warmup(1),
+          read_ratio(0.9), keyspace(100000), value_sizes{{100, 100, 1}}, zipf(false), zipf_theta(0.99), rate(0),
+          resp(true), prefill(true) {}
+};
+
+// 单调时钟(纳秒)
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 每个线程一个的随机数生成器(xorshift64*)
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed ? seed : 0x9E3779B97F4A7C15ULL) {}
+
+    uint64_t next()
+    {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545F4914F6CDD1DULL;
+    }
+
+    // [0, 1)
+    double uniform() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // [0, n)
+    uint64_t below(uint64_t n) { return n ? next() % n : 0; }
+
+private:
+    uint64_t state_;
+};
+
+// Zipf分布的排名生成器(Gray等人的算法，与YCSB相同)，排名0最热
+// 构造时计算zeta(n)，需要O(n)时间，所有线程共享一个实例
+class ZipfGenerator {
+public:
+    ZipfGenerator(uint64_t n, double theta) : n_(n)
+    {
+        zetan_ = zeta(n, theta);
+        const double zeta2 = zeta(2, theta);
+        alpha_ = 1.0 / (1.0 - theta);
+        eta_ = (1.0 - std::pow(2.0 / static_cast<double>(n), 1.0 - theta)) / (1.0 - zeta2 / zetan_);
+        half_pow_theta_ = 1.0 + std::pow(0.5, theta);
+    }
+
+    uint64_t next(Random& random) const
+    {
+        const double u = random.uniform();
+        const double uz = u * zetan_;
+        if (uz < 1.0)
+        {
+            return 0;
+        }
+        if (uz < half_pow_theta_)
+        {
+            return 1;
+        }
+        uint64_t rank = static_cast<uint64_t>(static_cast<double>(n_) * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+        return rank < n_ ? rank : n_ - 1;
+    }
+
+private:
+    static double zeta(uint64_t n, double theta)
+    {
+        double sum = 0;
+        for (uint64_t i = 1; i <= n; ++i)
+        {
+            sum += 1.0 / std::pow(static_cast<double>(i), theta);
+        }
+        return sum;
+    }
+
+    uint64_t n_;
+    double zetan_;
+    double alpha_;
+    double eta_;
+    double half_pow_theta_;
+};
+
+// 排名打散到整个键空间，热点键不会集中在相邻的键(和同一个分片)上
+static uint64_t scramble(uint64_t rank, uint64_t n)
+{
+    uint64_t x = rank + 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x % n;
+}
+
+// 所有线程共享的统计
+struct BenchStats {
+    LatencyHistogram all;
+    LatencyHistogram get;
+    LatencyHistogram set;
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> late{0};       // 开环模式下晚于计划时间1ms以上才发出的请求
+    std::atomic<size_t> ready{0};        // 完成连接和预填充的线程数
+    std::atomic<bool> failed{false};
+};
+
+// 一个未完成的请求
+struct Pending {
+    int64_t start_ns;    // 延迟的起点：闭环为发送时间，开环为计划时间
+    bool read;
+    bool record;         // 是否计入统计(预填充的请求不计入)
+};
+
+// 一个到服务端的连接
+struct BenchConnection {
+    int fd;
+    std::string out;
+    size_t out_pos;
+    std::string in;
+    size_t in_pos;
+    std::deque<Pending> pending;
+    int64_t next_send_ns;    // 开环模式下一个请求的计划时间
+
+    BenchConnection() : fd(-1), out_pos(0), in_pos(0), next_send_ns(0) {}
+};
+
+// 响应的解析结果
+enum class Reply { INCOMPLETE, VALUE, MISS, ERROR };
+
+// 压测线程：管理自己的一组连接
+class Worker {
+public:
+    Worker(const BenchConfig& config, BenchStats& stats, const ZipfGenerator* zipf, const std::string& values,
+           size_t index, size_t first_conn, size_t conn_count)
+        : config_(config), stats_(stats), zipf_(zipf), values_(values), random_(0x1234567 + index * 7919),
+          first_conn_(first_conn), conns_(conn_count) {}
+
+    ~Worker()
+    {
+        for (BenchConnection& conn : conns_)
+        {
+            if (conn.fd >= 0)
+            {
+                close(conn.fd);
+            }
+        }
+    }
+
+    // 建立连接
+    void connect_all(const sockaddr_in& addr)
+    {
+        for (BenchConnection& conn : conns_)
+        {
+            conn.fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (conn.fd < 0 || connect(conn.fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+            {
+                throw std::runtime_error(std::string("connect failed: ") + strerror(errno));
+            }
+            int opt = 1;
+            setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+            fcntl(conn.fd, F_SETFL, fcntl(conn.fd, F_GETFL, 0) | O_NONBLOCK);
+        }
+    }
+
+    // 写入键[first, last)，每个连接保持pipeline个请求
+    void prefill(uint64_t first, uint64_t last)
+    {
+        uint64_t next = first;
+        while (next < last || has_pending())
+        {
+            for (BenchConnection& conn : conns_)
+            {
+                while (next < last && conn.pending.size() < config_.pipeline)
+                {
+                    append_set(conn, next++);
+                    conn.pending.push_back(Pending{0, false, false});
+                }
+            }
+            pump(-1, 0);
+        }
+    }
+
+    // 压测：measure_ns之后完成的请求计入统计，到end_ns停止发送并丢弃未完成的请求
+    void run(int64_t start_ns, int64_t measure_ns, int64_t end_ns)
+    {
+        const bool open_loop = config_.rate > 0;
+        // 每个连接的请求间隔，各连接的起始时间错开
+        const int64_t interval = open_loop ? static_cast<int64_t>(
+            1e9 * static_cast<double>(config_.connections) / config_.rate) : 0;
+        for (size_t i = 0; i < conns_.size(); ++i)
+        {
+            conns_[i].next_send_ns = start_ns + interval * static_cast<int64_t>(first_conn_ + i) /
+                static_cast<int64_t>(config_.connections);
+        }
+
+        for (;;)
+        {
+            const int64_t now = now_ns();
+            if (now >= end_ns)
+            {
+                return;
+            }
+
+            int64_t wake = end_ns;
+            for (BenchConnection& conn : conns_)
+            {
+                if (open_loop)
+                {
+                    // 计划时间已到的请求都发出，未完成的请求达到上限时推迟发送，延迟仍从计划时间算起
+                    while (conn.next_send_ns <= now && conn.pending.size() < config_.pipeline)
+                    {
+                        if (now - conn.next_send_ns > 1000000)
+                        {
+                            stats_.late.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        append_request(conn, conn.next_send_ns);
+                        conn.next_send_ns += interval;
+                    }
+                    if (conn.pending.size() < config_.pipeline)
+                    {
+                        wake = std::min(wake, conn.next_send_ns);
+                    }
+                }
+                else
+                {
+                    while (conn.pending.size() < config_.pipeline)
+                    {
+                        append_request(conn, now);
+                    }
+                }
+            }
+            pump(open_loop ? wake - now : end_ns - now, measure_ns);
+        }
+    }
+
+private:
+    bool has_pending() const
+    {
+        for (const BenchConnection& conn : conns_)
+        {
+            if (!conn.pending.empty())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 选一个键
+    uint64_t next_key()
+    {
+        if (zipf_)
+        {
+            return scramble(zipf_->next(random_), config_.keyspace);
+        }
+        return random_.below(config_.keyspace);
+    }
+
+    // 按分布选一个值大小
+    size_t next_value_size()
+    {
+        const std::vector<SizeRange>& sizes = config_.value_sizes;
+        size_t i = 0;
+        if (sizes.size() > 1)
+        {
+            double total = 0;
+            for (const SizeRange& r : sizes)
+            {
+                total += r.weight;
+            }
+            double x = random_.uniform() * total;
+            while (i + 1 < sizes.size() && x >= sizes[i].weight)
+            {
+                x -= sizes[i].weight;
+                ++i;
+            }
+        }
+        return sizes[i].min + static_cast<size_t>(random_.below(sizes[i].max - sizes[i].min + 1));
+    }
+
+    // 追加一个随机的GET或SET
+    void append_request(BenchConnection& conn, int64_t start_ns)
+    {
+        const bool read = random_.uniform() < config_.read_ratio;
+        const uint64_t key = next_key();
+        if (read)
+        {
+            append_get(conn, key);
+        }
+        else
+        {
+            append_set(conn, key);
+        }
+        conn.pending.push_back(Pending{start_ns, read, true});
+    }
+
+    // 键名"key:<编号>"
+    static size_t format_key(char* buf, uint64_t key)
+    {
+        return static_cast<size_t>(std::snprintf(buf, 32, "key:%llu", static_cast<unsigned long long>(key)));
+    }
+
+    void append_get(BenchConnection& conn, uint64_t key)
+    {
+        char buf[32];
+        size_t n = format_key(buf, key);
+        if (config_.resp)
+        {
+            RespWriter::array(conn.out, 2);
+            RespWriter::bulk(conn.out, "GET", 3);
+            RespWriter::bulk(conn.out, buf, n);
+        }
+        else
+        {
+            conn.out.append("GET ").append(buf, n).push_back('\n');
+        }
+    }
+
+    void append_set(BenchConnection& conn, uint64_t key)
+    {
+        char buf[32];
+        size_t n = format_key(buf, key);
+        size_t size = next_value_size();
+        if (config_.resp)
+        {
+            RespWriter::array(conn.out, 3);
+            RespWriter::bulk(conn.out, "SET", 3);
+            RespWriter::bulk(conn.out, buf, n);
+            RespWriter::bulk(conn.out, values_.data(), size);
+        }
+        else
+        {
+            conn.out.append("SET ").append(buf, n).push_back(' ');
+            conn.out.append(values_.data(), size).push_back('\n');
+        }
+    }
+
+    // 解析一个响应
+    Reply parse_reply(BenchConnection& conn)
+    {
+        const std::string& in = conn.in;
+        size_t eol = in.find('\n', conn.in_pos);
+        if (eol == std::string::npos)
+        {
+            return Reply::INCOMPLETE;
+        }
+        const char* line = in.data() + conn.in_pos;
+        const size_t line_size = eol - conn.in_pos;
+
+        if (!config_.resp)
+        {
+            // 文本协议每个响应一行
+            Reply reply = Reply::VALUE;
+            if (line_size == 9 && std::memcmp(line, "NOT_FOUND", 9) == 0)
+            {
+                reply = Reply::MISS;
+            }
+            else if (line_size >= 3 && std::memcmp(line, "ERR", 3) == 0)
+            {
+                reply = Reply::ERROR;
+            }
+            conn.in_pos = eol + 1;
+            return reply;
+        }
+
+        if (line[0] == '$')
+        {
+            long long len = std::strtoll(line + 1, nullptr, 10);
+            if (len < 0)
+            {
+                conn.in_pos = eol + 1;
+                return Reply::MISS;
+            }
+            const size_t end = eol + 1 + static_cast<size_t>(len) + 2;
+            if (in.size() < end)
+            {
+                return Reply::INCOMPLETE;
+            }
+            conn.in_pos = end;
+            return Reply::VALUE;
+        }
+        conn.in_pos = eol + 1;
+        return line[0] == '-' ? Reply::ERROR : Reply::VALUE;
+    }
+
+    // 处理收到的响应
+    void handle_replies(BenchConnection& conn, int64_t measure_ns)
+    {
+        const int64_t now = now_ns();
+        for (;;)
+        {
+            Reply reply = parse_reply(conn);
+            if (reply == Reply::INCOMPLETE)
+            {
+                break;
+            }
+            if (conn.pending.empty())
+            {
+                throw std::runtime_error("unexpected reply from server");
+            }
+            Pending p = conn.pending.front();
+            conn.pending.pop_front();
+            if (reply == Reply::ERROR)
+            {
+                stats_.errors.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (!p.record || now < measure_ns)
+            {
+                continue;
+            }
+            const uint64_t latency = static_cast<uint64_t>(std::max<int64_t>(now - p.start_ns, 0));
+            stats_.all.record(latency);
+            (p.read ? stats_.get : stats_.set).record(latency);
+            if (reply == Reply::MISS)
+            {
+                stats_.misses.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        // 已解析的部分超过一半时整体前移
+        if (conn.in_pos > 0 && conn.in_pos * 2 >= conn.in.size())
+        {
+            conn.in.erase(0, conn.in_pos);
+            conn.in_pos = 0;
+        }
+    }
+
+    // 发送缓冲区中的请求
+    void flush(BenchConnection& conn)
+    {
+        while (conn.out_pos < conn.out.size())
+        {
+            ssize_t n = send(conn.fd, conn.out.data() + conn.out_pos, conn.out.size() - conn.out_pos, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    return;
+                }
+                throw std::runtime_error(std::string("send failed: ") + strerror(errno));
+            }
+            conn.out_pos += static_cast<size_t>(n);
+        }
+        conn.out.clear();
+        conn.out_pos = 0;
+    }
+
+    // 发送请求，最多等待timeout_ns(负数表示一直等)，读取并处理响应
+    void pump(int64_t timeout_ns, int64_t measure_ns)
+    {
+        polls_.resize(conns_.size());
+        for (size_t i = 0; i < conns_.size(); ++i)
+        {
+            flush(conns_[i]);
+            polls_[i].fd = conns_[i].fd;
+            polls_[i].events = static_cast<short>(POLLIN | (conns_[i].out.empty() ? 0 : POLLOUT));
+            polls_[i].revents = 0;
+        }
+
+        timespec ts;
+        ts.tv_sec = timeout_ns / 1000000000;
+        ts.tv_nsec = timeout_ns % 1000000000;
+        int ready = ppoll(polls_.data(), polls_.size(), timeout_ns < 0 ? nullptr : &ts, nullptr);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                return;
+            }
+            throw std::runtime_error(std::string("poll failed: ") + strerror(errno));
+        }
+
+        char buffer[65536];
+        for (size_t i = 0; i < conns_.size() && ready > 0; ++i)
+        {
+            if (polls_[i].revents == 0)
+            {
+                continue;
+            }
+            --ready;
+            BenchConnection& conn = conns_[i];
+            if (polls_[i].revents & POLLOUT)
+            {
+                flush(conn);
+            }
+            if (!(polls_[i].revents & (POLLIN | POLLERR | POLLHUP)))
+            {
+                continue;
+            }
+            for (;;)
+            {
+                ssize_t n = recv(conn.fd, buffer, sizeof(buffer), 0);
+                if (n > 0)
+                {
+                    conn.in.append(buffer, static_cast<size_t>(n));
+                    continue;
+                }
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                {
+                    break;
+                }
+                throw std::runtime_error(n == 0 ? "server closed the connection" :
+                                         std::string("recv failed: ") + strerror(errno));
+            }
+            handle_replies(conn, measure_ns);
+        }
+    }
+
+    const BenchConfig& config_;
+    BenchStats& stats_;
+    const ZipfGenerator* zipf_;
+    const std::string& values_;
+    Random random_;
+    size_t first_conn_;                   // 第一个连接的全局序号(用于错开开环的起始时间)
+    std::vector<BenchConnection> conns_;
+    std::vector<pollfd> polls_;
+};
+
+// 值大小分布："100"(固定)、"16-1024"(均匀)，或用逗号分隔的加权组合"64:90,16384:10"
+static bool parse_value_sizes(const std::string& spec, std::vector<SizeRange>& sizes)
+{
+    sizes.clear();
+    size_t pos = 0;
+    while (pos <= spec.size())
+    {
+        size_t comma = spec.find(',', pos);
+        std::string item = spec.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+        SizeRange r = {0, 0, 1};
+        try {
+            size_t colon = item.find(':');
+            if (colon != std::string::npos)
+            {
+                r.weight = std::stod(item.substr(colon + 1));
+                item = item.substr(0, colon);
+            }
+            size_t dash = item.find('-');
+            r.min = std::stoul(item.substr(0, dash));
+            r.max = dash == std::string::npos ? r.min : std::stoul(item.substr(dash + 1));
+        } catch (const std::exception&) {
+            return false;
+        }
+        if (r.min == 0 || r.max < r.min || r.weight <= 0)
+        {
+            return false;
+        }
+        sizes.push_back(r);
+        if (comma == std::string::npos)
+        {
+            break;
+        }
+        pos = comma + 1;
+    }
+    return !sizes.empty();
+}
+
+// 显示帮助信息
+static void show_help()
+{
+    std::cout << "Usage: ./titankv_bench [options]\n";
+    std::cout << "\nOptions:\n";
+    std::cout << "  --host <addr>          - Server address (default 127.0.0.1)\n";
+    std::cout << "  --port <port>          - Server port (default 6380)\n";
+    std::cout << "  --threads <n>          - Client threads (default 4)\n";
+    std::cout << "  --connections <n>      - Total connections, spread over the threads (default 50)\n";
+    std::cout << "  --pipeline <n>         - Outstanding requests per connection (default 1)\n";
+    std::cout << "  --duration <seconds>   - Measured run time (default 10)\n";
+    std::cout << "  --warmup <seconds>     - Unmeasured run time before measuring (default 1)\n";
+    std::cout << "  --ratio <r>            - Fraction of GETs, the rest are SETs (default 0.9)\n";
+    std::cout << "  --keyspace <n>         - Number of distinct keys (default 100000)\n";
+    std::cout << "  --value-size <spec>    - 100 | 16-1024 (uniform) | 64:90,16384:10 (weighted mix) (default 100)\n";
+    std::cout << "  --dist <d>             - Key popularity: uniform | zipf (default uniform)\n";
+    std::cout << "  --zipf-theta <t>       - Zipf skew, 0 < t < 1 (default 0.99)\n";
+    std::cout << "  --rate <ops/s>         - Open-loop mode at a fixed total rate; latency is measured from the\n";
+    std::cout << "                           intended send time. 0 = closed-loop max throughput (default 0)\n";
+    std::cout << "  --protocol <p>         - resp | inline (default resp)\n";
+    std::cout << "  --prefill <on|off>     - SET every key before the run (default on)\n";
+}
+
+// 一行延迟统计(微秒)
+static void print_latency(const char* name, const LatencyHistogram& histogram)
+{
+    LatencyHistogram::Summary s = histogram.summary();
+    if (s.count == 0)
+    {
+        return;
+    }
+    std::printf("  %-5s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, static_cast<unsigned long long>(s.count),
+                static_cast<double>(s.sum) / static_cast<double>(s.count) / 1000.0, static_cast<double>(s.p50) / 1000.0,
+                static_cast<double>(s.p99) / 1000.0, static_cast<double>(s.p999) / 1000.0,
+                static_cast<double>(s.max) / 1000.0);
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h")
+        {
+            show_help();
+            return 0;
+        }
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Error: Option " << arg << " requires a value" << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+
+        try {
+            if (arg == "--host")
+            {
+                config.host = value;
+            }
+            else if (arg == "--port")
+            {
+                config.port = std::stoi(value);
+            }
+            else if (arg == "--threads")
+            {
+                config.threads = std::stoul(value);
+            }
+            else if (arg == "--connections")
+            {
+                config.connections = std::stoul(value);
+            }
+            else if (arg == "--pipeline")
+            {
+                config.pipeline = std::stoul(value);
+            }
+            else if (arg == "--duration")
+            {
+                config.duration = std::stod(value);
+            }
+            else if (arg == "--warmup")
+            {
+                config.warmup = std::stod(value);
+            }
+            else if (arg == "--ratio")
+            {
+                config.read_ratio = std::stod(value);
+            }
+            else if (arg == "--keyspace")
+            {
+                config.keyspace = std::stoull(value);
+            }
+            else if (arg == "--value-size")
+            {
+                if (!parse_value_sizes(value, config.value_sizes))
+                {
+                    std::cerr << "Error: Invalid value size distribution " << value << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--dist")
+            {
+                if (value != "uniform" && value != "zipf")
+                {
+                    std::cerr << "Error: --dist must be uniform or zipf" << std::endl;
+                    return 1;
+                }
+                config.zipf = value == "zipf";
+            }
+            else if (arg == "--zipf-theta")
+            {
+                config.zipf_theta = std::stod(value);
+            }
+            else if (arg == "--rate")
+            {
+                config.rate = std::stod(value);
+            }
+            else if (arg == "--protocol")
+            {
+                if (value != "resp" && value != "inline")
+                {
+                    std::cerr << "Error: --protocol must be resp or inline" << std::endl;
+                    return 1;
+                }
+                config.resp = value == "resp";
+            }
+            else if (arg == "--prefill")
+            {
+                if (value != "on" && value != "off")
+                {
+                    std::cerr << "Error: --prefill must be on or off" << std::endl;
+                    return 1;
+                }
+                config.prefill = value == "on";
+            }
+            else
+            {
+                std::cerr << "Error: Unknown option " << arg << std::endl;
+                return 1;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Error: Invalid value for " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (config.threads == 0 || config.connections == 0 || config.pipeline == 0 || config.keyspace == 0 ||
+        config.duration <= 0 || config.warmup < 0 || config.read_ratio < 0 || config.read_ratio > 1 ||
+        config.rate < 0 || config.zipf_theta <= 0 || config.zipf_theta >= 1)
+    {
+        std::cerr << "Error: Invalid configuration (see --help)" << std::endl;
+        return 1;
+    }
+    config.threads = std::min(config.threads, config.connections);
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(config.port));
+    if (inet_pton(AF_INET, config.host.c_str(), &addr.sin_addr) != 1)
+    {
+        hostent* host = gethostbyname(config.host.c_str());
+        if (!host || host->h_addrtype != AF_INET)
+        {
+            std::cerr << "Error: Cannot resolve " << config.host << std::endl;
+            return 1;
+        }
+        std::memcpy(&addr.sin_addr, host->h_addr_list[0], sizeof(addr.sin_addr));
+    }
+
+    size_t max_value = 0;
+    for (const SizeRange& r : config.value_sizes)
+    {
+        max_value = std::max(max_value, r.max);
+    }
+    const std::string values(max_value, 'x');
+
+    std::unique_ptr<ZipfGenerator> zipf;
+    if (config.zipf)
+    {
+        zipf.reset(new ZipfGenerator(config.keyspace, config.zipf_theta));
+    }
+
+    std::printf("TitanKV benchmark: %s:%d %s, %zu threads, %zu connections, pipeline %zu\n", config.host.c_str(),
+                config.port, config.resp ? "resp" : "inline", config.threads, config.connections, config.pipeline);
+    std::printf("Workload: %.0f%% GET, %llu keys %s", config.read_ratio * 100,
+                static_cast<unsigned long long>(config.keyspace), config.zipf ? "zipf" : "uniform");
+    if (config.zipf)
+    {
+        std::printf(" (theta %.2f)", config.zipf_theta);
+    }
+    std::printf(", value size");
+    for (size_t i = 0; i < config.value_sizes.size(); ++i)
+    {
+        const SizeRange& r = config.value_sizes[i];
+        std::printf(i ? ", %zu" : " %zu", r.min);
+        if (r.max != r.min)
+        {
+            std::printf("-%zu", r.max);
+        }
+        if (config.value_sizes.size() > 1)
+        {
+            std::printf(":%g", r.weight);
+        }
+    }
+    std::printf("\n");
+    if (config.rate > 0)
+    {
+        std::printf("Mode: open loop at %.0f ops/s (latency from intended send time)\n", config.rate);
+    }
+    else
+    {
+        std::printf("Mode: closed loop, max throughput\n");
+    }
+    std::fflush(stdout);
+
+    // 每个线程分到的连接数相差不超过1
+    BenchStats stats;
+    std::vector<std::unique_ptr<Worker>> workers;
+    size_t first_conn = 0;
+    for (size_t t = 0; t < config.threads; ++t)
+    {
+        size_t count = config.connections / config.threads + (t < config.connections % config.threads ? 1 : 0);
+        workers.emplace_back(new Worker(config, stats, zipf.get(), values, t, first_conn, count));
+        first_conn += count;
+    }
+
+    // 各线程连接并预填充自己那部分键，全部就绪后在同一时刻开始
+    std::atomic<int64_t> start_ns(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < config.threads; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            Worker& worker = *workers[t];
+            try {
+                worker.connect_all(addr);
+                if (config.prefill)
+                {
+                    uint64_t per = config.keyspace / config.threads;
+                    uint64_t first = per * t;
+                    worker.prefill(first, t + 1 == config.threads ? config.keyspace : first + per);
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                stats.failed = true;
+            }
+            stats.ready.fetch_add(1);
+            while (start_ns.load() == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            if (stats.failed)
+            {
+                return;
+            }
+            const int64_t start = start_ns.load();
+            const int64_t measure = start + static_cast<int64_t>(config.warmup * 1e9);
+            try {
+                worker.run(start, measure, measure + static_cast<int64_t>(config.duration * 1e9));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                stats.failed = true;
+            }
+        });
+    }
+    while (stats.ready.load() < config.threads)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    start_ns = now_ns();
+    for (std::thread& t : threads)
+    {
+        t.join();
+    }
+    if (stats.failed)
+    {
+        return 1;
+    }
+
+    LatencyHistogram::Summary all = stats.all.summary();
+    LatencyHistogram::Summary gets = stats.get.summary();
+    const uint64_t misses = stats.misses.load();
+    std::printf("\nThroughput: %.0f ops/s (%llu ops in %.1fs, errors %llu", static_cast<double>(all.count) / config.duration,
+                static_cast<unsigned long long>(all.count), config.duration,
+                static_cast<unsigned long long>(stats.errors.load()));
+    if (gets.count)
+    {
+        std::printf(", GET hit rate %.1f%%", 100.0 * static_cast<double>(gets.count - misses) / static_cast<double>(gets.count));
+    }
+    std::printf(")\n");
+    if (config.rate > 0 && stats.late.load())
+    {
+        std::printf("Warning: %llu requests were sent more than 1ms behind schedule (pipeline full)\n",
+                    static_cast<unsigned long long>(stats.late.load()));
+    }
+    std::printf("\nLatency (usec) %10s %10s %10s %10s %10s %10s\n", "count", "avg", "p50", "p99", "p99.9", "max");
+    print_latency("all", stats.all);
+    print_latency("GET", stats.get);
+    print_latency("SET", stats.set);
+    return 0;
+}
@@ -0,0 +1,909 @@
+// TitanKV Mini 微基准测试
+// 在进程内直接测量热点组件，不经过网络：
+//   store_*     KVStore的GET/SET/DEL和混合读写(不写WAL)，按线程数列表分别测量
+//   parse_*     ProtocolParser处理文本协议和RESP命令(解析+执行)，resp_decode只测RESP解析
+//   wal_*       WAL::log_set + sync(每次SET写日志的完整开销)，按持久化策略和写入方式分别测量
+//   replay      从合成的日志恢复(KVStore构造时的重放)，按记录数列表分别测量
+// 每个基准先预热，再重复测量多次，报告中位数、最小值、最大值和相对标准差；
+// 可以把线程绑定到指定CPU，结果可以输出为JSON，便于不同提交之间比较。
+#include "../include/kvstore.h"
+#include "../include/wal.h"
+#include "../include/wal_record.h"
+#include "../include/protocol_parser.h"
+#include "../include/output_buffer.h"
+#include "../include/resp.h"
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <algorithm>
+#include <charconv>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef BENCH_COMMIT
+#define BENCH_COMMIT "unknown"
+#endif
+
+// 微基准配置
+struct MicroConfig {
+    std::vector<size_t> threads;           // store_*的线程数列表
+    std::vector<size_t> wal_threads;       // wal_*的线程数列表
+    std::vector<std::string> wal_io;       // wal_*的写入方式列表
+    std::vector<uint64_t> replay_records;  // replay的记录数列表
+    uint64_t replay_keys;                  // 合成日志中不同键的数量(记录按顺序循环覆盖这些键)
+    size_t recovery_threads;               // 重放线程数，0表示CPU核数
+    size_t reps;                           // 测量次数
+    size_t warmup;                         // 预热次数
+    double seconds;                        // 每次测量的时长
+    uint64_t keys;                         // store_*和parse_*预先写入的键数
+    size_t value_size;
+    std::vector<int> cpus;                 // 第i个线程绑定到cpus[i % n]，为空时不绑定
+    std::string filter;                    // 只运行名称包含该字符串的基准
+    std::string json_path;                 // JSON结果文件，为空时不输出
+    std::string dir;                       // WAL和合成日志所在目录
+
+    MicroConfig()
+        : threads{1, 2, 4, 8, 16, 32, 64}, wal_threads{1, 4, 16}, wal_io{"sync"}, replay_records{1000000},
+          replay_keys(1000000), recovery_threads(0), reps(5), warmup(1), seconds(1.0), keys(1000000),
+          value_size(64), dir("microbench.tmp") {}
+};
+
+// 一个基准的结果
+struct BenchResult {
+    std::string name;
+    size_t threads;
+    std::vector<double> samples;   // 每次测量的吞吐(次/秒)
+    double bytes_per_op;           // 每次操作的字节数(用于计算MB/s)，0表示不适用
+};
+
+static MicroConfig config;
+static std::vector<BenchResult> results;
+
+// 单调时钟(秒)
+static double now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 把当前线程绑定到第index个配置的CPU
+static void pin_thread(size_t index)
+{
+    if (config.cpus.empty())
+    {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(config.cpus[index % config.cpus.size()], &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    {
+        std::cerr << "Warning: cannot pin thread to CPU " << config.cpus[index % config.cpus.size()] << std::endl;
+    }
+}
+
+// 每个线程一个的随机数生成器(xorshift64*)
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed ? seed : 0x9E3779B97F4A7C15ULL) {}
+
+    uint64_t next()
+    {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545F4914F6CDD1DULL;
+    }
+
+    uint64_t below(uint64_t n) { return next() % n; }
+
+private:
+    uint64_t state_;
+};
+
+// 键名"key:<编号>"，返回长度
+static size_t format_key(char* buf, uint64_t key)
+{
+    std::memcpy(buf, "key:", 4);
+    return static_cast<size_t>(std::to_chars(buf + 4, buf + 32, key).ptr - buf);
+}
+
+// 构造存储和重放日志时会打印恢复信息，测量期间屏蔽标准输出
+class QuietStdout {
+public:
+    QuietStdout() : saved_(std::cout.rdbuf(nullptr)) {}
+    ~QuietStdout()
+    {
+        std::cout.rdbuf(saved_);
+        std::cout.clear();
+    }
+
+private:
+    std::streambuf* saved_;
+};
+
+// 删除目录中的所有文件
+static void clear_dir(const std::string& dir)
+{
+    DIR* d = opendir(dir.c_str());
+    if (!d)
+    {
+        return;
+    }
+    while (dirent* e = readdir(d))
+    {
+        std::string name = e->d_name;
+        if (name != "." && name != "..")
+        {
+            unlink((dir + "/" + name).c_str());
+        }
+    }
+    closedir(d);
+}
+
+// 一个基准是否需要运行
+static bool selected(const std::string& name)
+{
+    return config.filter.empty() || name.find(config.filter) != std::string::npos;
+}
+
+// 预热warmup次后测量reps次，run返回一次测量的吞吐(次/秒)
+static void measure(const std::string& name, size_t threads, double bytes_per_op, const std::function<double()>& run)
+{
+    BenchResult result;
+    result.name = name;
+    result.threads = threads;
+    result.bytes_per_op = bytes_per_op;
+    for (size_t i = 0; i < config.warmup; ++i)
+    {
+        run();
+    }
+    for (size_t i = 0; i < config.reps; ++i)
+    {
+        result.samples.push_back(run());
+    }
+
+    std::vector<double> sorted = result.samples;
+    std::sort(sorted.begin(), sorted.end());
+    double mean = 0;
+    for (double v : sorted)
+    {
+        mean += v;
+    }
+    mean /= static_cast<double>(sorted.size());
+    double var = 0;
+    for (double v : sorted)
+    {
+        var += (v - mean) * (v - mean);
+    }
+    const double median = sorted[sorted.size() / 2];
+    const double stddev = std::sqrt(var / static_cast<double>(sorted.size()));
+    std::printf("%-24s %7zu %14.0f %10.1f %14.0f %14.0f %7.1f%%", name.c_str(), threads, median,
+                1e9 * static_cast<double>(threads) / median, sorted.front(), sorted.back(), 100.0 * stddev / mean);
+    if (bytes_per_op > 0)
+    {
+        std::printf(" %9.1f", median * bytes_per_op / (1024.0 * 1024.0));
+    }
+    std::printf("\n");
+    std::fflush(stdout);
+    results.push_back(result);
+}
+
+// threads个线程同时开始执行body(线程序号, 停止标志)，body返回完成的操作数；
+// 运行seconds秒后设置停止标志，返回总操作数除以从开始到最后一个线程结束的时间(次/秒)
+static double run_threads(size_t threads, const std::function<uint64_t(size_t, const std::atomic<bool>&)>& body)
+{
+    std::atomic<size_t> ready(0);
+    std::atomic<bool> go(false);
+    std::atomic<bool> stop(false);
+    std::vector<uint64_t> ops(threads, 0);
+    std::vector<double> ends(threads, 0);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]() {
+            pin_thread(t);
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            ops[t] = body(t, stop);
+            ends[t] = now_seconds();
+        });
+    }
+    while (ready.load() < threads)
+    {
+        std::this_thread::yield();
+    }
+    const double start = now_seconds();
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::duration<double>(config.seconds));
+    stop.store(true, std::memory_order_relaxed);
+    for (std::thread& w : workers)
+    {
+        w.join();
+    }
+    uint64_t total = 0;
+    for (uint64_t n : ops)
+    {
+        total += n;
+    }
+    return static_cast<double>(total) / (*std::max_element(ends.begin(), ends.end()) - start);
+}
+
+// 每隔多少次操作检查一次停止标志
+static const uint64_t STOP_CHECK_INTERVAL = 64;
+
+// 基准用的存储配置：os策略，不自动快照(store_*写入时不记日志)
+static StoreConfig store_config(const std::string& name)
+{
+    StoreConfig c;
+    c.wal_path = config.dir + "/" + name + ".wal";
+    c.wal_sync = WalSyncPolicy::Os;
+    c.snapshot_wal_size = 0;
+    c.recovery_threads = config.recovery_threads;
+    return c;
+}
+
+// 写入键[0, n)
+static void fill_store(KVStore& store, uint64_t n, const std::string& value)
+{
+    char buf[32];
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        store.set(std::string_view(buf, format_key(buf, i)), value, false);
+    }
+}
+
+// KVStore的GET/SET/DEL/混合读写
+static void bench_store()
+{
+    const char* names[] = {"store_get", "store_set", "store_del", "store_mixed"};
+    bool any = false;
+    for (const char* name : names)
+    {
+        any = any || selected(name);
+    }
+    if (!any)
+    {
+        return;
+    }
+
+    const std::string value(config.value_size, 'v');
+    std::unique_ptr<KVStore> store;
+    {
+        QuietStdout quiet;
+        clear_dir(config.dir);
+        store.reset(new KVStore(store_config("store")));
+    }
+    fill_store(*store, config.keys, value);
+    const uint64_t keys = config.keys;
+
+    for (size_t threads : config.threads)
+    {
+        if (selected("store_get"))
+        {
+            measure("store_get", threads, 0, [&]() {
+                return run_threads(threads, [&](size_t t, const std::atomic<bool>& stop) {
+                    Random random(t + 1);
+                    uint64_t ops = 0;
+                    size_t found = 0;
+                    char buf[32];
+                    while (!stop.load(std::memory_order_relaxed))
+                    {
+                        for (uint64_t i = 0; i < STOP_CHECK_INTERVAL; ++i)
+                        {
+                            std::string_view key(buf, format_key(buf, random.below(keys)));
+                            store->read(key, [&found](const Entry& e) { found += e.value_size; });
+                        }
+                        ops += STOP_CHECK_INTERVAL;
+                    }
+                    return found ? ops : 0;
+                });
+            });
+        }
+        if (selected("store_set"))
+        {
+            measure("store_set", threads, 0, [&]() {
+                return run_threads(threads, [&](size_t t, const std::atomic<bool>& stop) {
+                    Random random(t + 1);
+                    uint64_t ops = 0;
+                    char buf[32];
+                    while (!stop.load(std::memory_order_relaxed))
+                    {
+                        for (uint64_t i = 0; i < STOP_CHECK_INTERVAL; ++i)
+                        {
+                            store->set(std::string_view(buf, format_key(buf, random.below(keys))), value, false);
+                        }
+                        ops += STOP_CHECK_INTERVAL;
+                    }
+                    return ops;
+                });
+            });
+        }
+        if (selected("store_del"))
+        {
+            // 每个线程删除自己那部分键，删完即停止；每次测量前重新写入
+            measure("store_del", threads, 0, [&]() {
+                fill_store(*store, keys, value);
+                return run_threads(threads, [&](size_t t, const std::atomic<bool>& stop) {
+                    const uint64_t per = keys / threads;
+                    const uint64_t first = per * t;
+                    const uint64_t last = t + 1 == threads ? keys : first + per;
+                    uint64_t ops = 0;
+                    char buf[32];
+                    for (uint64_t k = first; k < last && !stop.load(std::memory_order_relaxed); ++k)
+                    {
+                        store->del(std::string_view(buf, format_key(buf, k)), false);
+                        ++ops;
+                    }
+                    return ops;
+                });
+            });
+            fill_store(*store, keys, value);
+        }
+        if (selected("store_mixed"))
+        {
+            // 90% GET，10% SET
+            measure("store_mixed", threads, 0, [&]() {
+                return run_threads(threads, [&](size_t t, const std::atomic<bool>& stop) {
+                    Random random(t + 1);
+                    uint64_t ops = 0;
+                    size_t found = 0;
+                    char buf[32];
+                    while (!stop.load(std::memory_order_relaxed))
+                    {
+                        for (uint64_t i = 0; i < STOP_CHECK_INTERVAL; ++i)
+                        {
+                            const uint64_t r = random.next();
+                            std::string_view key(buf, format_key(buf, (r >> 8) % keys));
+                            if ((r & 0xFF) < 26)
+                            {
+                                store->set(key, value, false);
+                            }
+                            else
+                            {
+                                store->read(key, [&found](const Entry& e) { found += e.value_size; });
+                            }
+                        }
+                        ops += STOP_CHECK_INTERVAL;
+                    }
+                    return found ? ops : 0;
+                });
+            });
+        }
+    }
+
+    QuietStdout quiet;
+    store.reset();
+    clear_dir(config.dir);
+}
+
+// 生成count条请求：read_percent%的GET(其中一半键不存在)，其余为SET
+static std::vector<std::vector<std::string>> make_requests(size_t count, unsigned read_percent)
+{
+    Random random(42);
+    std::vector<std::vector<std::string>> requests;
+    const std::string value(config.value_size, 'v');
+    char buf[32];
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint64_t r = random.next();
+        const bool miss = (r & 1) != 0;
+        std::string key(buf, format_key(buf, random.below(config.keys) + (miss ? config.keys : 0)));
+        if (r % 100 < read_percent)
+        {
+            requests.push_back({"GET", key});
+        }
+        else
+        {
+            requests.push_back({"SET", key, value});
+        }
+    }
+    return requests;
+}
+
+// 单线程循环处理一组预先编码的请求，handle处理第i条请求并返回
+static double run_requests(size_t count, const std::function<void(size_t)>& handle)
+{
+    return run_threads(1, [&](size_t, const std::atomic<bool>& stop) {
+        uint64_t ops = 0;
+        size_t i = 0;
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            for (uint64_t n = 0; n < STOP_CHECK_INTERVAL; ++n)
+            {
+                handle(i);
+                i = i + 1 == count ? 0 : i + 1;
+            }
+            ops += STOP_CHECK_INTERVAL;
+        }
+        return ops;
+    });
+}
+
+// ProtocolParser：文本协议和RESP的命令处理，GET为主的读负载和90/10的混合负载
+// SET经过WAL(os策略，每次确认前write到操作系统)，与服务端处理一条命令的路径相同
+static void bench_parser()
+{
+    if (!selected("parse_") && !selected("resp_decode"))
+    {
+        return;
+    }
+
+    std::unique_ptr<KVStore> store;
+    {
+        QuietStdout quiet;
+        clear_dir(config.dir);
+        store.reset(new KVStore(store_config("parser")));
+    }
+    fill_store(*store, config.keys, std::string(config.value_size, 'v'));
+
+    const size_t REQUESTS = 4096;
+    const struct {
+        const char* suffix;
+        unsigned read_percent;
+    } mixes[] = {{"get", 100}, {"mixed", 90}};
+
+    for (const auto& mix : mixes)
+    {
+        std::vector<std::vector<std::string>> requests = make_requests(REQUESTS, mix.read_percent);
+
+        // 文本协议：每条请求一行(不含换行)
+        std::vector<std::string> lines;
+        for (const auto& args : requests)
+        {
+            std::string line = args[0];
+            for (size_t i = 1; i < args.size(); ++i)
+            {
+                line.append(" ").append(args[i]);
+            }
+            lines.push_back(line);
+        }
+
+        // RESP：所有请求编码在一个缓冲区中，记录每条的起点
+        std::string resp;
+        std::vector<size_t> offsets;
+        for (const auto& args : requests)
+        {
+            offsets.push_back(resp.size());
+            RespWriter::array(resp, args.size());
+            for (const std::string& a : args)
+            {
+                RespWriter::bulk(resp, a.data(), a.size());
+            }
+        }
+        offsets.push_back(resp.size());
+
+        const std::string inline_name = std::string("parse_inline_") + mix.suffix;
+        if (selected(inline_name))
+        {
+            OutputBuffer out;
+            measure(inline_name, 1, 0, [&]() {
+                return run_requests(REQUESTS, [&](size_t i) {
+                    ProtocolParser::parse(*store, std::string_view(lines[i]), out);
+                    out.consume(out.pending());
+                });
+            });
+        }
+
+        const std::string resp_name = std::string("parse_resp_") + mix.suffix;
+        if (selected(resp_name))
+        {
+            OutputBuffer out;
+            RespParser parser(512 * 1024 * 1024);
+            measure(resp_name, 1, 0, [&]() {
+                return run_requests(REQUESTS, [&](size_t i) {
+                    size_t pos = offsets[i];
+                    if (parser.parse(resp.data(), offsets[i + 1], pos) == RespParser::COMMAND)
+                    {
+                        ProtocolParser::execute(*store, parser.args(), out);
+                    }
+                    out.consume(out.pending());
+                });
+            });
+        }
+
+        const std::string decode_name = std::string("resp_decode_") + mix.suffix;
+        if (selected(decode_name))
+        {
+            RespParser parser(512 * 1024 * 1024);
+            size_t args = 0;
+            measure(decode_name, 1, 0, [&]() {
+                return run_requests(REQUESTS, [&](size_t i) {
+                    size_t pos = offsets[i];
+                    if (parser.parse(resp.data(), offsets[i + 1], pos) == RespParser::COMMAND)
+                    {
+                        args += parser.args().size();
+                    }
+                });
+            });
+        }
+    }
+
+    QuietStdout quiet;
+    store.reset();
+    clear_dir(config.dir);
+}
+
+// WAL::log_set + sync：每个线程循环写自己的键，按持久化策略、写入方式和线程数分别测量
+static void bench_wal()
+{
+    const WalSyncPolicy policies[] = {WalSyncPolicy::Always, WalSyncPolicy::EverySec, WalSyncPolicy::Os};
+    const std::string value(config.value_size, 'v');
+
+    for (const std::string& io_name : config.wal_io)
+    {
+        WalIoOptions io;
+        if (!parse_io_mode(io_name, io.mode))
+        {
+            std::cerr << "Warning: unknown WAL io mode " << io_name << std::endl;
+            continue;
+        }
+        for (WalSyncPolicy policy : policies)
+        {
+            std::string name = std::string("wal_") + sync_policy_name(policy);
+            if (io.mode != WalIoMode::Sync)
+            {
+                name += std::string("_") + io_mode_name(io.mode);
+            }
+            if (!selected(name))
+            {
+                continue;
+            }
+
+            // 一条记录的编码大小(键名按"key:<7位数字>"计算)
+            std::string record;
+            encode_wal_set(record, "key:1234567", value, 0);
+            const double bytes_per_op = static_cast<double>(record.size());
+            for (size_t threads : config.wal_threads)
+            {
+                measure(name, threads, bytes_per_op, [&]() {
+                    std::unique_ptr<KVStore> scratch;
+                    std::unique_ptr<WAL> wal;
+                    {
+                        QuietStdout quiet;
+                        clear_dir(config.dir);
+                        scratch.reset(new KVStore(store_config("scratch")));
+                        wal.reset(new WAL(config.dir + "/bench.wal", policy, WAL::DEFAULT_SEGMENT_SIZE, io));
+                        wal->replay(*scratch);
+                    }
+                    double rate = run_threads(threads, [&](size_t t, const std::atomic<bool>& stop) {
+                        uint64_t ops = 0;
+                        char buf[32];
+                        while (!stop.load(std::memory_order_relaxed))
+                        {
+                            std::string_view key(buf, format_key(buf, t * 10000000 + ops % 10000000));
+                            wal->sync(wal->log_set(key, value));
+                            ++ops;
+                        }
+                        return ops;
+                    });
+                    QuietStdout quiet;
+                    wal.reset();
+                    scratch.reset();
+                    clear_dir(config.dir);
+                    return rate;
+                });
+            }
+        }
+    }
+}
+
+// 从合成日志恢复：先用os策略写出records条SET(键按顺序循环)，每次测量构造一个新存储完成重放
+static void bench_replay()
+{
+    if (!selected("replay"))
+    {
+        return;
+    }
+    const std::string value(config.value_size, 'v');
+
+    for (uint64_t records : config.replay_records)
+    {
+        uint64_t bytes = 0;
+        {
+            QuietStdout quiet;
+            clear_dir(config.dir);
+            KVStore scratch(store_config("scratch"));
+            WAL wal(config.dir + "/replay.wal", WalSyncPolicy::Os);
+            wal.replay(scratch);
+            char buf[32];
+            uint64_t lsn = 0;
+            for (uint64_t i = 0; i < records; ++i)
+            {
+                lsn = wal.log_set(std::string_view(buf, format_key(buf, i % config.replay_keys)), value);
+                // 定期写出，缓冲区不会无限增长
+                if ((i & 0xFFFF) == 0xFFFF)
+                {
+                    wal.sync(lsn);
+                }
+            }
+            wal.flush();
+            bytes = wal.log_size();
+        }
+
+        StoreConfig c = store_config("replay");
+        const std::string name = "replay_" + std::to_string(records);
+        measure(name, config.recovery_threads ? config.recovery_threads : std::thread::hardware_concurrency(),
+                static_cast<double>(bytes) / static_cast<double>(records), [&]() {
+            QuietStdout quiet;
+            const double start = now_seconds();
+            std::unique_ptr<KVStore> store(new KVStore(c));
+            const double elapsed = now_seconds() - start;
+            store.reset();
+            return static_cast<double>(records) / elapsed;
+        });
+    }
+    QuietStdout quiet;
+    clear_dir(config.dir);
+}
+
+// JSON字符串转义
+static std::string json_string(const std::string& s)
+{
+    std::string out = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out.push_back('\\');
+        }
+        out.push_back(c);
+    }
+    return out + "\"";
+}
+
+// 写出JSON结果，fd不小于0时写到该文件描述符(原来的标准输出)
+static bool write_json(const std::string& path, int fd)
+{
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    std::ostringstream out;
+    out.precision(12);
+    out << "{\n  \"commit\": " << json_string(BENCH_COMMIT) << ",\n";
+    out << "  \"timestamp\": " << static_cast<long long>(std::time(nullptr)) << ",\n";
+    out << "  \"host\": " << json_string(host) << ",\n";
+    out << "  \"cpus\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"compiler\": " << json_string(__VERSION__) << ",\n";
+    out << "  \"config\": {\"reps\": " << config.reps << ", \"warmup\": " << config.warmup
+        << ", \"seconds\": " << config.seconds << ", \"keys\": " << config.keys
+        << ", \"value_size\": " << config.value_size << ", \"pinned\": " << (config.cpus.empty() ? "false" : "true")
+        << "},\n";
+    out << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult& r = results[i];
+        std::vector<double> sorted = r.samples;
+        std::sort(sorted.begin(), sorted.end());
+        const double median = sorted[sorted.size() / 2];
+        out << (i ? ",\n" : "\n") << "    {\"name\": " << json_string(r.name) << ", \"threads\": " << r.threads
+            << ", \"ops_per_sec\": " << median << ", \"ns_per_op\": " << 1e9 * static_cast<double>(r.threads) / median
+            << ", \"min\": " << sorted.front() << ", \"max\": " << sorted.back();
+        if (r.bytes_per_op > 0)
+        {
+            out << ", \"mb_per_sec\": " << median * r.bytes_per_op / (1024.0 * 1024.0);
+        }
+        out << ", \"samples\": [";
+        for (size_t j = 0; j < r.samples.size(); ++j)
+        {
+            out << (j ? ", " : "") << r.samples[j];
+        }
+        out << "]}";
+    }
+    out << "\n  ]\n}\n";
+
+    if (fd >= 0)
+    {
+        const std::string text = out.str();
+        return write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size());
+    }
+    std::ofstream file(path);
+    file << out.str();
+    return static_cast<bool>(file);
+}
+
+// 逗号分隔的数字列表
+template <typename T>
+static bool parse_list(const std::string& text, std::vector<T>& values)
+{
+    values.clear();
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        try {
+            long long v = std::stoll(item);
+            if (v < 0)
+            {
+                return false;
+            }
+            values.push_back(static_cast<T>(v));
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return !values.empty();
+}
+
+// 显示帮助信息
+static void show_help()
+{
+    std::cout << "Usage: ./titankv_microbench [options]\n";
+    std::cout << "\nBenchmarks: store_get store_set store_del store_mixed, parse_inline_{get,mixed},\n";
+    std::cout << "            parse_resp_{get,mixed}, resp_decode_{get,mixed}, wal_{always,everysec,os}, replay\n";
+    std::cout << "\nOptions:\n";
+    std::cout << "  --filter <text>          - Run only benchmarks whose name contains text\n";
+    std::cout << "  --threads <list>         - Thread counts for store_* (default 1,2,4,8,16,32,64)\n";
+    std::cout << "  --wal-threads <list>     - Thread counts for wal_* (default 1,4,16)\n";
+    std::cout << "  --wal-io <list>          - WAL io modes for wal_*: sync, io_uring (default sync)\n";
+    std::cout << "  --replay-records <list>  - Log sizes for replay, e.g. 1000000,10000000,100000000 (default 1000000)\n";
+    std::cout << "  --replay-keys <n>        - Distinct keys in the replay log (default 1000000)\n";
+    std::cout << "  --recovery-threads <n>   - Threads used by replay, 0 = CPU count (default 0)\n";
+    std::cout << "  --reps <n>               - Measured repetitions (default 5)\n";
+    std::cout << "  --warmup <n>             - Unmeasured repetitions before measuring (default 1)\n";
+    std::cout << "  --seconds <s>            - Duration of each repetition (default 1)\n";
+    std::cout << "  --keys <n>               - Keys loaded before store_* and parse_* (default 1000000)\n";
+    std::cout << "  --value-size <bytes>     - Value size (default 64)\n";
+    std::cout << "  --cpus <list>            - Pin benchmark thread i to CPU list[i % n] (default: not pinned)\n";
+    std::cout << "  --json <file>            - Also write results as JSON; - writes JSON to stdout and the table to stderr\n";
+    std::cout << "  --dir <path>             - Directory for WAL files (default ./microbench.tmp)\n";
+}
+
+int main(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h")
+        {
+            show_help();
+            return 0;
+        }
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Error: Option " << arg << " requires a value" << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+
+        bool ok = true;
+        try {
+            if (arg == "--filter")
+            {
+                config.filter = value;
+            }
+            else if (arg == "--threads")
+            {
+                ok = parse_list(value, config.threads);
+            }
+            else if (arg == "--wal-threads")
+            {
+                ok = parse_list(value, config.wal_threads);
+            }
+            else if (arg == "--wal-io")
+            {
+                config.wal_io.clear();
+                std::stringstream ss(value);
+                std::string item;
+                while (std::getline(ss, item, ','))
+                {
+                    config.wal_io.push_back(item);
+                }
+            }
+            else if (arg == "--replay-records")
+            {
+                ok = parse_list(value, config.replay_records);
+            }
+            else if (arg == "--replay-keys")
+            {
+                config.replay_keys = std::stoull(value);
+            }
+            else if (arg == "--recovery-threads")
+            {
+                config.recovery_threads = std::stoul(value);
+            }
+            else if (arg == "--reps")
+            {
+                config.reps = std::stoul(value);
+            }
+            else if (arg == "--warmup")
+            {
+                config.warmup = std::stoul(value);
+            }
+            else if (arg == "--seconds")
+            {
+                config.seconds = std::stod(value);
+            }
+            else if (arg == "--keys")
+            {
+                config.keys = std::stoull(value);
+            }
+            else if (arg == "--value-size")
+            {
+                config.value_size = std::stoul(value);
+            }
+            else if (arg == "--cpus")
+            {
+                ok = parse_list(value, config.cpus);
+            }
+            else if (arg == "--json")
+            {
+                config.json_path = value;
+            }
+            else if (arg == "--dir")
+            {
+                config.dir = value;
+            }
+            else
+            {
+                std::cerr << "Error: Unknown option " << arg << std::endl;
+                return 1;
+            }
+        } catch (const std::exception&) {
+            ok = false;
+        }
+        if (!ok)
+        {
+            std::cerr << "Error: Invalid value for " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (config.reps == 0 || config.seconds <= 0 || config.keys == 0 || config.replay_keys == 0 ||
+        std::find(config.replay_records.begin(), config.replay_records.end(), 0u) != config.replay_records.end() ||
+        config.value_size == 0 || std::find(config.threads.begin(), config.threads.end(), 0u) != config.threads.end() ||
+        std::find(config.wal_threads.begin(), config.wal_threads.end(), 0u) != config.wal_threads.end())
+    {
+        std::cerr << "Error: Invalid configuration (see --help)" << std::endl;
+        return 1;
+    }
+    mkdir(config.dir.c_str(), 0755);
+
+    // JSON输出到标准输出时，表格改为输出到标准错误
+    int json_fd = -1;
+    if (config.json_path == "-")
+    {
+        json_fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
+    std::printf("TitanKV microbenchmarks (commit %s): %zu reps x %.1fs after %zu warmup, %llu keys, %zu-byte values%s\n",
+                BENCH_COMMIT, config.reps, config.seconds, config.warmup, static_cast<unsigned long long>(config.keys),
+                config.value_size, config.cpus.empty() ? "" : ", pinned");
+    std::printf("%-24s %7s %14s %10s %14s %14s %8s %9s\n", "benchmark", "threads", "ops/s", "ns/op", "min", "max",
+                "stddev", "MB/s");
+    std::fflush(stdout);
+
+    try {
+        bench_store();
+        bench_parser();
+        bench_wal();
+        bench_replay();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    rmdir(config.dir.c_str());
+
+    if (!config.json_path.empty() && !write_json(config.json_path, json_fd))
+    {
+        std::cerr << "Error: Cannot write " << config.json_path << std::endl;
+        return 1;
+    }
+    return 0;
+}
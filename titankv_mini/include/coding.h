@@ -0,0 +1,106 @@
+#ifndef CODING_H
+#define CODING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// 变长整数(LEB128)和定长小端整数的编解码
+
+// 变长整数编码后的字节数
+inline size_t varint_length(uint64_t v)
+{
+    size_t len = 1;
+    while (v >= 0x80)
+    {
+        v >>= 7;
+        ++len;
+    }
+    return len;
+}
+
+inline void put_varint64(std::string& dst, uint64_t v)
+{
+    char buf[10];
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        buf[n++] = static_cast<char>((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = static_cast<char>(v);
+    dst.append(buf, n);
+}
+
+inline void put_varint32(std::string& dst, uint32_t v)
+{
+    put_varint64(dst, v);
+}
+
+inline void put_fixed32(std::string& dst, uint32_t v)
+{
+    char buf[4];
+    buf[0] = static_cast<char>(v & 0xFF);
+    buf[1] = static_cast<char>((v >> 8) & 0xFF);
+    buf[2] = static_cast<char>((v >> 16) & 0xFF);
+    buf[3] = static_cast<char>((v >> 24) & 0xFF);
+    dst.append(buf, 4);
+}
+
+inline void put_fixed64(std::string& dst, uint64_t v)
+{
+    put_fixed32(dst, static_cast<uint32_t>(v));
+    put_fixed32(dst, static_cast<uint32_t>(v >> 32));
+}
+
+inline void encode_fixed32(char* dst, uint32_t v)
+{
+    dst[0] = static_cast<char>(v & 0xFF);
+    dst[1] = static_cast<char>((v >> 8) & 0xFF);
+    dst[2] = static_cast<char>((v >> 16) & 0xFF);
+    dst[3] = static_cast<char>((v >> 24) & 0xFF);
+}
+
+inline uint32_t decode_fixed32(const char* p)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint32_t>(u[0]) | (static_cast<uint32_t>(u[1]) << 8) |
+           (static_cast<uint32_t>(u[2]) << 16) | (static_cast<uint32_t>(u[3]) << 24);
+}
+
+inline uint64_t decode_fixed64(const char* p)
+{
+    return static_cast<uint64_t>(decode_fixed32(p)) | (static_cast<uint64_t>(decode_fixed32(p + 4)) << 32);
+}
+
+// 解码变长整数，成功返回下一个字节的位置，数据不完整或格式错误返回nullptr
+inline const char* get_varint64(const char* p, const char* limit, uint64_t* value)
+{
+    uint64_t result = 0;
+    for (unsigned shift = 0; shift <= 63 && p < limit; shift += 7)
+    {
+        uint64_t byte = static_cast<unsigned char>(*p++);
+        result |= (byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            *value = result;
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+inline const char* get_varint32(const char* p, const char* limit, uint32_t* value)
+{
+    uint64_t v = 0;
+    p = get_varint64(p, limit, &v);
+    if (!p || v > 0xFFFFFFFFULL)
+    {
+        return nullptr;
+    }
+    *value = static_cast<uint32_t>(v);
+    return p;
+}
+
+#endif // CODING_H
@@ -0,0 +1,16 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC32C(Castagnoli)校验
+// x86_64且CPU支持SSE4.2时使用crc32指令，否则使用slicing-by-8查表实现
+uint32_t crc32c_extend(uint32_t crc, const char* data, size_t size);
+
+inline uint32_t crc32c(const char* data, size_t size)
+{
+    return crc32c_extend(0, data, size);
+}
+
+#endif // CRC32C_H
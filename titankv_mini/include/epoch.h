@@ -0,0 +1,104 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// 基于epoch的内存回收(EBR)
+// 读者访问共享数据前先进入临界区(Guard)，写者把替换下来的对象交给retire，
+// 只有在retire之前进入临界区的读者全部退出后，对象才会被真正释放
+class EpochManager {
+public:
+    typedef void (*Deleter)(void*);
+
+    struct Record;
+
+    // 读临界区守卫，构造时进入，析构时退出，可以嵌套
+    class Guard {
+    public:
+        explicit Guard(EpochManager& manager);
+        ~Guard();
+
+    private:
+        Record* record_;
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    // 进程内唯一的回收域
+    static EpochManager& instance();
+
+    // 延迟释放对象
+    void retire(void* ptr, Deleter deleter);
+
+    template <typename T>
+    void retire(T* ptr)
+    {
+        retire(static_cast<void*>(ptr), &delete_object<T>);
+    }
+
+    // 尝试推进epoch并释放所有线程(包括已退出线程)已经安全的对象，返回释放的数量
+    // 由后台线程定期调用，空闲线程留下的对象也能及时释放
+    size_t collect();
+
+    // 当前全局epoch
+    uint64_t current_epoch() const { return global_epoch_.load(std::memory_order_relaxed); }
+
+    // 等待回收的对象数量(近似值)
+    size_t pending() const { return pending_.load(std::memory_order_relaxed); }
+
+    // 线程记录：每个线程一个，线程退出后可被复用
+    struct Retired {
+        void* ptr;
+        Deleter deleter;
+        uint64_t epoch;
+    };
+
+    struct Record {
+        std::atomic<uint64_t> state;    // (epoch << 1) | active
+        std::atomic<bool> in_use;       // 是否被某个线程占用
+        Record* next;                   // 记录链表
+        unsigned nesting;               // 嵌套深度，仅所属线程访问
+        std::mutex retired_mutex;       // 保护retired：所属线程追加，collect可以在其他线程回收
+        std::vector<Retired> retired;   // 本线程待回收对象
+    };
+
+private:
+    EpochManager();
+    ~EpochManager() = delete; // 进程生命周期内不销毁，避免与thread_local析构顺序冲突
+
+    template <typename T>
+    static void delete_object(void* ptr) { delete static_cast<T*>(ptr); }
+
+    // 获取当前线程的记录
+    Record* local_record();
+
+    // 线程退出时归还记录，剩余对象转入孤儿列表
+    void release_record(Record* record);
+
+    // 所有活跃读者都已观察到当前epoch时推进
+    bool try_advance();
+
+    // 释放列表中已经安全的对象
+    size_t reclaim(std::vector<Retired>& list, uint64_t epoch);
+
+    friend struct EpochThreadHandle;
+
+    std::atomic<uint64_t> global_epoch_;   // 全局epoch
+    std::atomic<Record*> records_;         // 线程记录链表头
+    std::atomic<size_t> pending_;          // 等待回收的对象数量
+    std::mutex orphan_mutex_;              // 保护孤儿列表
+    std::vector<Retired> orphans_;         // 已退出线程留下的待回收对象
+
+    // 每个线程累计多少个待回收对象后尝试回收一次
+    static const size_t COLLECT_THRESHOLD = 64;
+
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+};
+
+#endif // EPOCH_H
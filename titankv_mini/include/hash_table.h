@@ -0,0 +1,245 @@
+#ifndef HASH_TABLE_H
+#define HASH_TABLE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <functional>
+
+// 存储条目：头部之后紧跟键和值的字节，整个键值对是slab分配器中的一个chunk
+// 发布到哈希表之后除meta和refs外不再修改，读者可以无锁读取
+// 哈希表持有一个引用，被替换或删除后通过epoch延迟释放这个引用；
+// 读者可以在epoch临界区内用EntryRef另外持有引用，离开临界区后继续读取(如发送大值)，最后一个引用释放时销毁
+struct Entry {
+    uint64_t hash;                                       // 键的哈希值
+    std::chrono::steady_clock::time_point expiry;        // 过期时间点，max表示永不过期
+    uint32_t key_size;                                   // 键长度
+    uint32_t value_size;                                 // 值长度
+    mutable std::atomic<uint32_t> refs;                  // 引用计数
+    mutable std::atomic<uint32_t> meta;                  // 最高位：是否已被读者放入延迟删除队列；低24位：淘汰用的访问信息(LRU时钟或LFU计数)
+
+    static const uint32_t META_EXPIRE_QUEUED = 1u << 31;
+    static const uint32_t META_ACCESS_MASK = (1u << 24) - 1;
+
+    // 创建和销毁条目
+    static Entry* create(uint64_t hash, std::string_view key, std::string_view value,
+                         std::chrono::steady_clock::time_point expiry);
+    static Entry* create(uint64_t hash, const char* key, size_t key_size, const char* value, size_t value_size,
+                         std::chrono::steady_clock::time_point expiry);
+    static void destroy(Entry* entry);
+
+    // 释放一个引用，最后一个引用释放时销毁
+    static void release(const Entry* entry);
+    static void release_ptr(void* entry) { release(static_cast<Entry*>(entry)); }
+
+    // 复制条目到新分配的内存(用于slab搬迁)，保留访问信息
+    static Entry* clone(const Entry* entry);
+
+    // 条目占用的字节数
+    size_t alloc_size() const { return sizeof(Entry) + key_size + value_size; }
+
+    // 条目计入内存上限的字节数：slab chunk的实际大小 + 哈希表槽位(指针和控制字节)
+    size_t charge() const;
+
+    const char* key_data() const { return reinterpret_cast<const char*>(this + 1); }
+    const char* value_data() const { return key_data() + key_size; }
+    std::string key() const { return std::string(key_data(), key_size); }
+    std::string value() const { return std::string(value_data(), value_size); }
+
+    std::string_view key_view() const { return std::string_view(key_data(), key_size); }
+    std::string_view value_view() const { return std::string_view(value_data(), value_size); }
+
+    bool key_equals(const char* k, size_t size) const
+    {
+        return size == key_size && std::memcmp(k, key_data(), key_size) == 0;
+    }
+
+    bool expired(std::chrono::steady_clock::time_point now) const
+    {
+        return expiry != std::chrono::steady_clock::time_point::max() && expiry <= now;
+    }
+
+private:
+    Entry() {}
+    ~Entry() {}
+};
+
+// 条目的引用：在epoch临界区内取得，之后离开临界区也能读取值，析构时释放
+class EntryRef {
+public:
+    EntryRef() : entry_(nullptr) {}
+
+    // 调用方必须处于epoch临界区内(条目还没有被释放)
+    explicit EntryRef(const Entry* entry) : entry_(entry)
+    {
+        if (entry_)
+        {
+            entry_->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    EntryRef(EntryRef&& other) noexcept : entry_(other.entry_) { other.entry_ = nullptr; }
+
+    EntryRef& operator=(EntryRef&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Entry::release(entry_);
+            entry_ = other.entry_;
+            other.entry_ = nullptr;
+        }
+        return *this;
+    }
+
+    ~EntryRef() { Entry::release(entry_); }
+
+    const Entry* get() const { return entry_; }
+    explicit operator bool() const { return entry_ != nullptr; }
+
+private:
+    const Entry* entry_;
+
+    EntryRef(const EntryRef&) = delete;
+    EntryRef& operator=(const EntryRef&) = delete;
+};
+
+// 计算键的64位哈希值
+inline uint64_t hash_key(std::string_view key)
+{
+    uint64_t h = std::hash<std::string_view>()(key);
+    // 混合一次，使高位和低位都足够随机(高位选分片，低位定位组和标签)
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// 支持无锁读取的开放寻址哈希表(Swiss table风格)
+// 槽位按8个一组，每组有8个控制字节：空/已删除/哈希值低7位标签，
+// 查找时先用标签整组比较，只有标签命中的槽位才去比较键。
+// 扩容是渐进式的：新表建好后，每次写操作只迁移少量组，旧表在迁移完成前保持一致。
+//
+// 读者(find)不加锁，但必须处于EpochManager::Guard临界区内；
+// 写者(insert/erase/migrate_step)由调用方用分片锁串行化，被替换或删除的条目返回给调用方retire
+class HashTable {
+public:
+    static const size_t GROUP_SIZE = 8;
+
+    explicit HashTable(size_t capacity = 64);
+    ~HashTable();
+
+    // 无锁查找
+    const Entry* find(uint64_t hash, std::string_view key) const;
+
+    // 预取键所在的主组(控制字和槽位)，批量查找时先对所有键预取，再逐个查找
+    void prefetch(uint64_t hash) const;
+
+    // 插入或替换，返回被替换的旧条目(没有则为nullptr)
+    Entry* insert(Entry* entry);
+
+    // 删除，返回被删除的条目(没有则为nullptr)
+    Entry* erase(uint64_t hash, std::string_view key);
+
+    // 迁移最多groups个旧组，返回是否仍在迁移中
+    bool migrate_step(size_t groups);
+
+    // 是否正在渐进式扩容
+    bool rehashing() const { return old_.load(std::memory_order_relaxed) != nullptr; }
+
+    // 条目数量(写者持锁读取)
+    size_t size() const { return size_; }
+
+    // 槽位总数(不含迁移中的旧表)
+    size_t capacity() const;
+
+    // 遍历所有条目，调用方持有分片锁
+    void for_each(const std::function<void(const Entry*)>& fn) const;
+
+    // 从start对应的组开始顺序取最多n个条目放入out(淘汰时抽样)，返回取到的个数，调用方持有分片锁
+    size_t sample(uint64_t start, const Entry** out, size_t n) const;
+
+    // 增量遍历的一步：对主组编号为cursor的条目调用fn，返回下一个游标，返回0表示遍历结束，调用方持有分片锁
+    // 游标按主组编号的反向二进制顺序递增(与Redis的SCAN相同)，两次调用之间表扩容或迁移时游标仍然有效：
+    // 遍历开始时存在、且一直没有被删除的条目至少返回一次(扩容前后可能重复返回)
+    uint64_t scan(uint64_t cursor, const std::function<void(const Entry*)>& fn) const;
+
+private:
+    // 一组槽位：8个控制字节打包成一个64位字，便于整组原子读取和比较
+    struct Group {
+        std::atomic<uint64_t> ctrl;
+        std::atomic<Entry*> slots[GROUP_SIZE];
+    };
+
+    // 一张表，扩容时新旧两张表并存，旧表迁移完成后通过epoch延迟释放
+    struct Table {
+        size_t group_mask;   // 组数量 - 1
+        Group* groups;
+        size_t used;         // 已占用槽位(含已删除)
+
+        explicit Table(size_t group_count);
+        ~Table();
+        size_t capacity() const { return (group_mask + 1) * GROUP_SIZE; }
+    };
+
+    // 槽位位置
+    struct Slot {
+        size_t group;
+        size_t index;
+    };
+
+    // 控制字节
+    static const uint8_t CTRL_EMPTY = 0x80;
+    static const uint8_t CTRL_DELETED = 0xFE;
+
+    static uint8_t tag_of(uint64_t hash) { return static_cast<uint8_t>(hash & 0x7F); }
+    static size_t home_group(uint64_t hash, size_t mask) { return (hash >> 7) & mask; }
+
+    // 从一张表的第first组开始取条目，最多取到n个
+    static size_t sample_table(const Table* t, size_t first, size_t start, const Entry** out, size_t count, size_t n);
+
+    // 对一张表中主组为home的条目调用fn：沿探测序列扫描到含空槽的组为止，跳过first之前的组
+    static void scan_home(const Table* t, size_t first, size_t home, const std::function<void(const Entry*)>& fn);
+
+    // 反向二进制顺序的下一个游标(mask以内的位反转后加一)
+    static uint64_t next_cursor(uint64_t cursor, uint64_t mask);
+
+    // 在一张表中查找键
+    static const Entry* probe(const Table* t, uint64_t hash, const char* key, size_t key_size, Slot* where);
+
+    // 在一张表中找一个可写入的空槽
+    static Slot find_free(const Table* t, uint64_t hash);
+
+    // 修改一个控制字节
+    static void set_ctrl(Table* t, const Slot& slot, uint8_t value);
+
+    // 把条目放入空槽
+    static void place(Table* t, const Slot& slot, Entry* entry);
+
+    // 清空槽位
+    static void clear(Table* t, const Slot& slot);
+
+    // 必要时开始扩容或清理已删除槽位
+    void maybe_grow();
+
+    // 同步完成当前迁移
+    void finish_migration();
+
+    std::atomic<Table*> current_;   // 当前表，新键只写入这里
+    std::atomic<Table*> old_;       // 迁移中的旧表，nullptr表示没有迁移
+    size_t migrate_pos_;            // 旧表中下一个待迁移的组
+    size_t size_;                   // 有效条目数量
+
+    // 每次写操作顺带迁移的组数
+    static const size_t MIGRATE_GROUPS_PER_OP = 2;
+
+    HashTable(const HashTable&) = delete;
+    HashTable& operator=(const HashTable&) = delete;
+};
+
+#endif // HASH_TABLE_H
@@ -0,0 +1,79 @@
+#ifndef HOT_KEYS_H
+#define HOT_KEYS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 热点键
+struct HotKey {
+    std::string key;
+    uint64_t hash;      // hash_key(key)
+    uint64_t count;     // 估计的访问次数(已按采样率放大，随时间衰减)
+};
+
+// 热点键统计
+// 每次读写调用record，按采样率(平均每rate次记录一次)决定是否记录，未采样时只有一次线程本地计数器的减法和判断。
+// 采样到的键计入count-min sketch(多行计数器取最小值作为频率估计，只会高估)，
+// 估计值超过top-K中最小的一个时替换它(最小堆，由互斥锁保护；堆满时估计值不超过堆中最小计数的采样不加锁)。
+// decay()把所有计数减半，由后台线程定期调用，使结果反映最近一段时间的热点。
+class HotKeyTracker {
+public:
+    static const size_t SKETCH_DEPTH = 4;       // 行数
+    static const size_t SKETCH_WIDTH = 4096;    // 每行的计数器数，必须是2的幂
+    static const size_t DEFAULT_TOP = 32;       // 默认保留的热点键数
+    static const uint32_t MAX_RATE = 1 << 24;   // 采样率上限
+
+    // rate为0时不统计，超过MAX_RATE时按MAX_RATE
+    explicit HotKeyTracker(uint32_t rate, size_t top = DEFAULT_TOP);
+
+    // 记录一次访问，hash为hash_key(key)
+    void record(uint64_t hash, std::string_view key)
+    {
+        if (rate_ == 0 || --tls_countdown_ > 0)
+        {
+            return;
+        }
+        sampled(hash, key);
+    }
+
+    // 最热的n个键，按估计次数从大到小
+    std::vector<HotKey> top(size_t n) const;
+
+    // 所有计数减半
+    void decay();
+
+    uint32_t sample_rate() const { return rate_; }
+    size_t capacity() const { return top_; }
+
+private:
+    // 本线程距离下一次采样的操作数
+    static thread_local int32_t tls_countdown_;
+
+    // 处理一次采样
+    void sampled(uint64_t hash, std::string_view key);
+
+    // 更新heap_min_
+    void update_min();
+
+    // 第row行的计数器位置
+    static size_t slot(uint64_t hash, size_t row);
+
+    const uint32_t rate_;
+    const size_t top_;
+    std::atomic<uint32_t> sketch_[SKETCH_DEPTH][SKETCH_WIDTH];
+
+    // top-K最小堆，堆顶是计数最小的键
+    mutable std::mutex heap_mutex_;
+    std::vector<HotKey> heap_;
+    std::atomic<uint64_t> heap_min_;    // 堆满时堆顶的计数，未满时为0
+
+    HotKeyTracker(const HotKeyTracker&) = delete;
+    HotKeyTracker& operator=(const HotKeyTracker&) = delete;
+};
+
+#endif // HOT_KEYS_H
@@ -0,0 +1,65 @@
+#ifndef IO_URING_H
+#define IO_URING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <linux/io_uring.h>
+
+// 极简io_uring封装：直接使用io_uring_setup/io_uring_enter系统调用和共享内存环，不依赖liburing
+// 只支持单个提交线程和单个收割线程同时使用：get_sqe/prep_*/submit必须由同一时刻只有一个的提交方调用，
+// wait只能由一个线程调用
+class IoUring {
+public:
+    IoUring();
+    ~IoUring();
+
+    // 创建队列，entries为提交队列长度；内核不支持或没有权限时返回false并设置errno
+    bool init(unsigned entries);
+
+    // 是否已创建
+    bool active() const { return ring_fd_ >= 0; }
+
+    // 取一个空闲的提交项，队列满时返回nullptr；取出的提交项在submit时一起提交
+    io_uring_sqe* get_sqe();
+
+    // 填写提交项，user_data原样出现在完成事件中
+    static void prep_write(io_uring_sqe* sqe, int fd, const void* buf, size_t len, uint64_t offset,
+                           uint64_t user_data);
+    static void prep_fdatasync(io_uring_sqe* sqe, int fd, uint64_t user_data);
+    static void prep_nop(io_uring_sqe* sqe, uint64_t user_data);
+
+    // 提交所有取出的提交项，失败返回false并设置errno
+    bool submit();
+
+    // 等待至少一个完成事件，最多取出max个，返回取出的数量；失败返回0并设置errno
+    size_t wait(io_uring_cqe* cqes, size_t max);
+
+private:
+    int ring_fd_;
+    void* sq_ring_;             // 提交队列环
+    size_t sq_ring_size_;
+    void* cq_ring_;             // 完成队列环(内核支持时与提交队列共用一次映射)
+    size_t cq_ring_size_;
+    io_uring_sqe* sqes_;        // 提交项数组
+    size_t sqes_size_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_array_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned sq_local_tail_;    // 已取出但尚未提交的位置
+
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    io_uring_cqe* cqes_;
+
+    // 释放映射和文件描述符
+    void release();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+};
+
+#endif // IO_URING_H
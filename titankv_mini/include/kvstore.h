@@ -1,59 +1,358 @@
 #ifndef KVSTORE_H
 #define KVSTORE_H
 
-#include <unordered_map>
 #include <string>
+#include <string_view>
 #include <mutex>
 #include <chrono>
 #include <atomic>
 #include <vector>
+#include <utility>
+#include <algorithm>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <stdexcept>
 
-// 添加Wal类的前置声明
-class WAL;
+#include "hash_table.h"
+#include "epoch.h"
+#include "slab_allocator.h"
+#include "timing_wheel.h"
+#include "wal.h"
+#include "snapshot.h"
+#include "hot_keys.h"
+#include "ordered_index.h"
+
+// 内存达到上限时的淘汰策略
+enum class EvictionPolicy {
+    NoEviction,     // 不淘汰，拒绝写入
+    AllKeysLru,     // 在所有键中淘汰最久未访问的
+    AllKeysLfu,     // 在所有键中淘汰访问频率最低的
+    VolatileTtl     // 在设置了TTL的键中淘汰最早过期的
+};
+
+// 策略名与枚举互相转换，名称为 noeviction / allkeys-lru / allkeys-lfu / volatile-ttl
+bool parse_eviction_policy(const std::string& name, EvictionPolicy& policy);
+const char* eviction_policy_name(EvictionPolicy policy);
+
+// 内存达到上限且无法淘汰时写操作抛出的异常
+class OutOfMemoryError : public std::runtime_error {
+public:
+    OutOfMemoryError() : std::runtime_error("OOM command not allowed when used memory > 'maxmemory'") {}
+};
+
+// 存储配置
+struct StoreConfig {
+    std::string wal_path;                        // WAL文件路径
+    WalSyncPolicy wal_sync;                      // WAL持久化策略
+    uint64_t wal_segment_size;                   // WAL段大小
+    WalIoOptions wal_io;                         // WAL写入方式(sync / io_uring, O_DIRECT, 在途批次数)
+    size_t shard_count;                          // 分片数量，必须是2的幂
+    std::chrono::microseconds expire_budget;     // 每次持有分片锁处理过期键的时间上限
+    size_t expire_batch;                         // 每次持有分片锁最多处理的过期键数量
+    std::string snapshot_path;                   // 快照文件路径，为空时使用<wal_path>.snapshot
+    uint64_t snapshot_wal_size;                  // WAL超过该字节数时自动在后台生成快照，0表示不自动生成
+    size_t recovery_threads;                     // 启动恢复时的并行线程数，0表示使用CPU核数
+    size_t maxmemory;                            // 条目占用内存的上限(字节)，0表示不限制
+    EvictionPolicy eviction;                     // 达到上限时的淘汰策略
+    uint32_t hotkey_sample_rate;                 // 热点键统计平均每多少次读写采样一次，0表示不统计
+    bool ordered_index;                          // 是否维护有序键索引(RANGE/PREFIX)，关闭时写入路径没有额外开销
+
+    StoreConfig()
+        : wal_path("wal.log"), wal_sync(WalSyncPolicy::EverySec), wal_segment_size(WAL::DEFAULT_SEGMENT_SIZE), shard_count(16), expire_budget(1000), expire_batch(128),
+          snapshot_wal_size(64ULL << 20), recovery_threads(0), maxmemory(0), eviction(EvictionPolicy::NoEviction),
+          hotkey_sample_rate(64), ordered_index(false) {}
+};
 
 class KVStore{
 public:
-    // 构造函数
-    KVStore(const std::string& wal_path = "wal.log");
+    // 默认分片数量
+    static const size_t DEFAULT_SHARD_COUNT = 16;
+
+    // 构造函数，shard_count必须是2的幂
+    KVStore(const std::string& wal_path = "wal.log", size_t shard_count = DEFAULT_SHARD_COUNT);
+
+    // 使用完整配置构造
+    explicit KVStore(const StoreConfig& config);
 
     // 析构函数
     ~KVStore();
 
     // SET
-    void set(const std::string& key, const std::string& value, bool log = true);
+    void set(std::string_view key, std::string_view value, bool log = true);
     
     // 设置带过期时间的键值对
-    void set_with_ttl(const std::string& key, const std::string& value, std::chrono::seconds ttl, bool log = true);
+    void set_with_ttl(std::string_view key, std::string_view value, std::chrono::seconds ttl, bool log = true);
+
+    // 设置键值对和绝对过期时间点(time_point::max()表示永不过期)
+    void set_with_deadline(std::string_view key, std::string_view value,
+                           std::chrono::steady_clock::time_point deadline, bool log = true);
+
+    // GET，键不存在或已过期时返回空字符串
+    std::string get(std::string_view key);
 
-    // GET
-    std::string get(const std::string& key);
+    // GET，无锁读取；键不存在或已过期时返回false
+    bool get(std::string_view key, std::string& value);
+
+    // GET，无锁读取且不复制值：在epoch临界区内调用fn(const Entry& entry)，
+    // fn返回后条目可能被释放，需要继续使用时在fn中构造EntryRef；键不存在或已过期时返回false
+    template <typename Fn>
+    bool read(std::string_view key, Fn&& fn);
 
     // DEL
-    bool del(const std::string& key, bool log = true);
+    bool del(std::string_view key, bool log = true);
+
+    // 批量GET：在一个epoch临界区内按窗口先计算哈希并预取哈希表的组，再逐个查找(读操作不加锁)；
+    // 对第i个键调用fn(i, const Entry* entry)，键不存在或已过期时entry为nullptr
+    template <typename Fn>
+    void multi_read(const std::vector<std::string_view>& keys, Fn&& fn);
+
+    // 批量SET：按分片序号依次锁住涉及的分片并同时持有，整批写一条WAL记录，只等待一次持久化
+    void multi_set(const std::vector<std::pair<std::string_view, std::string_view>>& items);
+
+    // 批量DEL：加锁方式同multi_set，存在的键写成一条WAL记录，返回删除的键数
+    size_t multi_del(const std::vector<std::string_view>& keys);
 
     // 获取存储大小
     size_t size() const; // 常量成员函数
 
     // 检查键是否存在
-    bool exists(const std::string& key) const;
+    bool exists(std::string_view key) const;
 
-    // 获取所有键
+    // 获取所有键(通过scan分批收集，每次持有分片锁的时间不超过一批)，结果已去重并排序。
+    // 不是某一时刻的精确视图：收集期间写入或删除的键可能包含也可能不包含
     std::vector<std::string> keys() const;
 
+    // 增量遍历：从cursor(第一次为0)开始，把最多约count个键追加到keys，返回下一次的游标，返回0表示遍历结束
+    // pattern非空时只返回匹配的键(glob风格：* ? [abc] [^a] [a-z] \x)，匹配在收集之后进行，可能返回0个键但游标未结束。
+    // 不保存任何状态；每次调用访问的主组数不超过count的固定倍数，每个分片只持锁收集一批条目指针，复制键在锁外进行。
+    // 遍历开始时存在、且一直没有被删除的键至少返回一次(即使中途扩容)，遍历期间写入或删除的键可能返回也可能不返回
+    uint64_t scan(uint64_t cursor, std::vector<std::string>& keys, size_t count = 10,
+                  std::string_view pattern = std::string_view()) const;
+
+    // 是否维护有序键索引
+    bool ordered_index_enabled() const { return config_.ordered_index; }
+
+    // 范围查询：按字节序把[start, end)中未过期的键最多limit个追加到keys，end为空表示没有上界；
+    // 返回是否可能还有后续的键(达到limit时)。未启用有序索引时抛出std::logic_error。
+    // 各分片的索引独立有序，每个分片每次持锁只复制一批键，再在锁外多路归并，需要时再取下一批
+    bool range(std::string_view start, std::string_view end, size_t limit, std::vector<std::string>& keys) const;
+
+    // 前缀遍历：按字节序返回以prefix开头、且大于after(为空时从头开始)的键，最多limit个；
+    // 分页时把上一次返回的最后一个键作为after。返回值和异常同range
+    bool prefix(std::string_view prefix, std::string_view after, size_t limit, std::vector<std::string>& keys) const;
+
+    // 有序索引的键数和占用的字节数(未启用时为0，节点大小已计入used_memory)
+    size_t ordered_index_size() const;
+    size_t ordered_index_memory() const;
+
+    // 遍历所有条目，逐个分片持锁，回调中不能再访问本存储的写接口
+    void for_each_entry(const std::function<void(const Entry*)>& fn) const;
+
+    // 获取分片数量
+    size_t shard_count() const { return shards_.size(); }
+
+    // 内存分配统计
+    SlabStats memory_stats() const;
+
+    // 整理内存：归还空slab，并把低占用slab中的条目搬到其他slab，返回搬迁的条目数
+    size_t compact_memory();
+
+    // 处理到期的TTL键，每个分片每次持锁不超过配置的时间和数量上限，返回删除的键数
+    size_t expire_due_keys();
+
+    // 累计因过期删除的键数
+    uint64_t expired_count() const { return expired_keys_.load(std::memory_order_relaxed); }
+
+    // 条目当前计入内存上限的字节数(各条目charge()与有序索引节点大小之和)
+    size_t used_memory() const;
+
+    // 内存上限和淘汰策略
+    size_t max_memory() const { return config_.maxmemory; }
+    EvictionPolicy eviction_policy() const { return config_.eviction; }
+
+    // 累计因内存上限淘汰的键数
+    uint64_t evicted_count() const { return evicted_keys_.load(std::memory_order_relaxed); }
+
+    // 清零过期和淘汰计数
+    void reset_stats()
+    {
+        expired_keys_.store(0, std::memory_order_relaxed);
+        evicted_keys_.store(0, std::memory_order_relaxed);
+    }
+
+    // 最近最热的n个键(读写次数按采样估计)
+    std::vector<HotKey> hot_keys(size_t n) const { return hot_keys_.top(n); }
+
+    // 热点键统计的采样率和最多能报告的键数
+    uint32_t hotkey_sample_rate() const { return hot_keys_.sample_rate(); }
+    size_t hotkey_capacity() const { return hot_keys_.capacity(); }
+
+    // 等待到期处理的TTL定时器数量
+    size_t pending_timers() const;
+
+    // 同步生成快照，完成后删除被覆盖的WAL；已有快照在生成时返回false
+    bool save();
+
+    // 在后台线程生成快照；已有快照在生成时返回false
+    bool bgsave();
+
+    // 快照统计
+    SnapshotStats snapshot_stats() const;
+
+    // 延迟持久化：调用后本线程的写操作只追加日志、不等待持久化，直到调用sync_deferred统一等待一次。
+    // 事件循环处理完一轮请求后再等待，多个连接的写入共用一次组提交；必须在回复客户端之前调用sync_deferred
+    void defer_sync();
+    void sync_deferred();
+
+    // WAL实际生效的I/O配置
+    WalIoOptions wal_io_options() const { return wal->io_options(); }
+
+    // 键的哈希值所在的分片
+    size_t shard_index(uint64_t hash) const { return (hash >> 48) & shard_mask_; }
+
+    // 恢复专用：不加锁、不写日志，直接修改分片
+    // 只能在启动恢复期间调用，且同一分片同时只能有一个线程访问
+    void recover_set(uint64_t hash, const std::string& key, const char* value, size_t value_size,
+                     std::chrono::steady_clock::time_point deadline);
+    void recover_del(uint64_t hash, const std::string& key);
+
 private:
-    std::unordered_map<std::string, std::pair<std::string, std::chrono::steady_clock::time_point>> data_; // 数据存储 + 过期时间戳
-    mutable std::mutex mutex_; // 互斥锁，用mutable修饰，即使是const依旧可以修改
+    // 分片：每个分片拥有独立的哈希表和互斥锁，按键的哈希值选择
+    // 写操作持有分片锁，读操作在epoch临界区内无锁进行
+    struct Shard {
+        HashTable table;          // 数据存储(条目中包含过期时间戳)
+        TimingWheel wheel;        // 设置了TTL的键按到期时间挂在时间轮上
+        std::unique_ptr<OrderedIndex> index; // 有序键索引，未启用时为空
+        mutable std::mutex mutex; // 分片写锁，用mutable修饰，即使是const依旧可以修改
+        std::atomic<size_t> memory; // 本分片条目的charge()与索引节点大小之和，持锁修改，无锁读取
+
+        Shard();
+    };
+
+    // 延迟删除队列节点：读者发现的过期键，由清理线程统一删除
+    struct ExpiredNode {
+        std::string key;
+        ExpiredNode* next;
+    };
+
+    StoreConfig config_;                         // 配置
+    std::vector<std::unique_ptr<Shard>> shards_; // 分片数组
+    size_t shard_mask_;                          // 分片掩码(shard_count - 1)
     WAL* wal; //持久化日志系统类指针
     std::atomic<bool> ttl_cleanup_running_; // TTL清理线程状态
     std::thread ttl_cleanup_thread_; // TTL清理线程
+    std::atomic<ExpiredNode*> expired_queue_; // 延迟删除队列(无锁栈)
+    std::atomic<uint64_t> expired_keys_;      // 累计过期删除的键数
+    std::atomic<uint64_t> evicted_keys_;      // 累计淘汰的键数
+    std::atomic<size_t> evict_cursor_;        // 下一个淘汰的分片(轮流选择)
+    std::atomic<uint32_t> access_clock_;      // 访问时钟，单位ACCESS_CLOCK_RESOLUTION，由清理线程推进
+    bool track_access_;                       // 读取时是否更新条目的访问信息(LRU/LFU策略)
+    HotKeyTracker hot_keys_;                  // 热点键统计
+    std::atomic<bool> snapshot_running_;      // 是否正在生成快照
+    std::mutex snapshot_thread_mutex_;        // 保护后台快照线程的启动和回收
+    std::thread snapshot_thread_;             // 后台快照线程
+    mutable std::mutex snapshot_stats_mutex_; // 保护快照统计
+    SnapshotStats snapshot_stats_;            // 快照统计
+    std::chrono::steady_clock::time_point snapshot_failed_at_; // 最近一次快照失败的时间
+
+    // 按配置初始化分片并恢复数据
+    void init();
+
+    // 查找未过期的条目，调用方必须处于epoch临界区内；已过期的条目交给清理线程删除并返回nullptr
+    const Entry* find_live(std::string_view key);
+    const Entry* find_live(uint64_t hash, std::string_view key);
+
+    // 条目发布或移除后更新分片的内存计数，新增或删除键时同步有序索引并计入节点大小(调用方持有分片锁，参数可以为nullptr)
+    static void account(Shard& shard, const Entry* added, const Entry* removed);
+
+    // 新条目的初始访问信息；LFU策略下覆盖旧值时继承旧条目的计数
+    void init_access(Entry* entry, const Entry* old) const;
+
+    // 读取时更新条目的访问信息
+    void touch(const Entry* entry) const;
+
+    // 按当前策略计算条目的淘汰优先级，越大越先淘汰
+    uint64_t eviction_score(const Entry* entry, std::chrono::steady_clock::time_point now) const;
+
+    // 写入charge字节之前腾出空间：超过上限时轮流在各分片中抽样淘汰，无法淘汰时抛出OutOfMemoryError
+    void make_room(size_t charge);
+
+    // 在一个分片中抽样淘汰一个键，没有可淘汰的键时返回false
+    bool evict_one(Shard& shard);
+
+    // 按分片序号从小到大锁住这些哈希值所在的分片，每个分片只锁一次
+    void lock_shards(const std::vector<uint64_t>& hashes, std::vector<std::unique_lock<std::mutex>>& locks);
+
+    // 批量GET每次预取的键数
+    static const size_t MULTI_READ_WINDOW = 16;
 
     // 清理过期键
     void cleanup_expired_keys();
 
+    // 删除仍处于过期状态的键，返回是否删除
+    bool erase_if_expired(Shard& shard, const std::string& key, std::chrono::steady_clock::time_point now);
+
+    // 把读者发现的过期键放入延迟删除队列
+    void defer_expired(const Entry* entry);
+
+    // 处理延迟删除队列
+    void drain_expired_queue();
+
+    // 生成快照：结束当前WAL段，把所有条目写入快照，完成后删除被覆盖的段
+    void write_snapshot();
+
+    // WAL超过阈值时启动后台快照
+    void maybe_snapshot();
+
+    // 等待LSN之前的日志按策略持久化，延迟持久化时只记录LSN
+    void wait_durable(uint64_t lsn);
+
+    // 根据哈希值选择分片
+    Shard& shard_at(uint64_t hash) const { return *shards_[shard_index(hash)]; }
+
     // 禁止拷贝构造和赋值
     KVStore(const KVStore&) = delete;
     KVStore& operator=(const KVStore&) = delete;
 };
 
 
+// GET，无锁读取且不复制值
+template <typename Fn>
+bool KVStore::read(std::string_view key, Fn&& fn)
+{
+    EpochManager::Guard guard(EpochManager::instance());
+    const Entry* e = find_live(key);
+    if (!e)
+    {
+        return false;
+    }
+    fn(*e);
+    return true;
+}
+
+// 批量GET
+template <typename Fn>
+void KVStore::multi_read(const std::vector<std::string_view>& keys, Fn&& fn)
+{
+    uint64_t hashes[MULTI_READ_WINDOW];
+    EpochManager::Guard guard(EpochManager::instance());
+    for (size_t base = 0; base < keys.size(); base += MULTI_READ_WINDOW)
+    {
+        const size_t n = std::min(MULTI_READ_WINDOW, keys.size() - base);
+
+        // 先发出整个窗口的预取，访存互相重叠
+        for (size_t i = 0; i < n; ++i)
+        {
+            hashes[i] = hash_key(keys[base + i]);
+            shard_at(hashes[i]).table.prefetch(hashes[i]);
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            fn(base + i, find_live(hashes[i], keys[base + i]));
+        }
+    }
+}
+
 #endif // KVSTORE_H
\ No newline at end of file
@@ -0,0 +1,171 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+
+// 统计数据按线程分成几份(stripe)，每个线程固定写其中一份，读取时合并，避免多个线程争用同一缓存行
+static const size_t METRIC_STRIPES = 4;
+
+// 本线程使用的stripe
+size_t metric_stripe();
+
+// 延迟直方图(HDR风格的对数-线性分桶)
+// 值(纳秒)按最高位所在的2的幂分段，每段再线性分成SUB_COUNT个桶，相对误差不超过1/SUB_COUNT；
+// 超过2^MAX_EXPONENT纳秒(约18分钟)的值计入最后一个桶。记录只做relaxed原子加法，不加锁。
+class LatencyHistogram {
+public:
+    static const size_t SUB_BITS = 4;
+    static const size_t SUB_COUNT = 1 << SUB_BITS;
+    static const size_t MAX_EXPONENT = 40;
+    static const size_t BUCKETS = (MAX_EXPONENT - SUB_BITS + 2) * SUB_COUNT;
+
+    // 合并后的汇总，时间单位为纳秒
+    struct Summary {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+        uint64_t p50;
+        uint64_t p99;
+        uint64_t p999;
+    };
+
+    LatencyHistogram();
+
+    // 记录一个值
+    void record(uint64_t ns)
+    {
+        Stripe& s = stripes_[metric_stripe()];
+        s.buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+        s.sum.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t max = s.max.load(std::memory_order_relaxed);
+        while (ns > max && !s.max.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // 记录从start到现在的时间
+    void record_since(std::chrono::steady_clock::time_point start)
+    {
+        record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count()));
+    }
+
+    // 合并各stripe并计算分位数(取所在桶的上界)
+    Summary summary() const;
+
+    // 清零，与并发的记录之间可能丢失少量数据
+    void reset();
+
+    // 值所在的桶
+    static size_t bucket_of(uint64_t ns);
+
+    // 桶内最大的值
+    static uint64_t bucket_upper(size_t bucket);
+
+private:
+    struct alignas(64) Stripe {
+        std::atomic<uint64_t> buckets[BUCKETS];
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+
+    Stripe stripes_[METRIC_STRIPES];
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+};
+
+// 计数器
+class Counter {
+public:
+    Counter();
+
+    void add(uint64_t n)
+    {
+        stripes_[metric_stripe()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+    void reset();
+
+private:
+    struct alignas(64) Stripe {
+        std::atomic<uint64_t> value;
+    };
+
+    Stripe stripes_[METRIC_STRIPES];
+
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+};
+
+// 进程内的运行统计，各模块直接记录，INFO命令读取
+class Metrics {
+public:
+    // 命令直方图的数量上限(按命令编号索引)
+    static const size_t MAX_COMMANDS = 32;
+
+    // 进程内唯一的统计
+    static Metrics& instance();
+
+    // 每个命令的执行时间
+    LatencyHistogram& command(size_t id) { return commands_[id]; }
+    const LatencyHistogram& command(size_t id) const { return commands_[id]; }
+
+    LatencyHistogram wal_append;        // 追加一条WAL记录(含等待日志锁)
+    LatencyHistogram wal_sync;          // 写者等待记录按策略持久化
+    LatencyHistogram wal_flush;         // 一个批次的写入和fdatasync
+    LatencyHistogram lock_wait;         // 写操作等待分片锁(只记录发生争用的加锁)
+
+    Counter bytes_in;                   // 从客户端读取的字节
+    Counter bytes_out;                  // 发给客户端的字节
+    Counter connections_received;       // 累计接受的连接
+    std::atomic<int64_t> connected_clients; // 当前连接数(不随reset清零)
+
+    // 运行时间
+    uint64_t uptime_seconds() const;
+
+    // 清零所有直方图和计数器
+    void reset();
+
+private:
+    Metrics();
+    ~Metrics() = delete; // 进程生命周期内不销毁
+
+    LatencyHistogram commands_[MAX_COMMANDS];
+    std::chrono::steady_clock::time_point start_;
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+};
+
+// 加锁，发生争用时统计等待时间(无争用时只有一次try_lock)
+inline void lock_timed(std::mutex& mutex)
+{
+    if (mutex.try_lock())
+    {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    mutex.lock();
+    Metrics::instance().lock_wait.record_since(start);
+}
+
+// 统计等待时间的lock_guard
+class TimedLock {
+public:
+    explicit TimedLock(std::mutex& mutex) : mutex_(mutex) { lock_timed(mutex_); }
+    ~TimedLock() { mutex_.unlock(); }
+
+private:
+    std::mutex& mutex_;
+
+    TimedLock(const TimedLock&) = delete;
+    TimedLock& operator=(const TimedLock&) = delete;
+};
+
+#endif // METRICS_H
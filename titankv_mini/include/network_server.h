@@ -4,48 +4,148 @@
 #include <thread>
 #include <atomic>
 #include <string>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "resp.h"
+#include "output_buffer.h"
 
 // 前向声明
 class KVStore;
 
+// 服务器配置
+struct ServerConfig {
+    int port;               // 监听端口
+    int backlog;            // listen的等待队列长度(实际上限受net.core.somaxconn限制)
+    size_t max_events;      // 每次epoll_wait最多取出的事件数
+    size_t threads;         // 事件循环线程数
+    bool pin_threads;       // 是否把每个事件循环线程绑定到一个CPU
+    size_t max_request_size;  // 单条命令的最大字节数，超过时返回错误并关闭连接
+
+    ServerConfig()
+        : port(6379), backlog(4096), max_events(256), threads(1), pin_threads(false), max_request_size(64 << 20) {}
+};
+
+// 网络服务器：多个相互独立的非阻塞reactor
+// 每个事件循环线程有自己的监听socket(SO_REUSEPORT绑定同一端口，由内核在它们之间分配新连接)、epoll和连接表，
+// 连接从accept到关闭都只在一个线程中处理，线程之间不转交任何连接或请求。
+// 监听socket、客户端连接和用于唤醒的eventfd注册在同一个epoll上(边缘触发)，
+// 每个连接保存自己的输入输出缓冲区；可读时读到EAGAIN，切分出所有完整的命令依次执行，
+// 协议由连接的第一个字节决定：'*'开头是RESP2(兼容redis客户端)，否则是按换行切分的文本协议，
+// 响应追加到输出缓冲区，一轮结束时用sendmsg发出(大值直接从条目写出，不复制)，写不完时等待可写事件继续写(支持流水线)。
+// 正在接收的大参数按声明的长度一次预留好输入缓冲区，分多轮读完，每轮的读取次数有上限，不会阻塞同一线程上的其他连接。
+// 一轮事件中所有连接的写操作共用一次WAL组提交，持久化之后才发送响应。
 class NetworkServer {
 public:
     // 构造函数
     NetworkServer(KVStore& store, int port = 6379);
-    
+
+    // 使用完整配置构造
+    NetworkServer(KVStore& store, const ServerConfig& config);
+
     // 析构函数
     ~NetworkServer();
 
-    // 启动服务器
+    // 启动服务器，创建监听socket失败时抛出异常
     void start();
 
-    // 停止服务器
+    // 停止服务器，返回时所有事件循环线程都已经退出，所有连接都已关闭
     void stop();
 
     // 检查服务器是否在运行
     bool is_running() const { return running_.load(); }
 
     // 获取服务器端口
-    int get_port() const { return port_; } 
+    int get_port() const { return config_.port; }
+
+    // 事件循环线程数
+    size_t thread_count() const { return config_.threads; }
 
 
 
 private:
-    // 运行服务器主循环
-    void run();
+    // 连接状态
+    struct Connection {
+        // 连接使用的协议，收到第一个字节时确定
+        enum Protocol { UNKNOWN, INLINE, RESP };
+
+        int fd;
+        Protocol protocol;
+        RespParser resp;        // RESP协议的解析状态
+        std::string input;      // 已读取、尚未执行的数据
+        size_t input_pos;       // input中已执行的字节数
+        size_t scan_pos;        // 文本协议：input中已经查找过换行的位置，新数据到达后从这里继续
+        OutputBuffer output;    // 尚未发送的响应
+        bool closing;           // 对端已关闭写端(或请求过大)，响应发送完后关闭
+        bool pending;           // 已加入本轮待发送列表
+        bool read_paused;       // 没读到EAGAIN就暂停了(读取次数用完或响应积压)
+
+        Connection(int fd, size_t max_request_size)
+            : fd(fd), protocol(UNKNOWN), resp(max_request_size), input_pos(0), scan_pos(0), closing(false), pending(false), read_paused(false) {}
+    };
+
+    // 事件循环：除wakeup_fd外的状态只由自己的线程访问
+    struct Loop {
+        size_t index;           // 序号
+        int cpu;                // 绑定的CPU，-1表示不绑定
+        int server_fd;          // 监听socket
+        int epoll_fd;           // epoll描述符
+        int wakeup_fd;          // stop时用来唤醒事件循环的eventfd
+        std::thread thread;     // 事件循环线程
+        std::unordered_map<int, std::unique_ptr<Connection>> connections;  // 客户端连接
+        std::vector<int> pending;                                          // 本轮有事件的连接
+        std::vector<int> resumed;                                          // 下一轮继续读取的连接
+
+        Loop() : index(0), cpu(-1), server_fd(-1), epoll_fd(-1), wakeup_fd(-1) {}
+    };
+
+    // 创建事件循环的监听socket、epoll和eventfd，失败时抛出异常
+    void open_loop(Loop& loop);
+
+    // 运行事件循环
+    void run(Loop& loop);
+
+    // 接受所有等待中的连接
+    void accept_connections(Loop& loop);
+
+    // 处理连接上的事件
+    void handle_event(Loop& loop, int fd, uint32_t events);
+
+    // 读到EAGAIN并处理请求，返回false表示连接应当关闭
+    bool read_requests(Connection& conn);
+
+    // 执行输入缓冲区中所有完整的命令，不完整的命令过长或协议错误时返回false
+    bool process_input(Connection& conn);
+
+    // 执行缓冲区中完整的RESP命令，协议错误或命令超过max_request_size时返回false
+    bool process_resp(Connection& conn);
+
+    // 命令超过max_request_size：回复错误并丢弃输入，返回false
+    bool reject_too_large(Connection& conn);
+
+    // 丢掉输入缓冲区中已经执行的部分
+    void compact_input(Connection& conn);
+
+    // 一轮事件处理完后等待写入持久化，再发送各连接的响应
+    void flush_pending(Loop& loop);
+
+    // 发送缓冲的响应直到发完或EAGAIN，返回false表示连接出错
+    bool flush_output(Connection& conn);
+
+    // 关闭并移除连接
+    void close_connection(Loop& loop, int fd);
 
-    // 处理客户端连接
-    void handle_client(int client_fd);
+    // 关闭事件循环的监听socket、epoll和eventfd
+    void close_loop(Loop& loop);
 
     KVStore& store_;                // KV存储引用
-    int port_;                      // 服务器端口
+    ServerConfig config_;           // 配置
     std::atomic<bool> running_;     // 运行标志
-    std::thread server_thread_;     // 服务器线程
-    int server_fd_;                 // 服务器socket描述符
+    std::vector<std::unique_ptr<Loop>> loops_;  // 事件循环
 
     // 禁止拷贝构造和赋值
     NetworkServer(const NetworkServer&) = delete;
     NetworkServer& operator=(const NetworkServer&) = delete;
 };
 
-#endif // NETWORK_SERVER_H
\ No newline at end of file
+#endif // NETWORK_SERVER_H
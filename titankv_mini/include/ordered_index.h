@@ -0,0 +1,67 @@
+#ifndef ORDERED_INDEX_H
+#define ORDERED_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 有序键索引：跳表，按字节序保存键的副本，用于范围查询和前缀遍历
+// 每层以1/4的概率向上延伸(与LevelDB相同)，查找、插入、删除都是O(log n)；
+// 节点的指针数组和键在一次分配中连续存放。
+// 非线程安全，由调用方加锁(与哈希表的写操作共用分片锁)
+class OrderedIndex {
+public:
+    OrderedIndex();
+    ~OrderedIndex();
+
+    // 插入键，调用方保证键不存在；返回新节点占用的字节数
+    size_t insert(std::string_view key);
+
+    // 删除键，返回释放的字节数，不存在时返回0
+    size_t erase(std::string_view key);
+
+    // 按顺序把[start, end)中的键最多n个追加到out，end为空表示没有上界，返回追加的个数
+    size_t range(std::string_view start, std::string_view end, size_t n, std::vector<std::string>& out) const;
+
+    // 键数
+    size_t size() const { return size_; }
+
+    // 节点占用的字节数
+    size_t memory() const { return memory_; }
+
+private:
+    static const int MAX_HEIGHT = 24;
+    static const uint32_t BRANCHING = 4;
+
+    struct Node {
+        uint32_t key_size;
+        uint32_t height;
+        Node* next[1];      // 实际长度为height，之后紧跟键
+
+        const char* key_data() const { return reinterpret_cast<const char*>(next + height); }
+        std::string_view key() const { return std::string_view(key_data(), key_size); }
+    };
+
+    // 节点分配的字节数
+    static size_t node_size(uint32_t height, size_t key_size);
+
+    // 新节点的随机高度
+    uint32_t random_height();
+
+    // 第一个不小于key的节点，prev不为空时记录每层最后一个小于key的节点
+    Node* lower_bound(std::string_view key, Node** prev) const;
+
+    Node* head_;        // 哨兵节点，不含键
+    uint32_t height_;   // 当前最高层数
+    size_t size_;
+    size_t memory_;
+    uint64_t random_;   // xorshift状态
+
+    // 禁止拷贝构造和赋值
+    OrderedIndex(const OrderedIndex&) = delete;
+    OrderedIndex& operator=(const OrderedIndex&) = delete;
+};
+
+#endif // ORDERED_INDEX_H
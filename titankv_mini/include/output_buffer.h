@@ -0,0 +1,52 @@
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <string>
+#include <deque>
+#include <cstddef>
+#include <sys/uio.h>
+
+#include "hash_table.h"
+
+// 连接的输出缓冲区
+// 普通响应追加到text()；大值不复制，持有条目的引用并记录它在text()中的插入位置，
+// 发送时把文本片段和值组成iovec，用一次sendmsg发出(scatter-gather)
+class OutputBuffer {
+public:
+    OutputBuffer() : text_pos_(0), value_pos_(0), value_bytes_(0) {}
+
+    // 追加文本的缓冲区
+    std::string& text() { return text_; }
+
+    // 在当前位置插入条目的值
+    void append_value(EntryRef&& ref);
+
+    // 尚未发送的字节数
+    size_t pending() const { return text_.size() - text_pos_ + value_bytes_ - value_pos_; }
+
+    bool empty() const { return pending() == 0; }
+
+    // 把尚未发送的数据按顺序填入iov，最多max个，返回个数
+    size_t fill_iovec(struct iovec* iov, size_t max) const;
+
+    // 前n个字节已经发送
+    void consume(size_t n);
+
+    // 全部复制成一个字符串
+    std::string str() const;
+
+private:
+    // 插入的值：位于text_[offset]之前
+    struct Splice {
+        size_t offset;
+        EntryRef value;
+    };
+
+    std::string text_;              // 文本响应
+    size_t text_pos_;               // text_中已发送的字节数
+    std::deque<Splice> splices_;    // 尚未发完的值，按位置排列
+    size_t value_pos_;              // 第一个值已发送的字节数
+    size_t value_bytes_;            // splices_中值的总字节数
+};
+
+#endif // OUTPUT_BUFFER_H
@@ -2,14 +2,27 @@
 #define PROTOCOL_PARSER_H
 
 #include <string>
+#include <string_view>
+#include <vector>
 
 class KVStore;
+class OutputBuffer;
 
+// 命令解析和分发
+// 请求按std::string_view切分，直接引用连接的输入缓冲区；命令名通过编译期命令表不区分大小写地匹配，
+// 响应直接追加到调用方提供的输出缓冲区。小值的GET/SET/DEL整个过程不分配内存，
+// 大值不复制，以条目引用的形式插入输出缓冲区。
 class ProtocolParser {
 public:
-    // 解析协议请求
+    // 执行一条文本命令(不含换行)，响应追加到out
+    static void parse(KVStore& store, std::string_view request, OutputBuffer& response);
+
+    // 解析协议请求，返回响应
     static std::string parse(KVStore& store, const std::string& request);
 
+    // 执行一条RESP命令(args[0]是命令名)，RESP格式的响应追加到out
+    static void execute(KVStore& store, const std::vector<std::string_view>& args, OutputBuffer& response);
+
     // 检查命令是否有效
     static bool is_valid_command(const std::string& command);
 
@@ -18,20 +31,48 @@ public:
 
 private:
     // 解析SET命令
-    static std::string parse_set(KVStore& store, const std::string& key, const std::string& value);
+    static void parse_set(KVStore& store, std::string_view key, std::string_view value, std::string& out);
 
     // 解析带有TTL的SET命令
-    static std::string parse_set_with_ttl(KVStore& store, const std::string& key, const std::string& value, int64_t ttl_seconds);
+    static void parse_set_with_ttl(KVStore& store, std::string_view key, std::string_view value,
+                                   int64_t ttl_seconds, std::string& out);
 
     // 解析GET命令
-    static std::string parse_get(KVStore& store, const std::string& key);
+    static void parse_get(KVStore& store, std::string_view key, OutputBuffer& response);
 
     // 解析DEL命令
-    static std::string parse_del(KVStore& store, const std::string& key);
+    static void parse_del(KVStore& store, std::string_view key, std::string& out);
+
+    // 解析MGET命令(批量读取，每个键一行响应)
+    static void parse_mget(KVStore& store, const std::vector<std::string_view>& keys, OutputBuffer& response);
+
+    // 解析MSET命令(批量写入，一条WAL记录)
+    static void parse_mset(KVStore& store, const std::vector<std::string_view>& args, std::string& out);
+
+    // 解析MDEL命令(批量删除，返回删除的键数)
+    static void parse_mdel(KVStore& store, const std::vector<std::string_view>& keys, std::string& out);
+
+    // 解析HOTKEYS命令(最热的键，count_arg为空时返回默认数量)
+    static void parse_hotkeys(KVStore& store, std::string_view count_arg, std::string& out);
+
+    // 解析SCAN命令(args从游标开始：cursor [MATCH pattern] [COUNT n])
+    static void parse_scan(KVStore& store, const std::vector<std::string_view>& args, std::string& out);
+
+    // 解析RANGE命令(args为start end [LIMIT n] [AFTER key])或PREFIX命令(prefix为true，args为prefix [LIMIT n] [AFTER key])
+    static void parse_range(KVStore& store, bool prefix, const std::vector<std::string_view>& args, std::string& out);
+
+    // 解析INFO命令(统计信息，section为空时输出全部)
+    static void parse_info(KVStore& store, std::string_view section, std::string& out);
+
+    // 解析SAVE命令(同步生成快照)
+    static void parse_save(KVStore& store, std::string& out);
+
+    // 解析BGSAVE命令(后台生成快照)
+    static void parse_bgsave(KVStore& store, std::string& out);
 
     // 解析错误响应
-    static std::string parse_error(const std::string& message);
+    static void parse_error(std::string_view message, std::string& out);
 };
 
 
-#endif // PROTOCOL_PARSER_H
\ No newline at end of file
+#endif // PROTOCOL_PARSER_H
@@ -0,0 +1,88 @@
+#ifndef RESP_H
+#define RESP_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// RESP2协议的增量解析器
+// 请求是由批量字符串组成的数组：*<参数个数>\r\n 然后每个参数 $<长度>\r\n<数据>\r\n
+// 解析状态(参数个数、已解析的字节数、当前批量字符串的长度)保存在解析器中，数据不完整时返回NEED_MORE，
+// 新数据到达后从上次停下的位置继续，已经解析过的头部和参数不会再扫描。
+// 参数不复制，只记录在命令中的偏移，返回COMMAND时生成指向调用方缓冲区的string_view。
+class RespParser {
+public:
+    enum Status {
+        NEED_MORE,  // 数据不完整
+        COMMAND,    // 得到一条完整的命令，参数在args()中
+        ERROR       // 协议错误，原因在error()中，连接应当关闭
+    };
+
+    // max_bulk_size是单个参数的最大字节数
+    explicit RespParser(size_t max_bulk_size);
+
+    // 从data[pos, size)继续解析，pos是当前命令的起点
+    // 返回COMMAND时pos推进到命令之后，可以再次调用取下一条命令；返回NEED_MORE时pos不变，
+    // 调用方必须保留[pos, size)的数据(可以整体移动位置)，追加新数据后再次调用
+    Status parse(const char* data, size_t size, size_t& pos);
+
+    // 最近一条完整命令的参数，指向传给parse的缓冲区，缓冲区修改之前有效
+    const std::vector<std::string_view>& args() const { return args_; }
+
+    // 协议错误的原因
+    const std::string& error() const { return error_; }
+
+    // 正在接收批量字符串时，从当前命令起点到这个参数结尾需要的字节数，否则返回0
+    // 调用方可以据此一次预留好缓冲区，大参数边接收边写入同一块内存，不需要反复扩容复制
+    size_t expected_size() const
+    {
+        return bulk_size_ < 0 ? 0 : offset_ + static_cast<size_t>(bulk_size_) + 2;
+    }
+
+private:
+    // 读取一行"<前缀><整数>\r\n"：读完整时返回COMMAND，数据不完整时返回NEED_MORE，格式错误时返回ERROR
+    Status parse_header(const char* data, size_t size, size_t& pos, char prefix, int64_t& value);
+
+    // 参数在命令中的位置
+    struct Span {
+        size_t offset;
+        size_t size;
+    };
+
+    size_t max_bulk_size_;               // 单个参数的最大字节数
+    int64_t argc_;                       // 当前命令的参数个数，0表示等待新命令
+    size_t offset_;                      // 当前命令中已解析的字节数
+    int64_t bulk_size_;                  // 当前参数的长度，-1表示等待参数头
+    std::vector<Span> spans_;            // 已解析的参数位置
+    std::vector<std::string_view> args_; // 完整命令的参数
+    std::string error_;                  // 协议错误的原因
+};
+
+// RESP2响应的序列化，追加到out
+class RespWriter {
+public:
+    // +<text>\r\n
+    static void simple(std::string& out, const char* text);
+
+    // -<message>\r\n
+    static void error(std::string& out, const std::string& message);
+
+    // :<value>\r\n
+    static void integer(std::string& out, int64_t value);
+
+    // $<长度>\r\n<数据>\r\n
+    static void bulk(std::string& out, const char* data, size_t size);
+
+    // $<长度>\r\n，之后由调用方追加数据和\r\n
+    static void bulk_header(std::string& out, size_t size);
+
+    // $-1\r\n
+    static void null_bulk(std::string& out);
+
+    // *<元素个数>\r\n，之后由调用方追加各个元素
+    static void array(std::string& out, size_t count);
+};
+
+#endif // RESP_H
@@ -0,0 +1,124 @@
+#ifndef SLAB_ALLOCATOR_H
+#define SLAB_ALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// slab内存统计
+struct SlabStats {
+    size_t slab_count;            // 当前持有的slab数量
+    size_t slab_bytes;            // slab占用的总字节
+    size_t chunk_bytes;           // 已分出去的chunk字节(含线程缓存)
+    size_t free_chunk_bytes;      // slab内空闲chunk字节
+    size_t requested_bytes;       // 调用方实际请求的字节(近似值)
+    size_t large_count;           // 超过最大size class、直接向系统申请的对象数
+    size_t large_bytes;           // 上述对象的总字节
+    size_t evacuating_slabs;      // 正在搬迁的slab数量
+    size_t slabs_released;        // 累计归还给系统的slab数量
+    double fragmentation_ratio;   // slab字节 / 请求字节，越接近1越好
+};
+
+// 按size class划分的slab分配器
+// 每个size class从1MB对齐的slab中切分固定大小的chunk，线程本地缓存一小批chunk，
+// 只有缓存空了或满了才去加锁访问中心空闲链表。
+// 释放时由调用方提供对象大小，以此确定size class，因此chunk不需要额外的头部。
+class SlabAllocator {
+public:
+    static const size_t SLAB_SIZE = 1 << 20;        // 每个slab 1MB
+    static const size_t MIN_CHUNK = 48;             // 最小chunk
+    static const size_t MAX_CHUNK = 256 * 1024;     // 最大chunk，更大的对象直接向系统申请
+
+    // 进程内唯一的分配器
+    static SlabAllocator& instance();
+
+    // 分配和释放
+    void* allocate(size_t size);
+    void deallocate(void* ptr, size_t size);
+
+    // 分配size字节实际占用的字节数(所在size class的chunk大小，大对象为size本身)
+    size_t chunk_size(size_t size) const;
+
+    // 统计信息
+    SlabStats stats() const;
+
+    // 把空slab归还给系统(每个size class保留一个备用)，返回归还的数量
+    size_t release_empty_slabs();
+
+    // 选出占用率低的slab标记为搬迁中，之后的分配不会再使用它们，返回标记的数量
+    size_t begin_evacuation();
+
+    // 对象是否位于搬迁中的slab里，调用方应把它复制到新位置
+    bool is_evacuating(const void* ptr, size_t size) const;
+
+    // 结束本轮搬迁：仍未清空的slab恢复为普通slab
+    void end_evacuation();
+
+    // 线程本地缓存
+    struct ThreadCache;
+
+private:
+    // slab头部，位于slab内存的起始位置
+    struct Slab {
+        uint32_t class_id;
+        uint32_t capacity;        // chunk总数
+        uint32_t used;            // 已分出去的chunk数
+        uint32_t carved;          // 已切分过的chunk数(惰性切分，未切分的页不会占用物理内存)
+        void* free_list;          // 已释放chunk组成的链表
+        char* chunks;             // 第一个chunk的地址
+        Slab* prev;               // 可分配slab链表
+        Slab* next;
+        bool in_partial;          // 是否在可分配链表中
+        std::atomic<bool> evacuating;
+    };
+
+    // 一个size class的中心状态
+    struct SizeClass {
+        size_t chunk_size;
+        size_t cache_limit;            // 线程缓存的最大chunk数
+        mutable std::mutex mutex;
+        Slab* partial;                 // 有空闲chunk且不在搬迁中的slab
+        std::vector<Slab*> slabs;      // 本class所有slab
+        size_t free_chunks;            // 所有slab中空闲chunk的数量
+    };
+
+    SlabAllocator();
+    ~SlabAllocator() = delete; // 进程生命周期内不销毁，避免与thread_local析构顺序冲突
+
+    // 根据大小找size class，超出范围返回-1
+    int class_of(size_t size) const;
+
+    static Slab* slab_of(const void* ptr)
+    {
+        return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t)(SLAB_SIZE - 1));
+    }
+
+    // 从中心链表批量取chunk / 批量归还chunk(调用方不持锁)
+    size_t refill(int cls, void** out, size_t n);
+    void flush(int cls, void* const* chunks, size_t n);
+
+    // 以下函数调用方持有size class的锁
+    Slab* new_slab(int cls);
+    void* take_chunk(SizeClass& sc, Slab* slab);
+    void put_chunk(SizeClass& sc, void* chunk);
+    void link_partial(SizeClass& sc, Slab* slab);
+    void unlink_partial(SizeClass& sc, Slab* slab);
+
+    // 线程缓存中累计的请求字节变化量
+    void add_requested(int64_t delta) { requested_bytes_.fetch_add(delta, std::memory_order_relaxed); }
+
+    friend struct ThreadCache;
+
+    std::vector<SizeClass*> classes_;
+    std::atomic<int64_t> requested_bytes_;
+    std::atomic<size_t> large_count_;
+    std::atomic<size_t> large_bytes_;
+    std::atomic<size_t> slabs_released_;
+
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+};
+
+#endif // SLAB_ALLOCATOR_H
@@ -0,0 +1,76 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "hash_table.h"
+
+class KVStore;
+
+// 快照文件格式(版本1)
+//
+// 文件头: "TKVSNP" + 版本号(2字节小端) + fixed64 已覆盖的WAL归档编号
+// 记录:   与WAL的SET记录相同(长度 | CRC32C | payload)，过期时间为绝对unix毫秒
+// 结尾:   长度为0的记录 + fixed64 记录数
+//
+// 快照先写到<path>.tmp，fsync后改名，因此<path>要么是完整的旧快照，要么是完整的新快照
+
+static const size_t SNAPSHOT_HEADER_SIZE = 16;
+static const uint16_t SNAPSHOT_FORMAT_VERSION = 1;
+
+// 快照统计
+struct SnapshotStats {
+    bool in_progress;           // 是否正在生成快照
+    uint64_t completed;         // 成功完成的快照数
+    uint64_t failed;            // 失败的快照数
+    uint64_t last_keys;         // 最近一次快照的键数
+    uint64_t last_bytes;        // 最近一次快照的字节数
+    double last_seconds;        // 最近一次快照的耗时
+    int64_t last_save_unix;     // 最近一次成功的时间(unix秒)，0表示尚未保存
+
+    SnapshotStats()
+        : in_progress(false), completed(0), failed(0), last_keys(0), last_bytes(0), last_seconds(0), last_save_unix(0) {}
+};
+
+// 快照写入器：逐条追加条目，commit时原子替换快照文件；未commit就析构时删除临时文件
+class SnapshotWriter {
+public:
+    // covered是快照覆盖到的WAL归档编号
+    SnapshotWriter(const std::string& path, uint64_t covered);
+    ~SnapshotWriter();
+
+    // 追加一个条目，已过期的条目跳过
+    void add(const Entry* entry);
+
+    // 写入结尾，fsync并改名为正式快照
+    void commit();
+
+    // 已写入的条目数和字节数
+    uint64_t count() const { return count_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    // 把缓冲区写到临时文件
+    void write_buffer();
+
+    std::string path_;          // 快照路径
+    std::string tmp_path_;      // 临时文件路径
+    int fd_;                    // 临时文件描述符
+    std::string buffer_;        // 待写出的数据
+    uint64_t count_;            // 条目数
+    uint64_t bytes_;            // 已写出的字节数
+    bool committed_;            // 是否已经commit
+    std::chrono::steady_clock::time_point steady_base_;  // 过期时间换算的基准
+    int64_t unix_base_ms_;
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+};
+
+// 加载快照，返回快照覆盖到的WAL归档编号；快照不存在时返回0
+// threads为并行线程数(0表示CPU核数)，keys非空时返回加载的键数
+uint64_t load_snapshot(const std::string& path, KVStore& store, size_t threads = 0, uint64_t* keys = nullptr);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,66 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+// 分层时间轮：4层，每层64个槽
+// 第0层每槽一个tick，第L层每槽64^L个tick；到期时间较远的定时器放在高层，
+// 随着时间推进逐层下移(cascade)，到期的定时器进入就绪队列。
+// 插入O(1)，推进的开销只与实际到期(或下移)的定时器数量有关。
+// 非线程安全，由调用方加锁
+class TimingWheel {
+public:
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    // 定时器：到期时只携带键和到期时间，处理时需要再确认键的过期时间没有变化
+    struct Timer {
+        std::string key;
+        time_point deadline;
+    };
+
+    TimingWheel(std::chrono::milliseconds tick, time_point start);
+
+    // 添加定时器
+    void add(const std::string& key, time_point deadline);
+
+    // 推进到now，把到期的定时器移入就绪队列
+    void advance(time_point now);
+
+    // 取出一个就绪的定时器，没有时返回false
+    bool pop_ready(Timer& timer);
+
+    // 定时器总数(含就绪队列)
+    size_t size() const { return size_; }
+
+    // 就绪队列长度
+    size_t ready_count() const { return ready_.size(); }
+
+private:
+    static const unsigned LEVELS = 4;
+    static const unsigned SLOT_BITS = 6;
+    static const uint64_t SLOTS = 1 << SLOT_BITS;
+    static const uint64_t SLOT_MASK = SLOTS - 1;
+
+    // 到期时间换算成tick(向上取整，保证不会提前到期)
+    uint64_t tick_of(time_point deadline) const;
+
+    // 按到期tick放入合适的层和槽
+    void place(Timer& timer, uint64_t expire_tick);
+
+    // 把第level层当前槽中的定时器重新分配到低层
+    void cascade(unsigned level);
+
+    std::vector<Timer> slots_[LEVELS][SLOTS];
+    std::deque<Timer> ready_;          // 已到期、等待处理的定时器
+    std::chrono::milliseconds tick_;   // 每个tick的时长
+    time_point start_;                 // tick 0 对应的时间
+    uint64_t current_tick_;            // 已推进到的tick
+    size_t size_;
+};
+
+#endif // TIMING_WHEEL_H
@@ -2,40 +2,253 @@
 #define WAL_H
 
 #include <fstream>
+#include <deque>
+#include <memory>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <string>
+#include <cstdint>
+
+#include "wal_record.h"
+#include "io_uring.h"
 
 // 前向声明
 class KVStore;
+class WalRecovery;
+
+// 持久化策略
+enum class WalSyncPolicy {
+    Always,     // 每次确认前都保证已fdatasync(同一批次的写入共用一次fdatasync)
+    EverySec,   // 确认前保证已write到操作系统，后台线程每秒fdatasync一次
+    Os          // 确认前保证已write到操作系统，何时落盘由操作系统决定
+};
+
+// 策略名与枚举互相转换，名称为 always / everysec / os
+bool parse_sync_policy(const std::string& name, WalSyncPolicy& policy);
+const char* sync_policy_name(WalSyncPolicy policy);
+
+// 写入方式
+enum class WalIoMode {
+    Sync,       // leader线程直接pwrite/fdatasync，完成后确认整批
+    Uring       // 通过io_uring异步提交写入和fdatasync，多个批次同时在途，由完成线程确认
+};
+
+// 写入方式名与枚举互相转换，名称为 sync / io_uring
+bool parse_io_mode(const std::string& name, WalIoMode& mode);
+const char* io_mode_name(WalIoMode mode);
+
+// I/O配置
+struct WalIoOptions {
+    WalIoMode mode;         // 写入方式，io_uring不可用时退回sync
+    bool direct;            // 使用O_DIRECT绕过页缓存，写入按4KB对齐；文件系统不支持时退回普通写入
+    size_t inflight;        // io_uring模式下同时在途的批次数上限
+
+    WalIoOptions() : mode(WalIoMode::Sync), direct(false), inflight(4) {}
+};
 
+// 预写日志
+// 写者在持有分片锁时调用log_*，只把记录追加到内存缓冲区并得到一个LSN(日志中的字节位置)；
+// 释放分片锁之后再调用sync(lsn)等待记录按策略持久化。
+// 多个等待者中只有一个(leader)执行write/fdatasync，一次处理整个缓冲区，其余等待者直接复用结果(组提交)。
+//
+// 日志由编号递增的段文件<path>.<N>组成，每个段创建时用fallocate预分配固定大小，
+// 追加写不改变文件大小，fdatasync不需要更新元数据；未写入的部分全为0，读到长度为0的记录即为段尾。
+// 后台线程提前准备好下一个段，写满时leader直接切换；切换前先fdatasync旧段，保证段之间没有空洞。
+//
+// io_uring模式下leader只负责把批次提交到队列(Always策略下写入和fdatasync链接在一起)，提交后立即让出，
+// 下一个leader可以接着提交，最多inflight个批次同时在途；完成线程按提交顺序推进已写出/已落盘的LSN并唤醒等待者。
+// 每个批次自带fdatasync，因此只有连续完成的前缀才能被确认。切换段、flush和everysec的fdatasync先等在途批次完成再同步执行。
 class WAL {
 public:
-    WAL(const std::string& path);
+    // 默认段大小
+    static const uint64_t DEFAULT_SEGMENT_SIZE = 64ULL << 20;
+
+    // path是段文件名的前缀；构造后必须先调用replay，之后才能写入
+    WAL(const std::string& path, WalSyncPolicy policy = WalSyncPolicy::EverySec,
+        uint64_t segment_size = DEFAULT_SEGMENT_SIZE, const WalIoOptions& io = WalIoOptions());
     ~WAL();
 
-    // 记录SET到操作日志
-    void log_set(const std::string& key, const std::string& value);
+    // 记录SET到操作日志，expire_at_ms是绝对过期时间(unix毫秒，0表示永不过期)，返回LSN
+    uint64_t log_set(std::string_view key, std::string_view value, int64_t expire_at_ms = 0);
+
+    // 记录DEL到操作日志，返回LSN
+    uint64_t log_del(std::string_view key);
+
+    // 把多个SET/DEL记录为一条BATCH记录(重放时整批生效或整批丢弃)，返回LSN
+    uint64_t log_mset(const std::vector<std::pair<std::string_view, std::string_view>>& items);
+    uint64_t log_mdel(const std::vector<std::string_view>& keys);
+
+    // 等待LSN之前的记录按策略持久化
+    void sync(uint64_t lsn);
+
+    // 写出缓冲区并fdatasync
+    void flush();
+
+    // 持久化策略
+    WalSyncPolicy policy() const { return policy_; }
 
-    // 记录DEL到操作日志
-    void log_del(const std::string& key);
+    // 实际生效的I/O配置(可能已退回sync或普通写入)
+    WalIoOptions io_options() const;
 
-    // 记录ttl信息到日志
-    void log_ttl(const std::string& key, int64_t ttl_seconds);
+    // 重放日志以恢复数据：按编号重放未被快照覆盖的段(编号大于covered)，然后在最后一个段上继续追加；
+    // 遇到损坏或写了一半的记录时恢复到它之前为止(之后的段中还有记录时抛出异常)。threads为并行线程数，0表示CPU核数
+    void replay(KVStore& store, uint64_t covered = 0, size_t threads = 0);
 
-    // 重放日志以恢复数据
-    void replay(KVStore& store);
+    // 结束当前段，之后追加的记录都写入新段，返回结束的段号N(此前的记录都在编号不大于N的段中)
+    uint64_t rotate();
+
+    // 删除编号不大于upto的段(已被快照覆盖)
+    void remove_segments(uint64_t upto);
+
+    // 未被快照覆盖的日志字节数(包括尚未写出的记录)
+    uint64_t log_size();
+
+    // fsync文件所在目录，保证创建、改名和删除持久化
+    static void sync_parent_dir(const std::string& path);
 
     // 获取日志文件路径
     const std::string& get_log_path() const {return log_path;}
 
 
 private:
-    std::string log_path;      // 日志文件路径
-    std::ofstream log_file;    // 文件输出流
+    // O_DIRECT要求的缓冲区、偏移和长度对齐
+    static const size_t DIRECT_ALIGNMENT = 4096;
+
+    // 按DIRECT_ALIGNMENT对齐分配的缓冲区
+    struct AlignedBuffer {
+        char* data;
+        size_t capacity;
+
+        AlignedBuffer() : data(nullptr), capacity(0) {}
+        ~AlignedBuffer();
+
+        // 保证容量至少为size，不保留原有内容
+        void reserve(size_t size);
+    };
+
+    // 通过io_uring提交的批次
+    struct UringBatch {
+        std::string data;       // 批次中的记录
+        AlignedBuffer aligned;  // O_DIRECT时对齐后的数据
+        const char* io_data;    // 实际写入的数据、长度和位置
+        size_t io_size;
+        uint64_t io_offset;
+        int fd;                 // 写入的段
+        uint64_t end;           // 批次结束的LSN
+        bool sync;              // 是否带fdatasync
+        int pending;            // 尚未收到的完成事件数(只由完成线程访问)
+        int32_t write_res;      // 写入的完成结果
+        int32_t sync_res;       // fdatasync的完成结果
+        bool done;              // 已完成
+        bool ok;                // 写入(和fdatasync)成功
+        int error;              // 失败时的errno
+        std::chrono::steady_clock::time_point submitted; // 提交时间
+    };
+
+    // 重放一个段：records和bytes累加重放的记录数和有效字节数，valid_end返回最后一条有效记录的结束位置；
+    // 返回valid_end之后是否全为0(预分配的空间)
+    bool replay_file(int fd, const std::string& path, WalRecovery& recovery, uint64_t& records,
+                     uint64_t& bytes, uint64_t& valid_end);
+
+    // 段文件路径
+    std::string segment_path(uint64_t n) const;
+
+    // 段中是否没有任何记录(没有文件头，或文件头之后全为0)
+    bool segment_empty(uint64_t n) const;
+
+    // 列出已有段的编号(升序)
+    std::vector<uint64_t> list_segments() const;
+
+    // 创建并预分配一个新段，写入文件头，失败返回-1
+    int create_segment(uint64_t n);
+
+    // 把段预分配到segment_size_
+    bool preallocate(int fd);
+
+    // 切换到下一个段(leader调用，不持有log_mutex)
+    bool switch_segment();
+
+    // 在缓冲区末尾标记段边界，调用方持有log_mutex
+    void mark_boundary();
+
+    // 追加一条编码到缓冲区尾部的记录后更新计数，必要时在它之前标记段边界，调用方持有log_mutex
+    // start是调用方开始追加(等待log_mutex之前)的时间，用于统计追加延迟
+    uint64_t appended(size_t before, std::chrono::steady_clock::time_point start);
+
+    // 重放旧版文本日志("SET key value" / "DEL key" / "TTL key secs ts")
+    void replay_text(KVStore& store);
+
+    // 把旧版文本日志中的数据写入段中，原文件改名为<path>.legacy
+    void migrate(KVStore& store);
+
+    // 成为leader，把缓冲区写出(可选fdatasync)，调用方持有log_mutex
+    void write_batch(std::unique_lock<std::mutex>& lock, bool do_sync);
+
+    // 后台线程：定期写出缓冲区，everysec策略下每秒fdatasync，并提前准备下一个段
+    void background_flush();
+
+    // 在正在写入的段的write_offset_处写入数据并推进，leader调用
+    bool write_segment(const char* data, size_t size);
+
+    // 计算写入的实际数据和位置并推进write_offset_；O_DIRECT时把所在块的已有内容和数据拼成对齐的整块
+    const char* prepare_write(const char* data, size_t size, AlignedBuffer& buf, size_t& io_size,
+                              uint64_t& io_offset);
+
+    // 为即将写入的段开启O_DIRECT，offset是下一次写入的位置；不支持时退回普通写入
+    void enable_direct(int fd, uint64_t offset);
+
+    // 成为leader，把缓冲区作为一个批次提交到io_uring后立即返回，调用方持有log_mutex
+    void submit_batch(std::unique_lock<std::mutex>& lock);
+
+    // 完成线程：收割完成事件，按提交顺序确认批次
+    void reap_completions();
+
+    // 批次的完成事件都已收到：补写未完成的部分，然后确认
+    void finish_batch(UringBatch* batch);
+
+    std::string log_path;      // 段文件名前缀
+    int log_fd;                // 正在写入的段
+    WalSyncPolicy policy_;     // 持久化策略
+    uint64_t segment_size_;    // 段大小
     std::mutex log_mutex;      // 互斥锁（保证读写日志的线程安全）
-    size_t last_flush_size;    // 上次刷新时的文件大小
+    std::condition_variable flushed_cv_;  // 批次完成或新段准备好时通知
+    std::string buffer_;       // 尚未写出的记录
+    std::string spare_;        // 与buffer_交替使用，避免反复分配
+    std::vector<size_t> boundaries_;        // buffer_中需要切换到新段的位置
+    std::vector<size_t> spare_boundaries_;  // 与boundaries_交替使用
+    uint64_t appended_lsn_;    // 已追加到缓冲区的字节位置
+    uint64_t written_lsn_;     // 已write到操作系统的字节位置
+    uint64_t durable_lsn_;     // 已fdatasync的字节位置
+    bool flushing_;            // 是否有leader正在写出
+    bool failed_;              // 写出失败后后续等待者直接报错
+    bool legacy_text_;         // 存在旧版文本日志
+    uint64_t segment_no_;      // 正在写入的段号(leader修改)
+    uint64_t write_offset_;    // 正在写入的段中下一条记录的位置(leader修改)
+    uint64_t append_segment_no_;     // 缓冲区末尾所在的段号
+    uint64_t append_segment_bytes_;  // 缓冲区末尾所在的段已占用的字节数
+    uint64_t log_bytes_;       // 未被快照覆盖的日志字节数
+    int next_fd_;              // 后台准备好的下一个段，-1表示没有
+    uint64_t next_segment_no_; // next_fd_的段号
+    bool preparing_;           // 后台线程正在准备下一个段
+    bool prepare_failed_;      // 准备失败，等下次切换后再试
+    std::atomic<bool> running_;           // 后台线程运行标志
+    std::condition_variable stop_cv_;     // 唤醒后台线程
+    std::thread flush_thread_;            // 后台线程
+    std::atomic<bool> direct_;            // 是否使用O_DIRECT
+    std::string direct_tail_;             // O_DIRECT时write_offset_所在块中已写入的内容(leader修改)
+    AlignedBuffer direct_buffer_;         // 同步写入时的对齐缓冲区
+    IoUring ring_;                        // io_uring队列，未创建时使用同步写入
+    size_t max_inflight_;                 // 同时在途的批次数上限
+    uint64_t submitted_lsn_;              // 已提交写出的字节位置
+    std::vector<std::unique_ptr<UringBatch>> batches_;  // 所有批次对象
+    std::vector<UringBatch*> free_batches_;             // 空闲的批次
+    std::deque<UringBatch*> inflight_;                  // 在途的批次，按提交顺序
+    std::thread reap_thread_;             // 完成线程
 
     // 禁止拷贝构造和赋值
     WAL(const WAL&) = delete;
@@ -0,0 +1,96 @@
+#ifndef WAL_RECORD_H
+#define WAL_RECORD_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// WAL二进制格式(版本1)
+//
+// 文件头: "TKVWAL" + 版本号(2字节小端)
+// 记录:   varint32 payload长度 | fixed32 payload的CRC32C | payload
+// payload: 1字节操作码 | varint32 键长度 | 键
+//          SET还有: varint32 值长度 | 值 | varint64 过期时间(unix毫秒，0表示永不过期)
+// BATCH:   1字节操作码 | varint32 条目数 | 条目...，每个条目的格式与单条SET/DEL的payload相同，
+//          整批共用一个CRC，崩溃后要么全部重放要么全部丢弃
+//
+// 预分配文件中未写入的部分全为0，长度为0的记录视为日志结束
+
+static const size_t WAL_HEADER_SIZE = 8;
+static const uint16_t WAL_FORMAT_VERSION = 1;
+// 单条记录的最大长度，超过视为损坏
+static const uint32_t WAL_MAX_RECORD_SIZE = 1u << 30;
+
+// 操作码
+enum WalOp : uint8_t {
+    WAL_OP_SET = 1,
+    WAL_OP_DEL = 2,
+    WAL_OP_BATCH = 3
+};
+
+// 解析出的记录，键和值指向原始缓冲区，不做复制
+// BATCH记录只填op和batch*字段，条目用decode_wal_entry逐个解析
+struct WalRecord {
+    uint8_t op;
+    const char* entry;          // 条目的起点(操作码)
+    const char* key;
+    uint32_t key_size;
+    const char* value;
+    uint32_t value_size;
+    int64_t expire_at_ms;
+    const char* batch;          // BATCH记录第一个条目的起点
+    const char* batch_end;      // BATCH记录的结尾
+    uint32_t batch_count;       // BATCH记录的条目数
+};
+
+// 编码文件头和记录
+void encode_wal_header(std::string& dst);
+void encode_wal_set(std::string& dst, std::string_view key, std::string_view value, int64_t expire_at_ms);
+void encode_wal_set(std::string& dst, const char* key, size_t key_size,
+                    const char* value, size_t value_size, int64_t expire_at_ms);
+void encode_wal_del(std::string& dst, std::string_view key);
+void encode_wal_mset(std::string& dst, const std::vector<std::pair<std::string_view, std::string_view>>& items);
+void encode_wal_mdel(std::string& dst, const std::vector<std::string_view>& keys);
+
+// 检查文件头，返回版本号，不是二进制WAL时返回0
+uint16_t decode_wal_header(const char* data, size_t size);
+
+// 解析一条记录的payload(不校验CRC)，格式错误时返回false；BATCH记录会检查所有条目
+bool decode_wal_payload(const char* payload, size_t size, WalRecord& record);
+
+// 解析从p开始的一个SET/DEL条目，返回条目之后的位置，格式错误时返回nullptr
+const char* decode_wal_entry(const char* p, const char* end, WalRecord& record);
+
+// 逐条解析内存中的记录，遇到第一条损坏或不完整的记录时停止
+class WalReader {
+public:
+    enum Status {
+        OK,          // 解析出一条记录
+        END,         // 数据正常结束(或遇到预分配的全0区域)
+        TRUNCATED,   // 最后一条记录不完整，可能需要更多数据
+        CORRUPT      // 长度非法或校验和不匹配
+    };
+
+    WalReader(const char* data, size_t size) : data_(data), size_(size), offset_(0) {}
+
+    // 解析下一条记录
+    Status next(WalRecord& record);
+
+    // 已成功解析的字节数
+    size_t offset() const { return offset_; }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t offset_;
+};
+
+// steady_clock时间点与unix毫秒时间戳互相转换，日志中使用后者以便重启后仍然有效
+int64_t steady_to_unix_ms(std::chrono::steady_clock::time_point tp);
+std::chrono::steady_clock::time_point unix_ms_to_steady(int64_t unix_ms);
+
+#endif // WAL_RECORD_H
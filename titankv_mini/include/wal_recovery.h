@@ -0,0 +1,88 @@
+#ifndef WAL_RECOVERY_H
+#define WAL_RECOVERY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "wal_record.h"
+
+class KVStore;
+
+// 只读映射整个文件，析构时解除映射
+class MappedFile {
+public:
+    MappedFile() : data_(nullptr), size_(0) {}
+    ~MappedFile();
+
+    // 映射fd对应的文件，空文件不映射
+    void map(int fd, const std::string& path);
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    char* data_;
+    size_t size_;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+// 并行重放一段内存中的记录(映射的WAL或快照)
+// 按窗口处理：主线程只读长度字段划出记录边界并把窗口切成若干块；
+// 多个线程并行校验CRC、解码各块，并按键的哈希把记录(BATCH记录拆成各个条目)分到各分片；
+// 然后多个线程按分片应用，每个分片只由一个线程按块的顺序应用，因此同一个键的操作顺序与日志一致，且不需要加锁。
+class WalRecovery {
+public:
+    struct Result {
+        WalReader::Status status;   // END(数据用完或遇到长度为0的记录)、TRUNCATED或CORRUPT
+        size_t valid_size;          // 有效记录占用的字节数
+        uint64_t records;           // 应用的记录数
+    };
+
+    // threads为0时使用CPU核数
+    WalRecovery(KVStore& store, size_t threads);
+
+    // 重放data中的记录，遇到第一条损坏或不完整的记录时停止
+    Result replay(const char* data, size_t size);
+
+    // 实际使用的线程数
+    size_t threads() const { return threads_; }
+
+private:
+    // 一个SET/DEL条目在块内的位置(BATCH记录的每个条目各有一个)
+    struct RecordRef {
+        uint64_t hash;
+        uint32_t offset;
+    };
+
+    // 一个块：[begin, end)内是完整的记录，解码后按分片分组
+    struct Chunk {
+        size_t begin;
+        size_t end;
+        size_t valid_end;       // 解码遇到损坏记录时的位置
+        bool corrupt;
+        std::vector<std::vector<RecordRef>> parts;
+    };
+
+    // 解码一个块
+    void decode_chunk(const char* data, Chunk& chunk);
+
+    // 按条目的键把位置加入对应分片
+    void add_ref(Chunk& chunk, const char* base, const WalRecord& entry);
+
+    // 按块顺序应用一个分片的记录
+    uint64_t apply_shard(const char* data, size_t shard, size_t chunk_count);
+
+    // 用threads_个线程执行tasks个任务
+    void parallel_for(size_t tasks, const std::function<void(size_t)>& fn);
+
+    KVStore& store_;
+    size_t threads_;
+    std::vector<Chunk> chunks_;
+};
+
+#endif // WAL_RECOVERY_H
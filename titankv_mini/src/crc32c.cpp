@@ -0,0 +1,110 @@
+#include "../include/crc32c.h"
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+// 反转多项式
+static const uint32_t CRC32C_POLY = 0x82F63B78u;
+
+// slicing-by-8 查找表
+struct Crc32cTable {
+    uint32_t t[8][256];
+
+    Crc32cTable()
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t crc = i;
+            for (int k = 0; k < 8; ++k)
+            {
+                crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+            }
+            t[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            for (int k = 1; k < 8; ++k)
+            {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+static const Crc32cTable& crc_table()
+{
+    static const Crc32cTable table;
+    return table;
+}
+
+// 软件实现
+static uint32_t crc32c_sw(uint32_t crc, const char* data, size_t size)
+{
+    const Crc32cTable& tab = crc_table();
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+
+    while (size >= 8)
+    {
+        uint32_t lo;
+        uint32_t hi;
+        std::memcpy(&lo, p, 4);
+        std::memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = tab.t[7][lo & 0xFF] ^ tab.t[6][(lo >> 8) & 0xFF] ^
+              tab.t[5][(lo >> 16) & 0xFF] ^ tab.t[4][lo >> 24] ^
+              tab.t[3][hi & 0xFF] ^ tab.t[2][(hi >> 8) & 0xFF] ^
+              tab.t[1][(hi >> 16) & 0xFF] ^ tab.t[0][hi >> 24];
+        p += 8;
+        size -= 8;
+    }
+
+    while (size-- > 0)
+    {
+        crc = (crc >> 8) ^ tab.t[0][(crc ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+// 硬件实现
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const char* data, size_t size)
+{
+    uint64_t c = crc;
+    while (size >= 8)
+    {
+        uint64_t v;
+        std::memcpy(&v, data, 8);
+        c = _mm_crc32_u64(c, v);
+        data += 8;
+        size -= 8;
+    }
+
+    uint32_t c32 = static_cast<uint32_t>(c);
+    while (size-- > 0)
+    {
+        c32 = _mm_crc32_u8(c32, static_cast<unsigned char>(*data++));
+    }
+    return c32;
+}
+
+static bool has_sse42()
+{
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+}
+#endif
+
+uint32_t crc32c_extend(uint32_t crc, const char* data, size_t size)
+{
+    crc = ~crc;
+#if defined(__x86_64__)
+    if (has_sse42())
+    {
+        return ~crc32c_hw(crc, data, size);
+    }
+#endif
+    return ~crc32c_sw(crc, data, size);
+}
@@ -0,0 +1,191 @@
+#include "../include/epoch.h"
+
+// 线程退出时自动归还epoch记录
+struct EpochThreadHandle {
+    EpochManager::Record* record;
+
+    EpochThreadHandle() : record(nullptr) {}
+
+    ~EpochThreadHandle()
+    {
+        if (record)
+        {
+            EpochManager::instance().release_record(record);
+        }
+    }
+};
+
+static thread_local EpochThreadHandle t_epoch_handle;
+
+// 构造函数
+EpochManager::EpochManager() : global_epoch_(1), records_(nullptr), pending_(0)
+{
+}
+
+EpochManager& EpochManager::instance()
+{
+    // 故意不释放，保证线程退出时依旧可以访问
+    static EpochManager* manager = new EpochManager();
+    return *manager;
+}
+
+// 进入临界区
+EpochManager::Guard::Guard(EpochManager& manager) : record_(manager.local_record())
+{
+    if (record_->nesting++ == 0)
+    {
+        uint64_t epoch = manager.global_epoch_.load(std::memory_order_relaxed);
+        record_->state.store((epoch << 1) | 1, std::memory_order_relaxed);
+        // 保证之后对共享数据的读取不会被重排到发布状态之前
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+// 退出临界区
+EpochManager::Guard::~Guard()
+{
+    if (--record_->nesting == 0)
+    {
+        record_->state.store(0, std::memory_order_release);
+    }
+}
+
+// 获取当前线程的记录，优先复用已退出线程留下的记录
+EpochManager::Record* EpochManager::local_record()
+{
+    if (t_epoch_handle.record)
+    {
+        return t_epoch_handle.record;
+    }
+
+    for (Record* r = records_.load(std::memory_order_acquire); r; r = r->next)
+    {
+        bool expected = false;
+        if (!r->in_use.load(std::memory_order_relaxed) &&
+            r->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+        {
+            t_epoch_handle.record = r;
+            return r;
+        }
+    }
+
+    Record* r = new Record();
+    r->state.store(0, std::memory_order_relaxed);
+    r->in_use.store(true, std::memory_order_relaxed);
+    r->nesting = 0;
+    r->next = records_.load(std::memory_order_relaxed);
+    while (!records_.compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+
+    t_epoch_handle.record = r;
+    return r;
+}
+
+// 归还记录
+void EpochManager::release_record(Record* record)
+{
+    std::lock_guard<std::mutex> retired_lock(record->retired_mutex);
+    if (!record->retired.empty())
+    {
+        std::lock_guard<std::mutex> lock(orphan_mutex_);
+        orphans_.insert(orphans_.end(), record->retired.begin(), record->retired.end());
+        record->retired.clear();
+    }
+
+    record->state.store(0, std::memory_order_release);
+    record->nesting = 0;
+    record->in_use.store(false, std::memory_order_release);
+}
+
+// 延迟释放对象
+void EpochManager::retire(void* ptr, Deleter deleter)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    Record* record = local_record();
+    Retired item = {ptr, deleter, global_epoch_.load(std::memory_order_acquire)};
+    std::lock_guard<std::mutex> lock(record->retired_mutex);
+    record->retired.push_back(item);
+    pending_.fetch_add(1, std::memory_order_relaxed);
+
+    // 本线程积累够一批且不在临界区内时顺便回收
+    if (record->retired.size() >= COLLECT_THRESHOLD && record->nesting == 0)
+    {
+        try_advance();
+        reclaim(record->retired, global_epoch_.load(std::memory_order_acquire));
+    }
+}
+
+// 尝试推进epoch
+bool EpochManager::try_advance()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t epoch = global_epoch_.load(std::memory_order_acquire);
+
+    for (Record* r = records_.load(std::memory_order_acquire); r; r = r->next)
+    {
+        uint64_t state = r->state.load(std::memory_order_acquire);
+        // 仍有读者停留在旧epoch，不能推进
+        if ((state & 1) && (state >> 1) != epoch)
+        {
+            return false;
+        }
+    }
+
+    return global_epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel);
+}
+
+// 释放列表中安全的对象：retire时的epoch落后全局epoch两代以上即可释放
+size_t EpochManager::reclaim(std::vector<Retired>& list, uint64_t epoch)
+{
+    size_t freed = 0;
+    size_t kept = 0;
+
+    for (size_t i = 0; i < list.size(); ++i)
+    {
+        if (list[i].epoch + 2 <= epoch)
+        {
+            list[i].deleter(list[i].ptr);
+            ++freed;
+        }
+        else
+        {
+            list[kept++] = list[i];
+        }
+    }
+
+    list.resize(kept);
+    pending_.fetch_sub(freed, std::memory_order_relaxed);
+    return freed;
+}
+
+// 推进epoch并回收所有线程记录和孤儿列表中的对象
+// 只在本线程的列表上回收时，空闲的线程(如没有新请求的事件循环)留下的对象会一直得不到释放
+size_t EpochManager::collect()
+{
+    Record* record = local_record();
+    if (record->nesting != 0)
+    {
+        return 0;
+    }
+
+    // 连续推进两次，使刚retire的对象也有机会被回收
+    try_advance();
+    try_advance();
+    uint64_t epoch = global_epoch_.load(std::memory_order_acquire);
+
+    size_t freed = 0;
+    for (Record* r = records_.load(std::memory_order_acquire); r; r = r->next)
+    {
+        std::lock_guard<std::mutex> lock(r->retired_mutex);
+        freed += reclaim(r->retired, epoch);
+    }
+
+    std::lock_guard<std::mutex> lock(orphan_mutex_);
+    freed += reclaim(orphans_, epoch);
+    return freed;
+}
@@ -0,0 +1,544 @@
+#include "../include/hash_table.h"
+#include "../include/epoch.h"
+#include "../include/slab_allocator.h"
+#include <new>
+#include <utility>
+
+// 按字节并行处理8个控制字节(SWAR)
+static const uint64_t CTRL_LSBS = 0x0101010101010101ULL;
+static const uint64_t CTRL_MSBS = 0x8080808080808080ULL;
+static const uint64_t CTRL_ALL_EMPTY = 0x8080808080808080ULL;
+
+// 标签等于tag的字节(可能有少量误报，调用方需要再比较键)
+static inline uint64_t match_tag(uint64_t ctrl, uint8_t tag)
+{
+    uint64_t x = ctrl ^ (CTRL_LSBS * tag);
+    return (x - CTRL_LSBS) & ~x & CTRL_MSBS;
+}
+
+// 空字节(0x80)
+static inline uint64_t match_empty(uint64_t ctrl)
+{
+    return ctrl & ~(ctrl << 6) & CTRL_MSBS;
+}
+
+// 空或已删除的字节(最高位为1)
+static inline uint64_t match_free(uint64_t ctrl)
+{
+    return ctrl & CTRL_MSBS;
+}
+
+// 已占用的字节(最高位为0)
+static inline uint64_t match_full(uint64_t ctrl)
+{
+    return ~ctrl & CTRL_MSBS;
+}
+
+// 掩码中最低的命中位置
+static inline size_t lowest_index(uint64_t mask)
+{
+    return static_cast<size_t>(__builtin_ctzll(mask)) >> 3;
+}
+
+// 创建条目：头部和键值字节一次从slab分配
+Entry* Entry::create(uint64_t hash, std::string_view key, std::string_view value,
+                     std::chrono::steady_clock::time_point expiry)
+{
+    return create(hash, key.data(), key.size(), value.data(), value.size(), expiry);
+}
+
+Entry* Entry::create(uint64_t hash, const char* key, size_t key_size, const char* value, size_t value_size,
+                     std::chrono::steady_clock::time_point expiry)
+{
+    void* mem = SlabAllocator::instance().allocate(sizeof(Entry) + key_size + value_size);
+    Entry* e = new (mem) Entry();
+    e->hash = hash;
+    e->expiry = expiry;
+    e->key_size = static_cast<uint32_t>(key_size);
+    e->value_size = static_cast<uint32_t>(value_size);
+    e->refs.store(1, std::memory_order_relaxed);
+    e->meta.store(0, std::memory_order_relaxed);
+
+    char* data = reinterpret_cast<char*>(e + 1);
+    std::memcpy(data, key, key_size);
+    std::memcpy(data + key_size, value, value_size);
+    return e;
+}
+
+// 复制条目
+Entry* Entry::clone(const Entry* entry)
+{
+    void* mem = SlabAllocator::instance().allocate(entry->alloc_size());
+    Entry* e = new (mem) Entry();
+    e->hash = entry->hash;
+    e->expiry = entry->expiry;
+    e->key_size = entry->key_size;
+    e->value_size = entry->value_size;
+    e->refs.store(1, std::memory_order_relaxed);
+    e->meta.store(entry->meta.load(std::memory_order_relaxed) & META_ACCESS_MASK, std::memory_order_relaxed);
+    std::memcpy(reinterpret_cast<char*>(e + 1), entry->key_data(), entry->key_size + entry->value_size);
+    return e;
+}
+
+// 计入内存上限的字节数
+size_t Entry::charge() const
+{
+    return SlabAllocator::instance().chunk_size(alloc_size()) + sizeof(Entry*) + 1;
+}
+
+// 销毁条目
+void Entry::destroy(Entry* entry)
+{
+    if (entry)
+    {
+        size_t size = entry->alloc_size();
+        entry->~Entry();
+        SlabAllocator::instance().deallocate(entry, size);
+    }
+}
+
+// 释放引用
+void Entry::release(const Entry* entry)
+{
+    if (entry && entry->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        destroy(const_cast<Entry*>(entry));
+    }
+}
+
+// 表
+HashTable::Table::Table(size_t group_count) : group_mask(group_count - 1), groups(new Group[group_count]), used(0)
+{
+    for (size_t g = 0; g < group_count; ++g)
+    {
+        groups[g].ctrl.store(CTRL_ALL_EMPTY, std::memory_order_relaxed);
+        for (size_t i = 0; i < GROUP_SIZE; ++i)
+        {
+            groups[g].slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+}
+
+HashTable::Table::~Table()
+{
+    delete[] groups;
+}
+
+// 构造函数，组数向上取整为2的幂
+HashTable::HashTable(size_t capacity) : current_(nullptr), old_(nullptr), migrate_pos_(0), size_(0)
+{
+    size_t groups = 1;
+    while (groups * GROUP_SIZE < capacity)
+    {
+        groups <<= 1;
+    }
+    current_.store(new Table(groups), std::memory_order_release);
+}
+
+// 析构函数，此时不应再有并发读者
+HashTable::~HashTable()
+{
+    for_each([](const Entry* e) {
+        Entry::release(e);
+    });
+
+    delete old_.load(std::memory_order_relaxed);
+    delete current_.load(std::memory_order_relaxed);
+}
+
+size_t HashTable::capacity() const
+{
+    return current_.load(std::memory_order_relaxed)->capacity();
+}
+
+// 预取主组
+void HashTable::prefetch(uint64_t hash) const
+{
+    const Table* t = current_.load(std::memory_order_acquire);
+    const Group* group = &t->groups[home_group(hash, t->group_mask)];
+    // 一组72字节，可能跨两个缓存行
+    __builtin_prefetch(group);
+    __builtin_prefetch(reinterpret_cast<const char*>(group + 1) - 1);
+}
+
+// 在一张表中查找：从主组开始按三角数序列探测，遇到含空槽的组即可停止
+const Entry* HashTable::probe(const Table* t, uint64_t hash, const char* key, size_t key_size, Slot* where)
+{
+    const uint8_t tag = tag_of(hash);
+    size_t g = home_group(hash, t->group_mask);
+
+    for (size_t step = 0; step <= t->group_mask; ++step)
+    {
+        const Group& group = t->groups[g];
+        uint64_t ctrl = group.ctrl.load(std::memory_order_acquire);
+
+        for (uint64_t m = match_tag(ctrl, tag); m; m &= m - 1)
+        {
+            size_t i = lowest_index(m);
+            const Entry* e = group.slots[i].load(std::memory_order_acquire);
+            if (e && e->hash == hash && e->key_equals(key, key_size))
+            {
+                if (where)
+                {
+                    where->group = g;
+                    where->index = i;
+                }
+                return e;
+            }
+        }
+
+        if (match_empty(ctrl))
+        {
+            return nullptr;
+        }
+        g = (g + step + 1) & t->group_mask;
+    }
+    return nullptr;
+}
+
+// 找一个空或已删除的槽位，负载因子保证一定能找到
+HashTable::Slot HashTable::find_free(const Table* t, uint64_t hash)
+{
+    size_t g = home_group(hash, t->group_mask);
+    for (size_t step = 0; ; ++step)
+    {
+        uint64_t m = match_free(t->groups[g].ctrl.load(std::memory_order_relaxed));
+        if (m)
+        {
+            Slot slot = {g, lowest_index(m)};
+            return slot;
+        }
+        g = (g + step + 1) & t->group_mask;
+    }
+}
+
+// 修改控制字节，整组以release语义发布
+void HashTable::set_ctrl(Table* t, const Slot& slot, uint8_t value)
+{
+    std::atomic<uint64_t>& ctrl = t->groups[slot.group].ctrl;
+    uint64_t word = ctrl.load(std::memory_order_relaxed);
+    const unsigned shift = static_cast<unsigned>(slot.index * 8);
+    word = (word & ~(0xFFULL << shift)) | (static_cast<uint64_t>(value) << shift);
+    ctrl.store(word, std::memory_order_release);
+}
+
+// 放入条目：先写指针再写标签，读者看到标签时一定能看到指针
+void HashTable::place(Table* t, const Slot& slot, Entry* entry)
+{
+    Group& group = t->groups[slot.group];
+    uint8_t old_ctrl = static_cast<uint8_t>(group.ctrl.load(std::memory_order_relaxed) >> (slot.index * 8));
+    if (old_ctrl == CTRL_EMPTY)
+    {
+        ++t->used;
+    }
+
+    group.slots[slot.index].store(entry, std::memory_order_release);
+    set_ctrl(t, slot, tag_of(entry->hash));
+}
+
+// 清空槽位：如果组内还有空槽，探测本来就会在这组停下，可以直接标记为空
+void HashTable::clear(Table* t, const Slot& slot)
+{
+    Group& group = t->groups[slot.group];
+    if (match_empty(group.ctrl.load(std::memory_order_relaxed)))
+    {
+        set_ctrl(t, slot, CTRL_EMPTY);
+        --t->used;
+    }
+    else
+    {
+        set_ctrl(t, slot, CTRL_DELETED);
+    }
+    group.slots[slot.index].store(nullptr, std::memory_order_release);
+}
+
+// 无锁查找：先查当前表，没有再查迁移中的旧表
+const Entry* HashTable::find(uint64_t hash, std::string_view key) const
+{
+    const Table* cur = current_.load(std::memory_order_acquire);
+    const Table* old = old_.load(std::memory_order_acquire);
+
+    const Entry* e = probe(cur, hash, key.data(), key.size(), nullptr);
+    if (!e && old && old != cur)
+    {
+        e = probe(old, hash, key.data(), key.size(), nullptr);
+    }
+    return e;
+}
+
+// 插入或替换
+Entry* HashTable::insert(Entry* entry)
+{
+    migrate_step(MIGRATE_GROUPS_PER_OP);
+
+    Table* cur = current_.load(std::memory_order_relaxed);
+    Table* old = old_.load(std::memory_order_relaxed);
+    const char* key = entry->key_data();
+    const size_t key_size = entry->key_size;
+    Slot slot;
+
+    // 旧表中的键在迁移完成前必须保持最新，已迁移的键两张表同时更新
+    if (old)
+    {
+        Entry* prev = const_cast<Entry*>(probe(old, entry->hash, key, key_size, &slot));
+        if (prev)
+        {
+            old->groups[slot.group].slots[slot.index].store(entry, std::memory_order_release);
+            if (slot.group < migrate_pos_ && probe(cur, entry->hash, key, key_size, &slot))
+            {
+                cur->groups[slot.group].slots[slot.index].store(entry, std::memory_order_release);
+            }
+            return prev;
+        }
+    }
+
+    Entry* prev = const_cast<Entry*>(probe(cur, entry->hash, key, key_size, &slot));
+    if (prev)
+    {
+        // 原地替换，读者看到的要么是旧条目要么是新条目
+        cur->groups[slot.group].slots[slot.index].store(entry, std::memory_order_release);
+        return prev;
+    }
+
+    place(cur, find_free(cur, entry->hash), entry);
+    ++size_;
+    maybe_grow();
+    return nullptr;
+}
+
+// 删除
+Entry* HashTable::erase(uint64_t hash, std::string_view key)
+{
+    migrate_step(MIGRATE_GROUPS_PER_OP);
+
+    Table* cur = current_.load(std::memory_order_relaxed);
+    Table* old = old_.load(std::memory_order_relaxed);
+    Slot slot;
+
+    if (old)
+    {
+        Entry* prev = const_cast<Entry*>(probe(old, hash, key.data(), key.size(), &slot));
+        if (prev)
+        {
+            bool migrated = slot.group < migrate_pos_;
+            clear(old, slot);
+            if (migrated && probe(cur, hash, key.data(), key.size(), &slot))
+            {
+                clear(cur, slot);
+            }
+            --size_;
+            return prev;
+        }
+    }
+
+    Entry* prev = const_cast<Entry*>(probe(cur, hash, key.data(), key.size(), &slot));
+    if (prev)
+    {
+        clear(cur, slot);
+        --size_;
+    }
+    return prev;
+}
+
+// 占用率超过7/8时开始渐进式扩容(有效条目不足一半时只做同容量重建以清理已删除槽位)
+void HashTable::maybe_grow()
+{
+    Table* cur = current_.load(std::memory_order_relaxed);
+    if (cur->used * 8 < cur->capacity() * 7)
+    {
+        return;
+    }
+
+    // 上一次迁移还没结束(极少见)，先同步完成
+    if (old_.load(std::memory_order_relaxed))
+    {
+        finish_migration();
+        cur = current_.load(std::memory_order_relaxed);
+    }
+
+    size_t groups = cur->group_mask + 1;
+    if (size_ * 2 > cur->capacity())
+    {
+        groups *= 2;
+    }
+
+    // 先发布旧表再发布新表，读者读到新表时一定能读到旧表
+    old_.store(cur, std::memory_order_release);
+    current_.store(new Table(groups), std::memory_order_release);
+    migrate_pos_ = 0;
+}
+
+// 迁移旧表中的若干组，只复制指针，条目本身不动
+bool HashTable::migrate_step(size_t groups)
+{
+    Table* old = old_.load(std::memory_order_relaxed);
+    if (!old)
+    {
+        return false;
+    }
+    Table* cur = current_.load(std::memory_order_relaxed);
+
+    for (size_t n = 0; n < groups && migrate_pos_ <= old->group_mask; ++n, ++migrate_pos_)
+    {
+        const Group& group = old->groups[migrate_pos_];
+        for (uint64_t m = match_full(group.ctrl.load(std::memory_order_relaxed)); m; m &= m - 1)
+        {
+            Entry* e = group.slots[lowest_index(m)].load(std::memory_order_relaxed);
+            place(cur, find_free(cur, e->hash), e);
+        }
+    }
+
+    if (migrate_pos_ <= old->group_mask)
+    {
+        return true;
+    }
+
+    // 迁移完成，旧表可能仍被读者引用，交给epoch延迟释放
+    old_.store(nullptr, std::memory_order_release);
+    migrate_pos_ = 0;
+    EpochManager::instance().retire(old);
+    return false;
+}
+
+// 同步完成当前迁移
+void HashTable::finish_migration()
+{
+    Table* old = old_.load(std::memory_order_relaxed);
+    if (old)
+    {
+        migrate_step(old->group_mask + 1);
+    }
+}
+
+// 遍历：旧表中尚未迁移的组 + 当前表
+void HashTable::for_each(const std::function<void(const Entry*)>& fn) const
+{
+    const Table* old = old_.load(std::memory_order_relaxed);
+    if (old)
+    {
+        for (size_t g = migrate_pos_; g <= old->group_mask; ++g)
+        {
+            const Group& group = old->groups[g];
+            for (uint64_t m = match_full(group.ctrl.load(std::memory_order_relaxed)); m; m &= m - 1)
+            {
+                fn(group.slots[lowest_index(m)].load(std::memory_order_relaxed));
+            }
+        }
+    }
+
+    const Table* cur = current_.load(std::memory_order_relaxed);
+    for (size_t g = 0; g <= cur->group_mask; ++g)
+    {
+        const Group& group = cur->groups[g];
+        for (uint64_t m = match_full(group.ctrl.load(std::memory_order_relaxed)); m; m &= m - 1)
+        {
+            fn(group.slots[lowest_index(m)].load(std::memory_order_relaxed));
+        }
+    }
+}
+
+// 抽样：当前表从start对应的组开始绕一圈，不够时再取旧表中尚未迁移的组
+size_t HashTable::sample(uint64_t start, const Entry** out, size_t n) const
+{
+    const Table* cur = current_.load(std::memory_order_relaxed);
+    size_t count = sample_table(cur, 0, start, out, 0, n);
+
+    const Table* old = old_.load(std::memory_order_relaxed);
+    if (old && count < n && migrate_pos_ <= old->group_mask)
+    {
+        count = sample_table(old, migrate_pos_, start, out, count, n);
+    }
+    return count;
+}
+
+size_t HashTable::sample_table(const Table* t, size_t first, size_t start, const Entry** out, size_t count, size_t n)
+{
+    // 只看[first, 组数)范围内的组，从其中按start选出的组开始
+    const size_t groups = t->group_mask + 1 - first;
+    for (size_t i = 0; i < groups && count < n; ++i)
+    {
+        const Group& group = t->groups[first + (start + i) % groups];
+        for (uint64_t m = match_full(group.ctrl.load(std::memory_order_relaxed)); m && count < n; m &= m - 1)
+        {
+            out[count++] = group.slots[lowest_index(m)].load(std::memory_order_relaxed);
+        }
+    }
+    return count;
+}
+
+// 增量遍历：没有迁移时只看当前表；迁移中时先看较小的表中的主组，再看较大的表中由它展开的所有主组
+// (与Redis的dictScan相同)，旧表只看尚未迁移的组，已迁移的条目都在当前表中
+uint64_t HashTable::scan(uint64_t cursor, const std::function<void(const Entry*)>& fn) const
+{
+    const Table* cur = current_.load(std::memory_order_relaxed);
+    const Table* old = old_.load(std::memory_order_relaxed);
+    if (!old)
+    {
+        scan_home(cur, 0, cursor & cur->group_mask, fn);
+        return next_cursor(cursor, cur->group_mask);
+    }
+
+    const Table* small = old;
+    const Table* large = cur;
+    size_t small_first = migrate_pos_;
+    size_t large_first = 0;
+    if (small->group_mask > large->group_mask)
+    {
+        std::swap(small, large);
+        std::swap(small_first, large_first);
+    }
+    const uint64_t m0 = small->group_mask;
+    const uint64_t m1 = large->group_mask;
+
+    scan_home(small, small_first, cursor & m0, fn);
+    do {
+        scan_home(large, large_first, cursor & m1, fn);
+        cursor = next_cursor(cursor, m1);
+    } while (cursor & (m0 ^ m1));
+    return cursor;
+}
+
+// 主组为home的条目只可能出现在从home开始的探测序列上，查找在含空槽的组停下，这里也一样
+void HashTable::scan_home(const Table* t, size_t first, size_t home, const std::function<void(const Entry*)>& fn)
+{
+    size_t g = home;
+    for (size_t step = 0; step <= t->group_mask; ++step)
+    {
+        const Group& group = t->groups[g];
+        const uint64_t ctrl = group.ctrl.load(std::memory_order_relaxed);
+        if (g >= first)
+        {
+            for (uint64_t m = match_full(ctrl); m; m &= m - 1)
+            {
+                const Entry* e = group.slots[lowest_index(m)].load(std::memory_order_relaxed);
+                if (home_group(e->hash, t->group_mask) == home)
+                {
+                    fn(e);
+                }
+            }
+        }
+        if (match_empty(ctrl))
+        {
+            return;
+        }
+        g = (g + step + 1) & t->group_mask;
+    }
+}
+
+// 64位反转
+static inline uint64_t reverse_bits(uint64_t v)
+{
+    v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+    v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return __builtin_bswap64(v);
+}
+
+// 把mask以外的位置1再反转加一，进位从mask内的最高位开始，扩容后新增的高位会在低位之前被遍历
+uint64_t HashTable::next_cursor(uint64_t cursor, uint64_t mask)
+{
+    cursor |= ~mask;
+    cursor = reverse_bits(cursor);
+    ++cursor;
+    return reverse_bits(cursor);
+}
@@ -0,0 +1,150 @@
+#include "../include/hot_keys.h"
+#include <algorithm>
+
+thread_local int32_t HotKeyTracker::tls_countdown_ = 1;
+
+// 本线程的随机数(xorshift)，用于采样间隔
+static thread_local uint64_t tls_sample_random = 0x2545f4914f6cdd1dULL ^ reinterpret_cast<uintptr_t>(&tls_sample_random);
+
+static uint64_t next_sample_random()
+{
+    tls_sample_random ^= tls_sample_random << 13;
+    tls_sample_random ^= tls_sample_random >> 7;
+    tls_sample_random ^= tls_sample_random << 17;
+    return tls_sample_random;
+}
+
+// 每行使用不同的乘数从哈希值中取出位置
+static const uint64_t SKETCH_SEEDS[HotKeyTracker::SKETCH_DEPTH] = {
+    0x9e3779b97f4a7c15ULL, 0xbf58476d1ce4e5b9ULL, 0x94d049bb133111ebULL, 0xd6e8feb86659fd93ULL
+};
+
+// 堆按计数比较，堆顶最小
+static bool hotter(const HotKey& a, const HotKey& b)
+{
+    return a.count > b.count;
+}
+
+// 构造
+HotKeyTracker::HotKeyTracker(uint32_t rate, size_t top) : rate_(std::min(rate, MAX_RATE)), top_(top), heap_min_(0)
+{
+    for (size_t row = 0; row < SKETCH_DEPTH; ++row)
+    {
+        for (size_t i = 0; i < SKETCH_WIDTH; ++i)
+        {
+            sketch_[row][i].store(0, std::memory_order_relaxed);
+        }
+    }
+    heap_.reserve(top_);
+}
+
+// 计数器位置
+size_t HotKeyTracker::slot(uint64_t hash, size_t row)
+{
+    return static_cast<size_t>((hash * SKETCH_SEEDS[row]) >> 32) & (SKETCH_WIDTH - 1);
+}
+
+// 处理一次采样
+void HotKeyTracker::sampled(uint64_t hash, std::string_view key)
+{
+    // 下一次采样的间隔在[1, 2*rate-1]中随机，平均为rate，避免与访问模式同步
+    tls_countdown_ = static_cast<int32_t>(1 + next_sample_random() % (2 * static_cast<uint64_t>(rate_) - 1));
+
+    // 所有行加1，最小值就是估计的频率
+    uint32_t estimate = UINT32_MAX;
+    for (size_t row = 0; row < SKETCH_DEPTH; ++row)
+    {
+        uint32_t count = sketch_[row][slot(hash, row)].fetch_add(1, std::memory_order_relaxed) + 1;
+        estimate = std::min(estimate, count);
+    }
+
+    // 估计值不超过堆中最小的计数：不会进入top-K，已在其中时计数也不会变大
+    if (top_ == 0 || estimate <= heap_min_.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(heap_mutex_);
+    // 已在top-K中的键更新计数，堆很小，直接线性查找
+    for (size_t i = 0; i < heap_.size(); ++i)
+    {
+        if (heap_[i].hash == hash && heap_[i].key == key)
+        {
+            if (estimate > heap_[i].count)
+            {
+                heap_[i].count = estimate;
+                std::make_heap(heap_.begin(), heap_.end(), hotter);
+                update_min();
+            }
+            return;
+        }
+    }
+
+    if (heap_.size() < top_)
+    {
+        heap_.push_back(HotKey{std::string(key), hash, estimate});
+        std::push_heap(heap_.begin(), heap_.end(), hotter);
+    }
+    else if (estimate > heap_.front().count)
+    {
+        // 替换当前最冷的键
+        std::pop_heap(heap_.begin(), heap_.end(), hotter);
+        heap_.back().key.assign(key.data(), key.size());
+        heap_.back().hash = hash;
+        heap_.back().count = estimate;
+        std::push_heap(heap_.begin(), heap_.end(), hotter);
+    }
+    update_min();
+}
+
+// 更新堆满时的最小计数，调用方持有heap_mutex_
+void HotKeyTracker::update_min()
+{
+    heap_min_.store(heap_.size() < top_ ? 0 : heap_.front().count, std::memory_order_relaxed);
+}
+
+// 最热的n个键
+std::vector<HotKey> HotKeyTracker::top(size_t n) const
+{
+    std::vector<HotKey> result;
+    {
+        std::lock_guard<std::mutex> lock(heap_mutex_);
+        result = heap_;
+    }
+    std::sort(result.begin(), result.end(), hotter);
+    if (result.size() > n)
+    {
+        result.resize(n);
+    }
+    for (HotKey& hot : result)
+    {
+        hot.count *= rate_;
+    }
+    return result;
+}
+
+// 计数减半，减到0的键移出top-K；与并发的记录之间可能丢失少量计数
+void HotKeyTracker::decay()
+{
+    for (size_t row = 0; row < SKETCH_DEPTH; ++row)
+    {
+        for (size_t i = 0; i < SKETCH_WIDTH; ++i)
+        {
+            uint32_t count = sketch_[row][i].load(std::memory_order_relaxed);
+            if (count)
+            {
+                sketch_[row][i].store(count >> 1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(heap_mutex_);
+    for (HotKey& hot : heap_)
+    {
+        hot.count >>= 1;
+    }
+    heap_.erase(std::remove_if(heap_.begin(), heap_.end(), [](const HotKey& hot) { return hot.count == 0; }),
+                heap_.end());
+    std::make_heap(heap_.begin(), heap_.end(), hotter);
+    update_min();
+}
@@ -0,0 +1,224 @@
+#include "../include/io_uring.h"
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// 系统调用封装
+static int sys_io_uring_setup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+IoUring::IoUring()
+    : ring_fd_(-1), sq_ring_(MAP_FAILED), sq_ring_size_(0), cq_ring_(MAP_FAILED), cq_ring_size_(0),
+      sqes_(nullptr), sqes_size_(0), sq_head_(nullptr), sq_tail_(nullptr), sq_array_(nullptr), sq_mask_(0),
+      sq_entries_(0), sq_local_tail_(0), cq_head_(nullptr), cq_tail_(nullptr), cq_mask_(0), cqes_(nullptr)
+{
+}
+
+IoUring::~IoUring()
+{
+    release();
+}
+
+// 创建队列并映射共享内存环
+bool IoUring::init(unsigned entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = sys_io_uring_setup(entries, &params);
+    if (fd < 0)
+    {
+        return false;
+    }
+    ring_fd_ = fd;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+    {
+        sq_ring_size_ = cq_ring_size_ = sq_ring_size_ > cq_ring_size_ ? sq_ring_size_ : cq_ring_size_;
+    }
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                    IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED)
+    {
+        int err = errno;
+        release();
+        errno = err;
+        return false;
+    }
+    if (single_mmap)
+    {
+        cq_ring_ = sq_ring_;
+    }
+    else
+    {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                        IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED)
+        {
+            int err = errno;
+            release();
+            errno = err;
+            return false;
+        }
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                      IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        int err = errno;
+        release();
+        errno = err;
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sq_local_tail_ = *sq_tail_;
+
+    char* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // 提交项与索引数组一一对应，之后不再修改
+    for (unsigned i = 0; i < sq_entries_; ++i)
+    {
+        sq_array_[i] = i;
+    }
+    return true;
+}
+
+// 释放映射和文件描述符
+void IoUring::release()
+{
+    if (sqes_)
+    {
+        munmap(sqes_, sqes_size_);
+        sqes_ = nullptr;
+    }
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+    {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    cq_ring_ = MAP_FAILED;
+    if (sq_ring_ != MAP_FAILED)
+    {
+        munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = MAP_FAILED;
+    }
+    if (ring_fd_ >= 0)
+    {
+        close(ring_fd_);
+        ring_fd_ = -1;
+    }
+}
+
+// 取一个空闲的提交项
+io_uring_sqe* IoUring::get_sqe()
+{
+    // 内核消费提交项后推进head
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sq_local_tail_ - head >= sq_entries_)
+    {
+        return nullptr;
+    }
+    io_uring_sqe* sqe = &sqes_[sq_local_tail_ & sq_mask_];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++sq_local_tail_;
+    return sqe;
+}
+
+void IoUring::prep_write(io_uring_sqe* sqe, int fd, const void* buf, size_t len, uint64_t offset,
+                         uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = static_cast<uint32_t>(len);
+    sqe->off = offset;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prep_fdatasync(io_uring_sqe* sqe, int fd, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prep_nop(io_uring_sqe* sqe, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = user_data;
+}
+
+// 提交所有取出的提交项
+bool IoUring::submit()
+{
+    unsigned pending = sq_local_tail_ - *sq_tail_;
+    // 先写完提交项再发布tail，内核才能看到完整的内容
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+
+    while (pending > 0)
+    {
+        int n = sys_io_uring_enter(ring_fd_, pending, 0, 0);
+        if (n < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+            {
+                continue;
+            }
+            return false;
+        }
+        pending -= static_cast<unsigned>(n);
+    }
+    return true;
+}
+
+// 等待完成事件
+size_t IoUring::wait(io_uring_cqe* cqes, size_t max)
+{
+    for (;;)
+    {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        if (head != tail)
+        {
+            size_t n = 0;
+            while (head != tail && n < max)
+            {
+                cqes[n++] = cqes_[head & cq_mask_];
+                ++head;
+            }
+            // 读完再推进head，内核才能复用这些位置
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+            return n;
+        }
+
+        if (sys_io_uring_enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+        {
+            return 0;
+        }
+    }
+}
@@ -1,16 +1,190 @@
 #include "../include/kvstore.h"
 #include "../include/wal.h"
+#include "../include/epoch.h"
+#include "../include/metrics.h"
 #include <vector>
 #include <algorithm>
 #include <iostream>
 #include <thread>
+#include <stdexcept>
+
+// 清理线程的节拍，与时间轮的tick一致
+static const std::chrono::milliseconds CLEANUP_TICK(10);
+// 清理线程每个节拍为每个分片迁移的组数
+static const size_t CLEANUP_MIGRATE_GROUPS = 16;
+// 后台内存整理的间隔
+static const std::chrono::seconds COMPACT_INTERVAL(30);
+// 自动快照失败后重试的间隔
+static const std::chrono::seconds SNAPSHOT_RETRY_INTERVAL(60);
+// 访问时钟的精度，24位时钟约19天回绕一次，比较空闲时间时按模计算
+static const std::chrono::milliseconds ACCESS_CLOCK_RESOLUTION(100);
+// LFU：访问信息的高16位是最近一次衰减的分钟数，低8位是对数计数器
+static const uint32_t LFU_INIT_VAL = 5;        // 新键的计数，避免刚写入就被淘汰
+static const double LFU_LOG_FACTOR = 10;       // 计数越大，再增加1需要的访问次数越多
+static const uint32_t LFU_DECAY_MINUTES = 1;   // 每经过这么多分钟计数减1
+// 每次淘汰在一个分片中抽样的条目数
+static const size_t EVICTION_SAMPLES = 16;
+// 热点键计数减半的间隔
+static const std::chrono::seconds HOTKEY_DECAY_INTERVAL(10);
+// SCAN每次调用最多访问count的多少倍个主组(键很稀疏或大多不匹配时也能及时返回)
+static const size_t SCAN_VISIT_FACTOR = 10;
+// 范围查询每次持有分片锁最多从有序索引复制的键数
+static const size_t RANGE_BATCH = 128;
+
+// 本线程是否延迟等待日志持久化，以及延迟期间写入的最大LSN
+static thread_local bool tls_defer_sync = false;
+static thread_local uint64_t tls_deferred_lsn = 0;
+
+// 本线程的随机数(xorshift)，用于LFU计数和淘汰抽样的起点
+static thread_local uint64_t tls_random = 0x9e3779b97f4a7c15ULL ^ reinterpret_cast<uintptr_t>(&tls_random);
+
+static uint64_t next_random()
+{
+    tls_random ^= tls_random << 13;
+    tls_random ^= tls_random >> 7;
+    tls_random ^= tls_random << 17;
+    return tls_random;
+}
+
+// 当前的访问时钟
+static uint32_t access_clock_now()
+{
+    auto ticks = std::chrono::steady_clock::now().time_since_epoch() / ACCESS_CLOCK_RESOLUTION;
+    return static_cast<uint32_t>(ticks) & Entry::META_ACCESS_MASK;
+}
+
+// LFU的分钟时钟(16位)
+static uint32_t lfu_minutes(uint32_t clock)
+{
+    const uint32_t ticks_per_minute = static_cast<uint32_t>(std::chrono::minutes(1) / ACCESS_CLOCK_RESOLUTION);
+    return (clock / ticks_per_minute) & 0xFFFF;
+}
+
+// LFU：按经过的时间衰减后的计数
+static uint32_t lfu_decayed(uint32_t access, uint32_t clock)
+{
+    uint32_t counter = access & 0xFF;
+    uint32_t elapsed = (lfu_minutes(clock) - (access >> 8)) & 0xFFFF;
+    uint32_t periods = elapsed / LFU_DECAY_MINUTES;
+    return periods >= counter ? 0 : counter - periods;
+}
+
+// 淘汰策略名转换
+bool parse_eviction_policy(const std::string& name, EvictionPolicy& policy)
+{
+    if (name == "noeviction")
+    {
+        policy = EvictionPolicy::NoEviction;
+    }
+    else if (name == "allkeys-lru")
+    {
+        policy = EvictionPolicy::AllKeysLru;
+    }
+    else if (name == "allkeys-lfu")
+    {
+        policy = EvictionPolicy::AllKeysLfu;
+    }
+    else if (name == "volatile-ttl")
+    {
+        policy = EvictionPolicy::VolatileTtl;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+const char* eviction_policy_name(EvictionPolicy policy)
+{
+    switch (policy)
+    {
+    case EvictionPolicy::NoEviction:
+        return "noeviction";
+    case EvictionPolicy::AllKeysLru:
+        return "allkeys-lru";
+    case EvictionPolicy::AllKeysLfu:
+        return "allkeys-lfu";
+    case EvictionPolicy::VolatileTtl:
+        return "volatile-ttl";
+    }
+    return "unknown";
+}
+
+// 分片
+KVStore::Shard::Shard() : wheel(CLEANUP_TICK, std::chrono::steady_clock::now()), memory(0)
+{
+}
 
 // 构造函数
-KVStore::KVStore(const std::string& wal_path) : wal(nullptr), ttl_cleanup_running_(false)
+KVStore::KVStore(const std::string& wal_path, size_t shard_count)
+    : shard_mask_(0), wal(nullptr), ttl_cleanup_running_(false), expired_queue_(nullptr), expired_keys_(0),
+      evicted_keys_(0), evict_cursor_(0), access_clock_(0), track_access_(false),
+      hot_keys_(config_.hotkey_sample_rate), snapshot_running_(false)
+{
+    config_.wal_path = wal_path;
+    config_.shard_count = shard_count;
+    init();
+}
+
+// 使用完整配置构造
+KVStore::KVStore(const StoreConfig& config)
+    : config_(config), shard_mask_(0), wal(nullptr), ttl_cleanup_running_(false), expired_queue_(nullptr), expired_keys_(0),
+      evicted_keys_(0), evict_cursor_(0), access_clock_(0), track_access_(false),
+      hot_keys_(config.hotkey_sample_rate), snapshot_running_(false)
 {
+    init();
+}
+
+// 初始化分片并恢复数据
+void KVStore::init()
+{
+    const size_t shard_count = config_.shard_count;
+
+    // 分片数必须是2的幂，这样可以用掩码代替取模
+    if (shard_count == 0 || (shard_count & (shard_count - 1)) != 0)
+    {
+        throw std::invalid_argument("Shard count must be a power of two");
+    }
+
+    if (config_.expire_batch == 0)
+    {
+        throw std::invalid_argument("Expire batch must be positive");
+    }
+
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i)
+    {
+        shards_.emplace_back(new Shard());
+        if (config_.ordered_index)
+        {
+            shards_.back()->index.reset(new OrderedIndex());
+        }
+    }
+    shard_mask_ = shard_count - 1;
+
+    // 只有按访问淘汰时，读者才需要更新条目的访问信息
+    track_access_ = config_.maxmemory > 0 &&
+        (config_.eviction == EvictionPolicy::AllKeysLru || config_.eviction == EvictionPolicy::AllKeysLfu);
+    access_clock_.store(access_clock_now(), std::memory_order_relaxed);
+
+    if (config_.snapshot_path.empty())
+    {
+        config_.snapshot_path = config_.wal_path + ".snapshot";
+    }
+
     try {
-        wal = new WAL(wal_path);
-        wal->replay(*this); // 启动时恢复数据
+        wal = new WAL(config_.wal_path, config_.wal_sync, config_.wal_segment_size, config_.wal_io);
+        // 启动时先加载快照，再重放快照之后的日志
+        uint64_t covered = load_snapshot(config_.snapshot_path, *this, config_.recovery_threads);
+        wal->replay(*this, covered, config_.recovery_threads);
+
+        // 恢复的数据超过上限时不在启动时淘汰，之后的写入会先腾出空间
+        if (config_.maxmemory > 0 && used_memory() > config_.maxmemory)
+        {
+            std::cerr << "Warning: recovered data uses " << used_memory() << " bytes, above maxmemory "
+                      << config_.maxmemory << std::endl;
+        }
 
         // 启动TTL清理线程
         ttl_cleanup_running_ = true;
@@ -34,171 +208,1293 @@ KVStore::~KVStore()
         ttl_cleanup_thread_.join();
     }
 
+    // 等待后台快照完成
+    {
+        std::lock_guard<std::mutex> lock(snapshot_thread_mutex_);
+        if (snapshot_thread_.joinable())
+        {
+            snapshot_thread_.join();
+        }
+    }
+
+    // 释放延迟删除队列中剩余的节点
+    ExpiredNode* node = expired_queue_.exchange(nullptr);
+    while (node)
+    {
+        ExpiredNode* next = node->next;
+        delete node;
+        node = next;
+    }
+
     if (wal)
     {
         delete wal;
         wal = nullptr;
     }
+
+    EpochManager::instance().collect();
 }
 
 // SET
-void KVStore::set(const std::string& key, const std::string& value, bool log)
+void KVStore::set(std::string_view key, std::string_view value, bool log)
+{
+    // 设置永不过期
+    set_with_deadline(key, value, std::chrono::steady_clock::time_point::max(), log);
+}
+
+// 设置带有过期时间的键值对
+void KVStore::set_with_ttl(std::string_view key, std::string_view value, std::chrono::seconds ttl, bool log)
+{
+    if (ttl.count() < 0)
+    {
+        throw std::invalid_argument("TTL must be positive");
+    }
+
+    // 设置值和过期时间
+    auto expiry_time = std::chrono::steady_clock::now() + ttl; // 在将来某个时间点过期，这个时间点就是expiry_time，既是一个时间戳
+    set_with_deadline(key, value, expiry_time, log);
+}
+
+// 设置键值对和绝对过期时间点
+void KVStore::set_with_deadline(std::string_view key, std::string_view value,
+                                std::chrono::steady_clock::time_point deadline, bool log)
 {
     if (key.empty())
     {
         throw std::invalid_argument("Key cannot be empty");
     }
-    
-    std::lock_guard<std::mutex> lock(mutex_);
 
-    // 记录到WAL
-    if (log && wal)
+    // 在锁外构造新条目
+    const bool has_ttl = deadline != std::chrono::steady_clock::time_point::max();
+    const int64_t expire_at_ms = has_ttl ? steady_to_unix_ms(deadline) : 0;
+    uint64_t hash = hash_key(key);
+    hot_keys_.record(hash, key);
+    Entry* entry = Entry::create(hash, key, value, deadline);
+    Shard& shard = shard_at(hash);
+    Entry* old = nullptr;
+    uint64_t lsn = 0;
+
+    // 超过内存上限时先淘汰(不持有任何分片锁)
+    try {
+        make_room(entry->charge());
+    } catch (...) {
+        Entry::destroy(entry);
+        throw;
+    }
+
+    {
+        TimedLock lock(shard.mutex);
+
+        // 记录到WAL(只追加到内存缓冲区，保证日志顺序与修改顺序一致)，过期时间和值在同一条记录中
+        if (log && wal)
+        {
+            lsn = wal->log_set(key, value, expire_at_ms);
+        }
+
+        // 发布新条目
+        old = shard.table.insert(entry);
+        init_access(entry, old);
+        account(shard, entry, old);
+
+        // 挂到时间轮上，到期时由清理线程删除
+        // 旧条目的定时器不晚于新的过期时间时沿用它(到期时按新的过期时间重新挂上)，反复刷新TTL不会堆积定时器
+        if (has_ttl && (!old || old->expiry > deadline))
+        {
+            shard.wheel.add(std::string(key), deadline);
+        }
+    }
+
+    // 旧条目可能仍被读者引用，交给epoch延迟释放
+    if (old)
     {
-        wal->log_set(key, value);
+        EpochManager::instance().retire(old, &Entry::release_ptr);
     }
 
-    // 更新数据,并设置永不过期
-    data_[key] = {value, std::chrono::steady_clock::time_point::max()};
+    // 释放分片锁之后再等待日志持久化
+    if (lsn)
+    {
+        wait_durable(lsn);
+    }
 }
 
-// 设置带有过期时间的键值对
-void KVStore::set_with_ttl(const std::string& key, const std::string& value, std::chrono::seconds ttl, bool log = true)
+// 恢复专用的SET：没有读者也没有其他写者，旧条目直接释放
+void KVStore::recover_set(uint64_t hash, const std::string& key, const char* value, size_t value_size,
+                          std::chrono::steady_clock::time_point deadline)
 {
-    if (key.empty())
+    Shard& shard = shard_at(hash);
+    Entry* entry = Entry::create(hash, key.data(), key.size(), value, value_size, deadline);
+    Entry* old = shard.table.insert(entry);
+    init_access(entry, nullptr);
+    account(shard, entry, old);
+    // 与set_with_deadline相同，旧条目的定时器不晚于新的过期时间时沿用
+    if (deadline != std::chrono::steady_clock::time_point::max() && (!old || old->expiry > deadline))
     {
-        throw std::invalid_argument("Key cannot be empty");
+        shard.wheel.add(key, deadline);
+    }
+    if (old)
+    {
+        Entry::destroy(old);
     }
+}
 
-    if (ttl.count() < 0)
+// 恢复专用的DEL
+void KVStore::recover_del(uint64_t hash, const std::string& key)
+{
+    Shard& shard = shard_at(hash);
+    Entry* old = shard.table.erase(hash, key);
+    account(shard, nullptr, old);
+    if (old)
     {
-        throw std::invalid_argument("TTL must be positive");
+        Entry::destroy(old);
     }
+}
 
-    std::lock_guard<std::mutex> lock(mutex_);
+// 删除仍处于过期状态的键(调用方持有分片锁)
+bool KVStore::erase_if_expired(Shard& shard, const std::string& key, std::chrono::steady_clock::time_point now)
+{
+    uint64_t hash = hash_key(key);
+    const Entry* e = shard.table.find(hash, key);
+    // 读者入队之后键可能已被重新设置，需要再次确认
+    if (!e || !e->expired(now))
+    {
+        return false;
+    }
 
-    // 记录到WAL
-    if (log && wal)
+    // 记录操作到WAL
+    if (wal)
     {
-        wal->log_set(key, value);
-        // 记录TTL信息
-        wal->log_ttl(key, ttl.count());
+        wal->log_del(key);
     }
+    Entry* removed = shard.table.erase(hash, key);
+    account(shard, nullptr, removed);
+    EpochManager::instance().retire(removed, &Entry::release_ptr);
+    expired_keys_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
 
-    // 设置值和过期时间
-    auto expiry_time = std::chrono::steady_clock::now() + ttl; // 在将来某个时间点过期，这个时间点就是expiry_time，既是一个时间戳
-    data_[key] = {value, expiry_time};
+// 把过期键放入延迟删除队列，每个条目只入队一次
+void KVStore::defer_expired(const Entry* entry)
+{
+    if (entry->meta.fetch_or(Entry::META_EXPIRE_QUEUED, std::memory_order_relaxed) & Entry::META_EXPIRE_QUEUED)
+    {
+        return;
+    }
+
+    ExpiredNode* node = new ExpiredNode{entry->key(), expired_queue_.load(std::memory_order_relaxed)};
+    while (!expired_queue_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
 }
 
-// 清理过期键
-void KVStore::cleanup_expired_keys()
+// 处理延迟删除队列
+void KVStore::drain_expired_queue()
 {
-    while (ttl_cleanup_running_)
+    ExpiredNode* node = expired_queue_.exchange(nullptr, std::memory_order_acquire);
+    auto now = std::chrono::steady_clock::now();
+
+    while (node)
     {
-        // 每10秒检查一次过期键
-        std::this_thread::sleep_for(std::chrono::seconds(10));
+        Shard& shard = shard_at(hash_key(node->key));
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            erase_if_expired(shard, node->key, now);
+        }
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto now = std::chrono::steady_clock::now();
-        std::vector<std::string> expired_key;
+        ExpiredNode* next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+// 处理到期的TTL键
+size_t KVStore::expire_due_keys()
+{
+    size_t expired = 0;
+
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+        Shard& shard = *shards_[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto start = std::chrono::steady_clock::now();
+        shard.wheel.advance(start);
 
-        // 找出所有过期的键
-        for (const auto& pair : data_)
+        // 每批最多处理expire_batch个定时器，且持锁时间不超过expire_budget，剩余的留到下一个节拍
+        TimingWheel::Timer timer;
+        for (size_t n = 0; n < config_.expire_batch && shard.wheel.pop_ready(timer); ++n)
         {
-            if (pair.second.second < now)
+            // 定时器只是提示，键可能已被删除或重新设置；过期时间延后了的重新挂到新的过期时间
+            uint64_t hash = hash_key(timer.key);
+            const Entry* e = shard.table.find(hash, timer.key);
+            if (e && e->expiry == timer.deadline && erase_if_expired(shard, timer.key, start))
             {
-                expired_key.push_back(pair.first);
+                ++expired;
+            }
+            else if (e && e->expiry > timer.deadline && e->expiry != std::chrono::steady_clock::time_point::max())
+            {
+                shard.wheel.add(timer.key, e->expiry);
             }
-        }
 
-        // 删除过期的键
-        for (const auto& key : expired_key)
-        {
-            data_.erase(key);
-            // 记录操作到WAL
-            if (wal) 
+            if ((n & 15) == 15 && std::chrono::steady_clock::now() - start >= config_.expire_budget)
             {
-                wal->log_del(key);
+                break;
             }
         }
     }
+
+    return expired;
+}
+
+// 等待处理的TTL定时器数量
+size_t KVStore::pending_timers() const
+{
+    size_t total = 0;
+    for (const auto& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        total += shard->wheel.size();
+    }
+    return total;
 }
 
-// GET
-std::string KVStore::get(const std::string& key)
+// 清理线程
+void KVStore::cleanup_expired_keys()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto it = data_.find(key);
-    if (it != data_.end())
+    auto last_compact = std::chrono::steady_clock::now();
+    auto last_decay = last_compact;
+
+    while (ttl_cleanup_running_)
     {
-        // 检查键是否过期
-        auto now = std::chrono::steady_clock::now();
-        if (it->second.second < now)
+        std::this_thread::sleep_for(CLEANUP_TICK);
+        access_clock_.store(access_clock_now(), std::memory_order_relaxed);
+
+        // 时间轮到期的键
+        expire_due_keys();
+
+        // 删除读者发现的过期键，并回收已经没有读者引用的旧条目
+        drain_expired_queue();
+        EpochManager::instance().collect();
+
+        // 空闲分片的渐进式扩容由清理线程推进，避免迁移长期停在半途
+        for (size_t i = 0; i < shards_.size(); ++i)
         {
-            // 已过期，删除并返回空
-            data_.erase(it);
-            // 记录删除操作到WAL
-            if (wal) {
-                wal->log_del(key);
-            }
-            return "";
+            Shard& shard = *shards_[i];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.table.migrate_step(CLEANUP_MIGRATE_GROUPS);
+        }
+
+        // 定期整理slab内存
+        if (std::chrono::steady_clock::now() - last_compact >= COMPACT_INTERVAL)
+        {
+            compact_memory();
+            last_compact = std::chrono::steady_clock::now();
+        }
+
+        // 热点键计数定期减半，只反映最近的访问
+        if (std::chrono::steady_clock::now() - last_decay >= HOTKEY_DECAY_INTERVAL)
+        {
+            hot_keys_.decay();
+            last_decay = std::chrono::steady_clock::now();
         }
 
-        return it->second.first;
+        // WAL过大时自动生成快照
+        maybe_snapshot();
+    }
+}
+
+// 同步生成快照
+bool KVStore::save()
+{
+    bool expected = false;
+    if (!snapshot_running_.compare_exchange_strong(expected, true))
+    {
+        return false;
     }
 
-    return "";
+    try {
+        write_snapshot();
+    } catch (...) {
+        snapshot_running_ = false;
+        throw;
+    }
+    snapshot_running_ = false;
+    return true;
 }
 
-// DEL
-bool KVStore::del(const std::string& key, bool log)
+// 在后台线程生成快照
+bool KVStore::bgsave()
 {
-    if (key.empty())
+    bool expected = false;
+    if (!snapshot_running_.compare_exchange_strong(expected, true))
     {
         return false;
     }
 
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<std::mutex> lock(snapshot_thread_mutex_);
+    // 上一个后台线程已经结束，只需回收
+    if (snapshot_thread_.joinable())
+    {
+        snapshot_thread_.join();
+    }
+    snapshot_thread_ = std::thread([this]() {
+        try {
+            write_snapshot();
+        } catch (const std::exception& e) {
+            std::cerr << "Background save failed: " << e.what() << std::endl;
+        }
+        snapshot_running_ = false;
+    });
+    return true;
+}
+
+// 生成快照
+void KVStore::write_snapshot()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    try {
+        // 先结束当前WAL段：此后的修改都写入新段，快照只需覆盖切换之前的段。
+        // 快照不是某一时刻的精确镜像，可能包含切换之后的修改，但重放新段中的SET/DEL会把这些键恢复到最终状态
+        uint64_t covered = wal->rotate();
+        SnapshotWriter writer(config_.snapshot_path, covered);
+
+        std::vector<EntryRef> entries;
+        for (size_t i = 0; i < shards_.size(); ++i)
+        {
+            Shard& shard = *shards_[i];
+
+            // 持锁时只收集条目的引用，写文件在锁外进行；引用保证条目不会被释放，
+            // 写文件期间不停留在epoch临界区内，不会阻止全局epoch推进和其他线程的内存回收
+            entries.clear();
+            {
+                EpochManager::Guard guard(EpochManager::instance());
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                entries.reserve(shard.table.size());
+                shard.table.for_each([&](const Entry* e) {
+                    entries.emplace_back(e);
+                });
+            }
+
+            for (size_t j = 0; j < entries.size(); ++j)
+            {
+                writer.add(entries[j].get());
+            }
+        }
+
+        writer.commit();
+        wal->remove_segments(covered);
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        {
+            std::lock_guard<std::mutex> lock(snapshot_stats_mutex_);
+            ++snapshot_stats_.completed;
+            snapshot_stats_.last_keys = writer.count();
+            snapshot_stats_.last_bytes = writer.bytes();
+            snapshot_stats_.last_seconds = elapsed;
+            snapshot_stats_.last_save_unix = std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+        std::cout << "Snapshot saved: " << writer.count() << " keys, " << writer.bytes() << " bytes in "
+                  << elapsed << "s." << std::endl;
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(snapshot_stats_mutex_);
+        ++snapshot_stats_.failed;
+        snapshot_failed_at_ = std::chrono::steady_clock::now();
+        throw;
+    }
+}
+
+// WAL超过阈值时启动后台快照
+void KVStore::maybe_snapshot()
+{
+    if (config_.snapshot_wal_size == 0 || snapshot_running_ || wal->log_size() < config_.snapshot_wal_size)
+    {
+        return;
+    }
 
-    auto it = data_.find(key);
-    if (it != data_.end())
+    // 失败(例如磁盘已满)后不要每个节拍都重试
     {
-        if (log && wal)
+        std::lock_guard<std::mutex> lock(snapshot_stats_mutex_);
+        if (snapshot_stats_.failed > 0 &&
+            std::chrono::steady_clock::now() - snapshot_failed_at_ < SNAPSHOT_RETRY_INTERVAL)
         {
-            wal->log_del(key);
+            return;
         }
+    }
+
+    bgsave();
+}
 
-        data_.erase(it);
-        return true;
+// 快照统计
+SnapshotStats KVStore::snapshot_stats() const
+{
+    std::lock_guard<std::mutex> lock(snapshot_stats_mutex_);
+    SnapshotStats stats = snapshot_stats_;
+    stats.in_progress = snapshot_running_.load();
+    return stats;
+}
+
+// 开始延迟持久化
+void KVStore::defer_sync()
+{
+    tls_defer_sync = true;
+}
+
+// 等待延迟期间的写入持久化
+void KVStore::sync_deferred()
+{
+    tls_defer_sync = false;
+    uint64_t lsn = tls_deferred_lsn;
+    tls_deferred_lsn = 0;
+    if (lsn && wal)
+    {
+        wal->sync(lsn);
     }
+}
 
-    return false;
+// 等待日志持久化，延迟模式下只记录LSN
+void KVStore::wait_durable(uint64_t lsn)
+{
+    if (tls_defer_sync)
+    {
+        tls_deferred_lsn = std::max(tls_deferred_lsn, lsn);
+        return;
+    }
+    wal->sync(lsn);
 }
 
-// 获取存储大小
-size_t KVStore::size() const
+// GET
+std::string KVStore::get(std::string_view key)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return data_.size();
+    std::string value;
+    get(key, value);
+    return value;
 }
 
-// exist
-bool KVStore::exists(const std::string& key) const
+// GET，无锁读取
+bool KVStore::get(std::string_view key, std::string& value)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return data_.find(key) != data_.end();
+    // 在epoch临界区内查找并复制值，期间条目不会被释放
+    return read(key, [&value](const Entry& e) { value.assign(e.value_data(), e.value_size); });
 }
 
-// 获取所有键
-std::vector<std::string> KVStore::keys() const
+// 查找未过期的条目
+const Entry* KVStore::find_live(std::string_view key)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    std::vector<std::string> key_list;
-    key_list.reserve(data_.size());
+    return find_live(hash_key(key), key);
+}
+
+const Entry* KVStore::find_live(uint64_t hash, std::string_view key)
+{
+    hot_keys_.record(hash, key);
+    const Entry* e = shard_at(hash).table.find(hash, key);
+    if (!e)
+    {
+        return nullptr;
+    }
 
-    for (const auto& pair : data_)
+    // 检查键是否过期
+    if (e->expired(std::chrono::steady_clock::now()))
     {
-        key_list.push_back(pair.first);
+        // 已过期，交给清理线程删除
+        defer_expired(e);
+        return nullptr;
     }
 
-    return key_list;
-}
\ No newline at end of file
+    if (track_access_)
+    {
+        touch(e);
+    }
+    return e;
+}
+
+// DEL
+bool KVStore::del(std::string_view key, bool log)
+{
+    if (key.empty())
+    {
+        return false;
+    }
+
+    uint64_t hash = hash_key(key);
+    hot_keys_.record(hash, key);
+    Shard& shard = shard_at(hash);
+    Entry* removed = nullptr;
+    uint64_t lsn = 0;
+
+    {
+        TimedLock lock(shard.mutex);
+
+        if (!shard.table.find(hash, key))
+        {
+            return false;
+        }
+
+        if (log && wal)
+        {
+            lsn = wal->log_del(key);
+        }
+
+        removed = shard.table.erase(hash, key);
+        account(shard, nullptr, removed);
+    }
+
+    EpochManager::instance().retire(removed, &Entry::release_ptr);
+
+    if (lsn)
+    {
+        wait_durable(lsn);
+    }
+    return true;
+}
+
+// 按分片序号锁住分片
+void KVStore::lock_shards(const std::vector<uint64_t>& hashes, std::vector<std::unique_lock<std::mutex>>& locks)
+{
+    // 所有多分片操作都按序号从小到大加锁，单键操作只持有一个分片锁，因此不会死锁
+    std::vector<size_t> indexes;
+    indexes.reserve(hashes.size());
+    for (uint64_t hash : hashes)
+    {
+        indexes.push_back(shard_index(hash));
+    }
+    std::sort(indexes.begin(), indexes.end());
+    indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+
+    locks.reserve(indexes.size());
+    for (size_t index : indexes)
+    {
+        lock_timed(shards_[index]->mutex);
+        locks.emplace_back(shards_[index]->mutex, std::adopt_lock);
+    }
+}
+
+// 批量SET
+void KVStore::multi_set(const std::vector<std::pair<std::string_view, std::string_view>>& items)
+{
+    if (items.empty())
+    {
+        return;
+    }
+    for (const auto& item : items)
+    {
+        if (item.first.empty())
+        {
+            throw std::invalid_argument("Key cannot be empty");
+        }
+    }
+
+    // 在锁外计算哈希并构造所有条目
+    std::vector<uint64_t> hashes;
+    std::vector<Entry*> entries;
+    hashes.reserve(items.size());
+    entries.reserve(items.size());
+    for (const auto& item : items)
+    {
+        uint64_t hash = hash_key(item.first);
+        hot_keys_.record(hash, item.first);
+        hashes.push_back(hash);
+        entries.push_back(Entry::create(hash, item.first, item.second, std::chrono::steady_clock::time_point::max()));
+    }
+
+    // 整批一起腾出空间
+    size_t charge = 0;
+    for (Entry* entry : entries)
+    {
+        charge += entry->charge();
+    }
+    try {
+        make_room(charge);
+    } catch (...) {
+        for (Entry* entry : entries)
+        {
+            Entry::destroy(entry);
+        }
+        throw;
+    }
+
+    std::vector<Entry*> olds;
+    uint64_t lsn = 0;
+    {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        lock_shards(hashes, locks);
+
+        // 持有所有涉及的分片锁时写一条日志，与这些分片上其他写操作的日志顺序一致
+        if (wal)
+        {
+            lsn = wal->log_mset(items);
+        }
+
+        // 按批内顺序发布，同一个键出现多次时后面的生效
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            Shard& shard = shard_at(hashes[i]);
+            Entry* old = shard.table.insert(entries[i]);
+            init_access(entries[i], old);
+            account(shard, entries[i], old);
+            if (old)
+            {
+                olds.push_back(old);
+            }
+        }
+    }
+
+    for (Entry* old : olds)
+    {
+        EpochManager::instance().retire(old, &Entry::release_ptr);
+    }
+
+    if (lsn)
+    {
+        wait_durable(lsn);
+    }
+}
+
+// 批量DEL
+size_t KVStore::multi_del(const std::vector<std::string_view>& keys)
+{
+    std::vector<std::string_view> targets;
+    std::vector<uint64_t> hashes;
+    targets.reserve(keys.size());
+    hashes.reserve(keys.size());
+    for (std::string_view key : keys)
+    {
+        if (!key.empty())
+        {
+            targets.push_back(key);
+            hashes.push_back(hash_key(key));
+            hot_keys_.record(hashes.back(), key);
+        }
+    }
+    if (targets.empty())
+    {
+        return 0;
+    }
+
+    std::vector<Entry*> removed;
+    uint64_t lsn = 0;
+    {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        lock_shards(hashes, locks);
+
+        // 只记录存在的键
+        std::vector<std::string_view> existing;
+        for (size_t i = 0; i < targets.size(); ++i)
+        {
+            if (shard_at(hashes[i]).table.find(hashes[i], targets[i]))
+            {
+                existing.push_back(targets[i]);
+            }
+        }
+        if (existing.empty())
+        {
+            return 0;
+        }
+        if (wal)
+        {
+            lsn = wal->log_mdel(existing);
+        }
+
+        for (size_t i = 0; i < targets.size(); ++i)
+        {
+            Shard& shard = shard_at(hashes[i]);
+            Entry* e = shard.table.erase(hashes[i], targets[i]);
+            account(shard, nullptr, e);
+            if (e)
+            {
+                removed.push_back(e);
+            }
+        }
+    }
+
+    for (Entry* e : removed)
+    {
+        EpochManager::instance().retire(e, &Entry::release_ptr);
+    }
+
+    if (lsn)
+    {
+        wait_durable(lsn);
+    }
+    return removed.size();
+}
+
+// 获取存储大小
+size_t KVStore::size() const
+{
+    // 逐个分片累加
+    size_t total = 0;
+    for (const auto& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        total += shard->table.size();
+    }
+    return total;
+}
+
+// exist，无锁读取
+bool KVStore::exists(std::string_view key) const
+{
+    uint64_t hash = hash_key(key);
+    const Shard& shard = shard_at(hash);
+    EpochManager::Guard guard(EpochManager::instance());
+    return shard.table.find(hash, key) != nullptr;
+}
+
+// 遍历所有条目
+void KVStore::for_each_entry(const std::function<void(const Entry*)>& fn) const
+{
+    // 逐个分片遍历，每次只持有一个分片的锁
+    for (const auto& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->table.for_each(fn);
+    }
+}
+
+// 获取所有键
+std::vector<std::string> KVStore::keys() const
+{
+    std::vector<std::string> key_list;
+    uint64_t cursor = 0;
+    do {
+        cursor = scan(cursor, key_list, 1024);
+    } while (cursor != 0);
+
+    // 两次scan之间扩容时同一个键可能返回多次
+    std::sort(key_list.begin(), key_list.end());
+    key_list.erase(std::unique(key_list.begin(), key_list.end()), key_list.end());
+    return key_list;
+}
+
+// glob风格匹配(与Redis的MATCH相同)：*任意串，?任意字符，[...]字符集合(^取反，a-z范围)，\转义
+static bool glob_match(std::string_view pattern, std::string_view text)
+{
+    size_t p = 0;
+    size_t t = 0;
+    size_t star = std::string_view::npos;   // 最近一个*之后的位置，失配时从这里回溯
+    size_t star_text = 0;                   // 该*当前匹配到的文本位置
+
+    while (t < text.size())
+    {
+        if (p < pattern.size())
+        {
+            const char c = pattern[p];
+            if (c == '*')
+            {
+                star = ++p;
+                star_text = t;
+                continue;
+            }
+            if (c == '?')
+            {
+                ++p;
+                ++t;
+                continue;
+            }
+            if (c == '[')
+            {
+                size_t i = p + 1;
+                const bool negate = i < pattern.size() && pattern[i] == '^';
+                if (negate)
+                {
+                    ++i;
+                }
+                bool matched = false;
+                while (i < pattern.size() && pattern[i] != ']')
+                {
+                    if (pattern[i] == '\\' && i + 1 < pattern.size())
+                    {
+                        ++i;
+                        matched = matched || pattern[i] == text[t];
+                        ++i;
+                    }
+                    else if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']')
+                    {
+                        char lo = pattern[i];
+                        char hi = pattern[i + 2];
+                        if (lo > hi)
+                        {
+                            std::swap(lo, hi);
+                        }
+                        matched = matched || (text[t] >= lo && text[t] <= hi);
+                        i += 3;
+                    }
+                    else
+                    {
+                        matched = matched || pattern[i] == text[t];
+                        ++i;
+                    }
+                }
+                if (matched != negate)
+                {
+                    p = i < pattern.size() ? i + 1 : i;
+                    ++t;
+                    continue;
+                }
+            }
+            else
+            {
+                size_t i = p;
+                if (c == '\\' && i + 1 < pattern.size())
+                {
+                    ++i;
+                }
+                if (pattern[i] == text[t])
+                {
+                    p = i + 1;
+                    ++t;
+                    continue;
+                }
+            }
+        }
+        // 失配：让最近的*多匹配一个字符
+        if (star == std::string_view::npos)
+        {
+            return false;
+        }
+        p = star;
+        t = ++star_text;
+    }
+
+    while (p < pattern.size() && pattern[p] == '*')
+    {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+// 增量遍历：游标的低位是分片序号，其余位是分片内哈希表的游标；分片遍历完后从下一个分片的0开始
+uint64_t KVStore::scan(uint64_t cursor, std::vector<std::string>& keys, size_t count, std::string_view pattern) const
+{
+    const unsigned shard_bits = static_cast<unsigned>(__builtin_ctzll(shards_.size()));
+    size_t shard = static_cast<size_t>(cursor & shard_mask_);
+    uint64_t table_cursor = cursor >> shard_bits;
+
+    count = std::max<size_t>(count, 1);
+    const size_t max_visits = count * SCAN_VISIT_FACTOR;
+    size_t visits = 0;
+    size_t found = 0;
+    std::vector<const Entry*> batch;
+
+    // 持锁时只收集条目指针，匹配和复制键在锁外进行；epoch临界区保证这些条目不会被释放
+    EpochManager::Guard guard(EpochManager::instance());
+    while (found < count && visits < max_visits)
+    {
+        const Shard& s = *shards_[shard];
+        batch.clear();
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            do {
+                table_cursor = s.table.scan(table_cursor, [&batch](const Entry* e) { batch.push_back(e); });
+                ++visits;
+            } while (table_cursor != 0 && found + batch.size() < count && visits < max_visits);
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        for (const Entry* e : batch)
+        {
+            if (!e->expired(now) && (pattern.empty() || glob_match(pattern, e->key_view())))
+            {
+                keys.push_back(e->key());
+                ++found;
+            }
+        }
+
+        if (table_cursor == 0)
+        {
+            if (++shard == shards_.size())
+            {
+                return 0;
+            }
+        }
+    }
+    return (table_cursor << shard_bits) | shard;
+}
+
+// 范围查询：每个分片一个游标(已复制的一批键)，用小顶堆按游标的当前键归并，游标用完时再从该分片取下一批
+bool KVStore::range(std::string_view start, std::string_view end, size_t limit, std::vector<std::string>& keys) const
+{
+    if (!config_.ordered_index)
+    {
+        throw std::logic_error("Ordered index is disabled");
+    }
+
+    struct Cursor {
+        std::vector<std::string> batch;  // 从分片复制的一批键
+        size_t pos;                      // 下一个要归并的键
+        bool done;                       // 分片中已没有后续的键
+    };
+    const size_t batch_size = std::min(std::max<size_t>(limit, 1), RANGE_BATCH);
+    std::vector<Cursor> cursors(shards_.size());
+
+    // 从第i个分片复制不小于from的下一批键
+    auto fill = [&](size_t i, std::string_view from) {
+        Cursor& c = cursors[i];
+        c.batch.clear();
+        c.pos = 0;
+        std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+        c.done = shards_[i]->index->range(from, end, batch_size, c.batch) < batch_size;
+    };
+    auto later = [&cursors](size_t a, size_t b) {
+        return cursors[a].batch[cursors[a].pos] > cursors[b].batch[cursors[b].pos];
+    };
+
+    std::vector<size_t> heap;
+    for (size_t i = 0; i < shards_.size() && limit > 0; ++i)
+    {
+        fill(i, start);
+        if (!cursors[i].batch.empty())
+        {
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), later);
+
+    // 复制出来的键可能已被删除或已过期，按哈希表的当前状态过滤(无锁读取)
+    EpochManager::Guard guard(EpochManager::instance());
+    const auto now = std::chrono::steady_clock::now();
+    size_t found = 0;
+    std::string from;
+    while (!heap.empty() && found < limit)
+    {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        const size_t i = heap.back();
+        Cursor& c = cursors[i];
+        std::string& key = c.batch[c.pos++];
+        const bool refill = c.pos == c.batch.size() && !c.done;
+        if (refill)
+        {
+            // 下一批从紧跟在这个键之后的位置开始
+            from.assign(key).push_back('\0');
+        }
+
+        const Entry* e = shards_[i]->table.find(hash_key(key), key);
+        if (e && !e->expired(now))
+        {
+            keys.push_back(std::move(key));
+            ++found;
+        }
+
+        if (refill)
+        {
+            fill(i, from);
+        }
+        if (c.pos == c.batch.size())
+        {
+            heap.pop_back();
+        }
+        else
+        {
+            std::push_heap(heap.begin(), heap.end(), later);
+        }
+    }
+    return !heap.empty();
+}
+
+// 前缀遍历：以prefix开头的键都在[prefix, prefix的后继)中
+bool KVStore::prefix(std::string_view prefix, std::string_view after, size_t limit, std::vector<std::string>& keys) const
+{
+    // 后继：去掉末尾的0xFF后把最后一个字节加一，全为0xFF(或前缀为空)时没有上界
+    std::string end(prefix);
+    while (!end.empty() && static_cast<unsigned char>(end.back()) == 0xFF)
+    {
+        end.pop_back();
+    }
+    if (!end.empty())
+    {
+        end.back() = static_cast<char>(static_cast<unsigned char>(end.back()) + 1);
+    }
+
+    // 大于after的最小的键是after后接'\0'
+    std::string start(prefix);
+    if (!after.empty() && after >= prefix)
+    {
+        start.assign(after).push_back('\0');
+    }
+    return range(start, end, limit, keys);
+}
+
+// 有序索引的键数
+size_t KVStore::ordered_index_size() const
+{
+    size_t total = 0;
+    for (const auto& shard : shards_)
+    {
+        if (shard->index)
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total += shard->index->size();
+        }
+    }
+    return total;
+}
+
+// 有序索引占用的字节数
+size_t KVStore::ordered_index_memory() const
+{
+    size_t total = 0;
+    for (const auto& shard : shards_)
+    {
+        if (shard->index)
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total += shard->index->memory();
+        }
+    }
+    return total;
+}
+
+// 内存分配统计
+SlabStats KVStore::memory_stats() const
+{
+    return SlabAllocator::instance().stats();
+}
+
+// 整理内存
+size_t KVStore::compact_memory()
+{
+    SlabAllocator& alloc = SlabAllocator::instance();
+
+    // 上一轮搬迁的条目已经通过epoch释放，空出来的slab可以归还
+    EpochManager::instance().collect();
+    alloc.release_empty_slabs();
+    alloc.end_evacuation();
+
+    if (alloc.begin_evacuation() == 0)
+    {
+        return 0;
+    }
+
+    // 逐个分片把位于搬迁slab中的条目复制到新位置，旧条目交给epoch延迟释放
+    size_t moved = 0;
+    for (size_t i = 0; i < shards_.size() && ttl_cleanup_running_; ++i)
+    {
+        Shard& shard = *shards_[i];
+        std::vector<Entry*> retired;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            std::vector<const Entry*> victims;
+            shard.table.for_each([&](const Entry* e) {
+                if (alloc.is_evacuating(e, e->alloc_size()))
+                {
+                    victims.push_back(e);
+                }
+            });
+
+            for (size_t j = 0; j < victims.size(); ++j)
+            {
+                retired.push_back(shard.table.insert(Entry::clone(victims[j])));
+            }
+        }
+
+        for (size_t j = 0; j < retired.size(); ++j)
+        {
+            EpochManager::instance().retire(retired[j], &Entry::release_ptr);
+        }
+        moved += retired.size();
+    }
+
+    return moved;
+}
+
+// 更新分片的内存计数和有序索引
+void KVStore::account(Shard& shard, const Entry* added, const Entry* removed)
+{
+    size_t memory = shard.memory.load(std::memory_order_relaxed);
+
+    // 只有新增或删除键时才修改索引，覆盖已有的键不需要；索引节点同样计入内存上限
+    if (shard.index && (added == nullptr) != (removed == nullptr))
+    {
+        if (added)
+        {
+            memory += shard.index->insert(added->key_view());
+        }
+        else
+        {
+            memory -= shard.index->erase(removed->key_view());
+        }
+    }
+
+    if (added)
+    {
+        memory += added->charge();
+    }
+    if (removed)
+    {
+        memory -= removed->charge();
+    }
+    shard.memory.store(memory, std::memory_order_relaxed);
+}
+
+// 条目计入内存上限的总字节数
+size_t KVStore::used_memory() const
+{
+    size_t total = 0;
+    for (const auto& shard : shards_)
+    {
+        total += shard->memory.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+// 新条目的访问信息：条目刚发布，访问信息还是0，读者可能已经设置了最高位，因此用fetch_or
+void KVStore::init_access(Entry* entry, const Entry* old) const
+{
+    if (!track_access_)
+    {
+        return;
+    }
+
+    const uint32_t clock = access_clock_.load(std::memory_order_relaxed);
+    if (config_.eviction == EvictionPolicy::AllKeysLru)
+    {
+        entry->meta.fetch_or(clock, std::memory_order_relaxed);
+    }
+    else
+    {
+        // 覆盖写入算一次访问，保留旧键的频率
+        uint32_t counter = old ? lfu_decayed(old->meta.load(std::memory_order_relaxed), clock) : LFU_INIT_VAL;
+        entry->meta.fetch_or((lfu_minutes(clock) << 8) | counter, std::memory_order_relaxed);
+        if (old)
+        {
+            touch(entry);
+        }
+    }
+}
+
+// 读取时更新访问信息：只在值变化时写，并发更新丢失一次也没有关系
+void KVStore::touch(const Entry* entry) const
+{
+    const uint32_t clock = access_clock_.load(std::memory_order_relaxed);
+    uint32_t meta = entry->meta.load(std::memory_order_relaxed);
+    uint32_t access;
+
+    if (config_.eviction == EvictionPolicy::AllKeysLru)
+    {
+        access = clock;
+    }
+    else
+    {
+        // 先衰减，再以1/((counter - LFU_INIT_VAL) * LFU_LOG_FACTOR + 1)的概率加1
+        uint32_t counter = lfu_decayed(meta & Entry::META_ACCESS_MASK, clock);
+        if (counter < 255)
+        {
+            double base = counter > LFU_INIT_VAL ? counter - LFU_INIT_VAL : 0;
+            double r = static_cast<double>(next_random() >> 11) * (1.0 / 9007199254740992.0);
+            if (r < 1.0 / (base * LFU_LOG_FACTOR + 1))
+            {
+                ++counter;
+            }
+        }
+        access = (lfu_minutes(clock) << 8) | counter;
+    }
+
+    if ((meta & Entry::META_ACCESS_MASK) != access)
+    {
+        entry->meta.compare_exchange_weak(meta, (meta & ~Entry::META_ACCESS_MASK) | access, std::memory_order_relaxed);
+    }
+}
+
+// 淘汰优先级：已过期的键最优先，其余按策略计算
+uint64_t KVStore::eviction_score(const Entry* entry, std::chrono::steady_clock::time_point now) const
+{
+    if (entry->expired(now))
+    {
+        return UINT64_MAX;
+    }
+
+    const uint32_t clock = access_clock_.load(std::memory_order_relaxed);
+    const uint32_t access = entry->meta.load(std::memory_order_relaxed) & Entry::META_ACCESS_MASK;
+    switch (config_.eviction)
+    {
+    case EvictionPolicy::AllKeysLru:
+        // 空闲时间，加1使刚访问过的键也可以被淘汰
+        return ((clock - access) & Entry::META_ACCESS_MASK) + 1;
+    case EvictionPolicy::AllKeysLfu:
+        // 频率越低越先淘汰
+        return 256 - lfu_decayed(access, clock);
+    case EvictionPolicy::VolatileTtl:
+    {
+        // 只淘汰设置了TTL的键，剩余时间越短越先淘汰
+        if (entry->expiry == std::chrono::steady_clock::time_point::max())
+        {
+            return 0;
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(entry->expiry - now).count();
+        return UINT64_MAX - 1 - static_cast<uint64_t>(left);
+    }
+    case EvictionPolicy::NoEviction:
+        break;
+    }
+    return 0;
+}
+
+// 腾出空间
+void KVStore::make_room(size_t charge)
+{
+    if (config_.maxmemory == 0 || used_memory() + charge <= config_.maxmemory)
+    {
+        return;
+    }
+    if (config_.eviction == EvictionPolicy::NoEviction || charge > config_.maxmemory)
+    {
+        throw OutOfMemoryError();
+    }
+
+    // 轮流在各分片中淘汰，每次只持有一个分片锁；连续一圈都淘汰不了时放弃
+    size_t misses = 0;
+    while (used_memory() + charge > config_.maxmemory)
+    {
+        size_t index = evict_cursor_.fetch_add(1, std::memory_order_relaxed) & shard_mask_;
+        if (evict_one(*shards_[index]))
+        {
+            misses = 0;
+        }
+        else if (++misses >= shards_.size())
+        {
+            throw OutOfMemoryError();
+        }
+    }
+}
+
+// 在一个分片中抽样淘汰一个键
+bool KVStore::evict_one(Shard& shard)
+{
+    const Entry* samples[EVICTION_SAMPLES];
+    Entry* victim = nullptr;
+    {
+        TimedLock lock(shard.mutex);
+        size_t n = shard.table.sample(next_random(), samples, EVICTION_SAMPLES);
+
+        auto now = std::chrono::steady_clock::now();
+        const Entry* best = nullptr;
+        uint64_t best_score = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            uint64_t score = eviction_score(samples[i], now);
+            if (score > best_score)
+            {
+                best = samples[i];
+                best_score = score;
+            }
+        }
+        if (!best)
+        {
+            return false;
+        }
+
+        // 淘汰按DEL写入日志，恢复时得到同样的结果
+        std::string_view key = best->key_view();
+        if (wal)
+        {
+            wal->log_del(key);
+        }
+        victim = shard.table.erase(best->hash, key);
+        account(shard, nullptr, victim);
+    }
+
+    EpochManager::instance().retire(victim, &Entry::release_ptr);
+    evicted_keys_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
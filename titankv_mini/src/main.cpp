@@ -3,6 +3,7 @@
 #include <csignal>
 #include <thread>
 #include <chrono>
+#include <vector>
 
 #include "../include/kvstore.h"
 #include "../include/network_server.h"
@@ -22,22 +23,114 @@ void signal_handler(int signal)
 void show_help()
 {
     std::cout << "TitanKV Mini - Simple Key-Value Store\n";
-    std::cout << "Usage: ./titankv_mini [port] [wal_file]\n";
+    std::cout << "Usage: ./titankv_mini [port] [wal_file] [options]\n";
+    std::cout << "\nOptions:\n";
+    std::cout << "  --shards <n>           - Number of keyspace shards (power of two, default 16)\n";
+    std::cout << "  --backlog <n>          - Listen backlog for pending connections (default 4096)\n";
+    std::cout << "  --io-threads <n>       - Number of event loop threads sharing the port via SO_REUSEPORT (default 1)\n";
+    std::cout << "  --pin-threads <on|off> - Pin each event loop thread to its own CPU (default off)\n";
+    std::cout << "  --wal-sync <policy>    - WAL durability: always | everysec | os (default everysec)\n";
+    std::cout << "  --expire-budget-us <n> - Max time per shard lock spent expiring keys (default 1000)\n";
+    std::cout << "  --expire-batch <n>     - Max keys expired per shard lock (default 128)\n";
+    std::cout << "  --wal-segment-size <bytes> - Size of each preallocated WAL segment (default 64MB)\n";
+    std::cout << "  --wal-io <mode>        - WAL I/O backend: sync | io_uring (default sync, io_uring falls back to sync)\n";
+    std::cout << "  --wal-direct <on|off>  - Write WAL segments with O_DIRECT (default off)\n";
+    std::cout << "  --wal-inflight <n>     - Max WAL batches in flight with io_uring (default 4)\n";
+    std::cout << "  --snapshot <path>      - Snapshot file (default <wal_file>.snapshot)\n";
+    std::cout << "  --snapshot-wal-size <bytes> - Snapshot automatically when the WAL grows past this size, 0 = off (default 64MB)\n";
+    std::cout << "  --recovery-threads <n> - Threads used to replay the snapshot and WAL at startup (default: CPU count)\n";
+    std::cout << "  --maxmemory <bytes>    - Memory limit for stored entries, 0 = unlimited (default 0)\n";
+    std::cout << "  --maxmemory-policy <policy> - noeviction | allkeys-lru | allkeys-lfu | volatile-ttl (default noeviction)\n";
+    std::cout << "  --hotkey-sample-rate <n> - Sample one in n reads/writes for hot key tracking, 0 = off (default 64)\n";
+    std::cout << "  --ordered-index <on|off> - Keep keys in an ordered index for RANGE/PREFIX (default off)\n";
     std::cout << "\nCommands:\n";
     std::cout << "  SET <key> <value> - Store a key-value pair\n";
     std::cout << "  GET <key>         - Retrieve a key-value pair\n";
     std::cout << "  DEL <key>         - Delete a key-value pair\n";
+    std::cout << "  MGET <key>...     - Retrieve several keys, one line per key\n";
+    std::cout << "  MSET <key> <value>... - Store several pairs atomically (one WAL record)\n";
+    std::cout << "  MDEL <key>...     - Delete several keys, returns the number deleted\n";
+    std::cout << "  SAVE              - Write a snapshot and truncate the WAL\n";
+    std::cout << "  BGSAVE            - Write a snapshot in the background\n";
+    std::cout << "  HOTKEYS [count]   - Most accessed keys recently: key, estimated ops, shard\n";
+    std::cout << "  SCAN <cursor> [MATCH pattern] [COUNT n] - Iterate keys incrementally: next cursor (0 = done),\n";
+    std::cout << "                      number of keys, then one key per line\n";
+    std::cout << "  RANGE <start> <end> [LIMIT n] [AFTER key] - Keys between start and end (inclusive) in byte order,\n";
+    std::cout << "                      at most n (default 100); page with AFTER <last key>. Needs --ordered-index on\n";
+    std::cout << "  PREFIX <prefix> [LIMIT n] [AFTER key] - Keys starting with prefix in byte order, paged like RANGE\n";
+    std::cout << "  INFO [section]    - Server statistics as name:value lines ending with END\n";
+    std::cout << "                      (server, clients, memory, stats, commandstats, latencystats, keyspace)\n";
+    std::cout << "  STATS [RESET]     - Same as INFO, or reset the counters and latency histograms\n";
+    std::cout << "\nRESP2 (redis clients, redis-benchmark) is detected per connection and also supports:\n";
+    std::cout << "  SET <key> <value> [EX seconds|PX milliseconds], SETEX, DEL/EXISTS <key>..., PING, ECHO, CONFIG RESETSTAT\n";
     std::cout << "\nInteractive command:\n";
     std::cout << "  help              - Show this help\n";
     std::cout << "  stats             - Show store statistics\n";
+    std::cout << "  hotkeys           - Show the most accessed keys\n";
     std::cout << "  exit              - Stop the server\n";
 }
 
+// 显示最热的n个键
+void show_hot_keys(KVStore& store, size_t n)
+{
+    if (store.hotkey_sample_rate() == 0)
+    {
+        std::cout << "Hot keys: disabled\n";
+        return;
+    }
+
+    std::vector<HotKey> hot = store.hot_keys(n);
+    std::cout << "Hot keys (1/" << store.hotkey_sample_rate() << " sampled, estimated ops):\n";
+    if (hot.empty())
+    {
+        std::cout << "  (none)\n";
+    }
+    for (size_t i = 0; i < hot.size(); ++i)
+    {
+        std::cout << "  " << (i + 1) << ". " << hot[i].key << "  " << hot[i].count
+                  << " (shard " << store.shard_index(hash_key(hot[i].key)) << ")\n";
+    }
+}
+
 // 显示存储统计信息
 void show_stats(KVStore& store)
 {
     std::cout << "Store Statistics:\n";
-    std::cout << "  Total keys: " << store.size() << "\n"; 
+    std::cout << "  Total keys: " << store.size() << "\n";
+    std::cout << "  Shards: " << store.shard_count() << "\n";
+    std::cout << "  Expired keys: " << store.expired_count() << "\n";
+    std::cout << "  Pending TTL timers: " << store.pending_timers() << "\n";
+    std::cout << "  Used memory: " << store.used_memory() << " bytes";
+    if (store.max_memory() > 0)
+    {
+        std::cout << " (maxmemory " << store.max_memory() << ", " << eviction_policy_name(store.eviction_policy()) << ")";
+    }
+    std::cout << "\n";
+    std::cout << "  Evicted keys: " << store.evicted_count() << "\n";
+    if (store.ordered_index_enabled())
+    {
+        std::cout << "  Ordered index: " << store.ordered_index_size() << " keys (" << store.ordered_index_memory() << " bytes)\n";
+    }
+
+    show_hot_keys(store, 5);
+
+    SlabStats mem = store.memory_stats();
+    std::cout << "Memory:\n";
+    std::cout << "  Slabs: " << mem.slab_count << " (" << mem.slab_bytes << " bytes)\n";
+    std::cout << "  Chunk bytes in use: " << mem.chunk_bytes << "\n";
+    std::cout << "  Free chunk bytes: " << mem.free_chunk_bytes << "\n";
+    std::cout << "  Requested bytes: " << mem.requested_bytes << "\n";
+    std::cout << "  Large objects: " << mem.large_count << " (" << mem.large_bytes << " bytes)\n";
+    std::cout << "  Evacuating slabs: " << mem.evacuating_slabs << "\n";
+    std::cout << "  Slabs released: " << mem.slabs_released << "\n";
+    std::cout << "  Fragmentation ratio: " << mem.fragmentation_ratio << "\n";
+
+    SnapshotStats snap = store.snapshot_stats();
+    std::cout << "Snapshots:\n";
+    std::cout << "  In progress: " << (snap.in_progress ? "yes" : "no") << "\n";
+    std::cout << "  Completed: " << snap.completed << ", failed: " << snap.failed << "\n";
+    std::cout << "  Last save: " << snap.last_save_unix << " (" << snap.last_keys << " keys, "
+              << snap.last_bytes << " bytes, " << snap.last_seconds << "s)\n";
 }
 
 int main(int argc, char* argv[])
@@ -48,12 +141,142 @@ int main(int argc, char* argv[])
 
     // 解析命令行参数
     int port = 6380;
-    std::string wal_path = "wal.log";
+    StoreConfig config;
+    ServerConfig server_config;
 
-    if (argc > 1)
+    // 先解析 --xxx 形式的选项，剩余的按位置参数处理
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i)
     {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            positional.push_back(arg);
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Error: Option " << arg << " requires a value" << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+
         try {
-            port = std::stoi(argv[1]);
+            if (arg == "--shards")
+            {
+                config.shard_count = std::stoul(value);
+            }
+            else if (arg == "--backlog")
+            {
+                server_config.backlog = std::stoi(value);
+            }
+            else if (arg == "--io-threads")
+            {
+                server_config.threads = std::stoul(value);
+            }
+            else if (arg == "--pin-threads")
+            {
+                if (value != "on" && value != "off")
+                {
+                    std::cerr << "Error: --pin-threads must be on or off" << std::endl;
+                    return 1;
+                }
+                server_config.pin_threads = value == "on";
+            }
+            else if (arg == "--wal-sync")
+            {
+                if (!parse_sync_policy(value, config.wal_sync))
+                {
+                    std::cerr << "Error: --wal-sync must be always, everysec or os" << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--expire-budget-us")
+            {
+                config.expire_budget = std::chrono::microseconds(std::stoll(value));
+            }
+            else if (arg == "--expire-batch")
+            {
+                config.expire_batch = std::stoul(value);
+            }
+            else if (arg == "--snapshot")
+            {
+                config.snapshot_path = value;
+            }
+            else if (arg == "--snapshot-wal-size")
+            {
+                config.snapshot_wal_size = std::stoull(value);
+            }
+            else if (arg == "--wal-segment-size")
+            {
+                config.wal_segment_size = std::stoull(value);
+            }
+            else if (arg == "--wal-io")
+            {
+                if (!parse_io_mode(value, config.wal_io.mode))
+                {
+                    std::cerr << "Error: --wal-io must be sync or io_uring" << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--wal-direct")
+            {
+                if (value != "on" && value != "off")
+                {
+                    std::cerr << "Error: --wal-direct must be on or off" << std::endl;
+                    return 1;
+                }
+                config.wal_io.direct = value == "on";
+            }
+            else if (arg == "--wal-inflight")
+            {
+                config.wal_io.inflight = std::stoul(value);
+            }
+            else if (arg == "--recovery-threads")
+            {
+                config.recovery_threads = std::stoul(value);
+            }
+            else if (arg == "--maxmemory")
+            {
+                config.maxmemory = std::stoull(value);
+            }
+            else if (arg == "--hotkey-sample-rate")
+            {
+                config.hotkey_sample_rate = static_cast<uint32_t>(std::stoul(value));
+            }
+            else if (arg == "--ordered-index")
+            {
+                if (value != "on" && value != "off")
+                {
+                    std::cerr << "Error: --ordered-index must be on or off" << std::endl;
+                    return 1;
+                }
+                config.ordered_index = value == "on";
+            }
+            else if (arg == "--maxmemory-policy")
+            {
+                if (!parse_eviction_policy(value, config.eviction))
+                {
+                    std::cerr << "Error: --maxmemory-policy must be noeviction, allkeys-lru, allkeys-lfu or volatile-ttl" << std::endl;
+                    return 1;
+                }
+            }
+            else
+            {
+                std::cerr << "Error: Unknown option " << arg << std::endl;
+                return 1;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid value for " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (positional.size() > 0)
+    {
+        try {
+            port = std::stoi(positional[0]);
             if (port < 1 || port > 65535)
             {
                 std::cerr << "Error: Port must be between 1 and 65535" << std::endl;
@@ -65,20 +288,39 @@ int main(int argc, char* argv[])
         }
     }
 
-    if (argc > 2) {
-        wal_path = argv[2];
+    if (positional.size() > 1) {
+        config.wal_path = positional[1];
     }
 
     try {
         // 创建KV存储
-        KVStore store(wal_path);
+        KVStore store(config);
 
         // 创建网络服务器
-        NetworkServer server(store, port);
+        server_config.port = port;
+        NetworkServer server(store, server_config);
 
         std::cout << "Starting TitanKV mini server...\n";
         std::cout << "Port: " << port << "\n";
-        std::cout << "WAL file: " << wal_path << "\n";
+        std::cout << "Event loops: " << server.thread_count() << (server_config.pin_threads ? " (pinned)" : "") << "\n";
+        std::cout << "WAL segments: " << config.wal_path << ".<N>\n";
+        std::cout << "WAL sync: " << sync_policy_name(config.wal_sync) << "\n";
+        WalIoOptions io = store.wal_io_options();
+        std::cout << "WAL I/O: " << io_mode_name(io.mode);
+        if (io.mode == WalIoMode::Uring)
+        {
+            std::cout << " (" << io.inflight << " batches in flight)";
+        }
+        std::cout << (io.direct ? ", O_DIRECT" : "") << "\n";
+        std::cout << "Shards: " << store.shard_count() << "\n";
+        if (store.max_memory() > 0)
+        {
+            std::cout << "Max memory: " << store.max_memory() << " bytes (" << eviction_policy_name(store.eviction_policy()) << ")\n";
+        }
+        if (store.ordered_index_enabled())
+        {
+            std::cout << "Ordered index: on\n";
+        }
         show_help();
 
         // 启动服务器
@@ -115,6 +357,9 @@ int main(int argc, char* argv[])
             }else if (command == "stats")
             {
                 show_stats(store);
+            }else if (command == "hotkeys")
+            {
+                show_hot_keys(store, store.hotkey_capacity());
             }else 
             {
                 // 处理其他命令
@@ -0,0 +1,156 @@
+#include "../include/metrics.h"
+#include <algorithm>
+
+// 线程按创建顺序轮流分配stripe
+static std::atomic<size_t> next_stripe(0);
+
+size_t metric_stripe()
+{
+    static thread_local size_t stripe = next_stripe.fetch_add(1, std::memory_order_relaxed) % METRIC_STRIPES;
+    return stripe;
+}
+
+// 直方图
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+// 值所在的桶：小于SUB_COUNT的值每个值一个桶，之后每个2的幂分成SUB_COUNT个桶
+size_t LatencyHistogram::bucket_of(uint64_t ns)
+{
+    if (ns < SUB_COUNT)
+    {
+        return static_cast<size_t>(ns);
+    }
+    size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(ns));
+    if (exponent > MAX_EXPONENT)
+    {
+        return BUCKETS - 1;
+    }
+    size_t sub = static_cast<size_t>(ns >> (exponent - SUB_BITS)) & (SUB_COUNT - 1);
+    return (exponent - SUB_BITS + 1) * SUB_COUNT + sub;
+}
+
+// 桶内最大的值
+uint64_t LatencyHistogram::bucket_upper(size_t bucket)
+{
+    if (bucket < SUB_COUNT)
+    {
+        return bucket;
+    }
+    size_t shift = bucket / SUB_COUNT - 1;
+    uint64_t lower = static_cast<uint64_t>(SUB_COUNT + bucket % SUB_COUNT) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+// 合并并计算分位数
+LatencyHistogram::Summary LatencyHistogram::summary() const
+{
+    uint64_t buckets[BUCKETS] = {};
+    Summary s = {0, 0, 0, 0, 0, 0};
+    for (const Stripe& stripe : stripes_)
+    {
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            uint64_t n = stripe.buckets[i].load(std::memory_order_relaxed);
+            buckets[i] += n;
+            s.count += n;
+        }
+        s.sum += stripe.sum.load(std::memory_order_relaxed);
+        s.max = std::max(s.max, stripe.max.load(std::memory_order_relaxed));
+    }
+    if (s.count == 0)
+    {
+        return s;
+    }
+
+    // 第一个累计数达到count * q的桶
+    const double quantiles[3] = {0.5, 0.99, 0.999};
+    uint64_t* results[3] = {&s.p50, &s.p99, &s.p999};
+    uint64_t seen = 0;
+    size_t q = 0;
+    for (size_t i = 0; i < BUCKETS && q < 3; ++i)
+    {
+        seen += buckets[i];
+        while (q < 3 && seen >= static_cast<uint64_t>(quantiles[q] * static_cast<double>(s.count) + 0.5) && seen > 0)
+        {
+            // 桶上界可能超过实际的最大值
+            *results[q] = std::min(bucket_upper(i), s.max);
+            ++q;
+        }
+    }
+    return s;
+}
+
+// 清零
+void LatencyHistogram::reset()
+{
+    for (Stripe& stripe : stripes_)
+    {
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            stripe.buckets[i].store(0, std::memory_order_relaxed);
+        }
+        stripe.sum.store(0, std::memory_order_relaxed);
+        stripe.max.store(0, std::memory_order_relaxed);
+    }
+}
+
+// 计数器
+Counter::Counter()
+{
+    reset();
+}
+
+uint64_t Counter::value() const
+{
+    uint64_t total = 0;
+    for (const Stripe& stripe : stripes_)
+    {
+        total += stripe.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Counter::reset()
+{
+    for (Stripe& stripe : stripes_)
+    {
+        stripe.value.store(0, std::memory_order_relaxed);
+    }
+}
+
+// 进程内唯一的统计，第一次使用时创建
+Metrics& Metrics::instance()
+{
+    static Metrics* metrics = new Metrics();
+    return *metrics;
+}
+
+Metrics::Metrics() : connected_clients(0), start_(std::chrono::steady_clock::now())
+{
+}
+
+// 运行时间
+uint64_t Metrics::uptime_seconds() const
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now() - start_).count());
+}
+
+// 清零
+void Metrics::reset()
+{
+    for (LatencyHistogram& h : commands_)
+    {
+        h.reset();
+    }
+    wal_append.reset();
+    wal_sync.reset();
+    wal_flush.reset();
+    lock_wait.reset();
+    bytes_in.reset();
+    bytes_out.reset();
+    connections_received.reset();
+}
@@ -1,18 +1,48 @@
 #include "../include/network_server.h"
 #include "../include/protocol_parser.h"
 #include "../include/kvstore.h"
+#include "../include/metrics.h"
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sched.h>
+#include <pthread.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 #include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 #include <thread>
 #include <cerrno>
+#include <algorithm>
+
+// 每次read的大小
+static const size_t READ_CHUNK_SIZE = 16 * 1024;
+// 一个连接每轮最多read的次数，读不完的留到下一轮，避免一个连接占满整个事件循环
+static const size_t READ_BUDGET = 16;
+// 未发送的响应超过该大小时暂停读取该连接，等响应发出去再继续
+static const size_t OUTPUT_HIGH_WATER = 4 << 20;
+// 输入缓冲区空闲时保留的容量，超过时释放(接收过大参数之后)
+static const size_t INPUT_KEEP_CAPACITY = 1 << 20;
+// 每次sendmsg最多的iovec数
+static const size_t SEND_IOV_MAX = 64;
 
 // 构造函数
 NetworkServer::NetworkServer(KVStore& store, int port)
-    : store_(store), port_(port), running_(false), server_fd_(-1)
+    : store_(store), running_(false)
 {
+    config_.port = port;
+}
+
+NetworkServer::NetworkServer(KVStore& store, const ServerConfig& config)
+    : store_(store), config_(config), running_(false)
+{
+    if (config_.backlog <= 0 || config_.max_events == 0 || config_.threads == 0 || config_.max_request_size == 0)
+    {
+        throw std::invalid_argument("Server backlog, max events, threads and max request size must be positive");
+    }
 }
 
 // 析构函数
@@ -30,172 +60,581 @@ void NetworkServer::start()
 		return;
     }
 
+    // 绑定时按顺序使用进程允许运行的CPU
+    std::vector<int> cpus;
+    if (config_.pin_threads)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &set))
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+        if (cpus.empty())
+        {
+            std::cerr << "Warning: failed to get CPU affinity, event loops are not pinned" << std::endl;
+        }
+    }
+
+    // 先创建好所有监听socket，任何一个失败都不启动
+    try {
+        for (size_t i = 0; i < config_.threads; ++i)
+        {
+            loops_.emplace_back(new Loop());
+            Loop& loop = *loops_.back();
+            loop.index = i;
+            loop.cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+            open_loop(loop);
+        }
+    } catch (...) {
+        for (size_t i = 0; i < loops_.size(); ++i)
+        {
+            close_loop(*loops_[i]);
+        }
+        loops_.clear();
+        throw;
+    }
+
+    std::cout << "TitanKV mini running on port " << config_.port << " with " << loops_.size()
+              << " event loop" << (loops_.size() > 1 ? "s" : "") << std::endl;
+
     running_.store(true);
-    server_thread_ = std::thread(&NetworkServer::run, this);
+    for (size_t i = 0; i < loops_.size(); ++i)
+    {
+        loops_[i]->thread = std::thread(&NetworkServer::run, this, std::ref(*loops_[i]));
+    }
 }
 
-// 停止服务器
-void NetworkServer::stop()
+// 创建事件循环的监听socket、epoll和eventfd
+void NetworkServer::open_loop(Loop& loop)
 {
-    if (!running_.load())
+    // 创建非阻塞socket
+    loop.server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (loop.server_fd < 0)
     {
-        return;
+        throw std::runtime_error(std::string("Socket creation failed: ") + strerror(errno));
     }
 
-    running_.store(false);
+    // 设置socket选项，允许地址重用；每个事件循环用SO_REUSEPORT绑定同一端口，由内核分配新连接
+    int opt = 1;
+    if (setsockopt(loop.server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 ||
+        setsockopt(loop.server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
+    {
+        throw std::runtime_error(std::string("Setsockopt failed: ") + strerror(errno));
+    }
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(config_.port);
+
+    // 绑定socket并监听，等待队列足够长，重连风暴时不丢连接
+    if (bind(loop.server_fd, (sockaddr*)&address, sizeof(address)) < 0)
+    {
+        throw std::runtime_error(std::string("Bind failed: ") + strerror(errno));
+    }
+    if (listen(loop.server_fd, config_.backlog) < 0)
+    {
+        throw std::runtime_error(std::string("Listen failed: ") + strerror(errno));
+    }
 
-    // 关闭服务器socket以中断accept调用
-    if (server_fd_ >= 0)
+    loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop.wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop.epoll_fd < 0 || loop.wakeup_fd < 0)
     {
-        shutdown(server_fd_, SHUT_RDWR);
-        close(server_fd_);
-        server_fd_ = -1;
+        throw std::runtime_error(std::string("Failed to create epoll: ") + strerror(errno));
     }
 
-    if (server_thread_.joinable())
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = loop.server_fd;
+    bool ok = epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, loop.server_fd, &ev) == 0;
+    ev.data.fd = loop.wakeup_fd;
+    ok = ok && epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, loop.wakeup_fd, &ev) == 0;
+    if (!ok)
     {
-        server_thread_.join();
+        throw std::runtime_error(std::string("Failed to register listening socket: ") + strerror(errno));
     }
 }
 
-// 运行服务器主循环
-void NetworkServer::run()
+// 停止服务器
+void NetworkServer::stop()
 {
-    // 创建socket
-    server_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd_ < 0)
+    if (!running_.load())
     {
-        std::cerr << "Socket creation failed: " << strerror(errno) << std::endl;
         return;
     }
 
-    // 设置socket选项，允许地址重用
-    int opt = 1;
-    if (setsockopt(server_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+    running_.store(false);
+
+    // 唤醒所有事件循环，由它们各自关闭连接后退出
+    for (size_t i = 0; i < loops_.size(); ++i)
     {
-        std::cerr << "Setsockopt failed: " << strerror(errno) << std::endl;
-        close(server_fd_);
-        return;
+        uint64_t one = 1;
+        if (write(loops_[i]->wakeup_fd, &one, sizeof(one)) < 0)
+        {
+            std::cerr << "Failed to wake up event loop: " << strerror(errno) << std::endl;
+        }
     }
 
-    // 设置accept超时时间
-    struct timeval timeout;
-    timeout.tv_sec = 1; // 一秒超时
-    timeout.tv_usec = 0;
-    if (setsockopt(server_fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0)
+    for (size_t i = 0; i < loops_.size(); ++i)
     {
-        std::cerr << "Failed to set socket timeout: " << strerror(errno) << std::endl;
+        if (loops_[i]->thread.joinable())
+        {
+            loops_[i]->thread.join();
+        }
+        close_loop(*loops_[i]);
     }
+    loops_.clear();
+}
 
-    sockaddr_in address;
-    memset(&address, 0, sizeof(address));
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(port_);
-    
-    // 绑定socket
-    if (bind(server_fd_, (sockaddr*)&address, sizeof(address)) < 0)
-    {
-        std::cerr << "Bind failed: " << strerror(errno) << std::endl;
-        close(server_fd_);
-        server_fd_ = -1;
-        return;
+// 运行事件循环
+void NetworkServer::run(Loop& loop)
+{
+    if (loop.cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(loop.cpu, &set);
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0)
+        {
+            std::cerr << "Warning: failed to pin event loop " << loop.index << " to CPU " << loop.cpu << ": "
+                      << strerror(rc) << std::endl;
+        }
     }
 
-    // 监听连接
-    if (listen(server_fd_, 10) < 0)
+    std::vector<epoll_event> events(config_.max_events);
+
+    std::vector<int> resumed;
+
+    while (running_.load())
     {
-        std::cerr << "Listen failed: " << strerror(errno) << std::endl;
-        close(server_fd_);
-        server_fd_ = -1;
-        return;
+        // 有暂停读取的连接要继续时不阻塞
+        int timeout = loop.resumed.empty() ? -1 : 0;
+        int n = epoll_wait(loop.epoll_fd, events.data(), static_cast<int>(events.size()), timeout);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << "epoll_wait failed: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        // 这一轮请求中的写操作只追加日志，全部处理完后统一等待一次持久化再发送响应
+        store_.defer_sync();
+        resumed.swap(loop.resumed);
+        for (size_t i = 0; i < resumed.size(); ++i)
+        {
+            handle_event(loop, resumed[i], EPOLLIN);
+        }
+        resumed.clear();
+        for (int i = 0; i < n; ++i)
+        {
+            int fd = events[i].data.fd;
+            if (fd == loop.wakeup_fd)
+            {
+                uint64_t value;
+                while (read(loop.wakeup_fd, &value, sizeof(value)) > 0)
+                {
+                }
+            }
+            else if (fd == loop.server_fd)
+            {
+                accept_connections(loop);
+            }
+            else
+            {
+                handle_event(loop, fd, events[i].events);
+            }
+        }
+        flush_pending(loop);
     }
 
-    std::cout << "TitanKV mini running on port " << port_ << std::endl;
+    // 事件循环退出前关闭所有客户端连接
+    for (auto& item : loop.connections)
+    {
+        close(item.first);
+    }
+    Metrics::instance().connected_clients.fetch_sub(static_cast<int64_t>(loop.connections.size()),
+                                                     std::memory_order_relaxed);
+    loop.connections.clear();
+}
 
-    while (running_.load())
+// 接受连接
+void NetworkServer::accept_connections(Loop& loop)
+{
+    // 边缘触发：一直accept到没有等待中的连接
+    for (;;)
     {
         sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
-
-        // 接收客户端连接
-        int client_fd = accept(server_fd_, (sockaddr*)&client_addr, &client_len);
-
+        int client_fd = accept4(loop.server_fd, (sockaddr*)&client_addr, &client_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (client_fd < 0)
         {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) 
+            if (errno == EINTR || errno == ECONNABORTED)
             {
-                // 超时，继续循环
                 continue;
-            } 
-            else if (errno != EINTR) 
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
             {
                 std::cerr << "Accept failed: " << strerror(errno) << std::endl;
-                continue;
             }
-            continue;
+            return;
         }
 
-        // 创建新线程处理客户端
-        std::thread([this, client_fd] {
-            handle_client(client_fd);
+        epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = client_fd;
+        if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0)
+        {
+            std::cerr << "Failed to register client socket: " << strerror(errno) << std::endl;
             close(client_fd);
-        }).detach();
+            continue;
+        }
+
+        // 响应已经按轮合并发送，不需要Nagle算法再合并
+        int opt = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        loop.connections[client_fd].reset(new Connection(client_fd, config_.max_request_size));
+        Metrics::instance().connections_received.add(1);
+        Metrics::instance().connected_clients.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// 处理连接上的事件
+void NetworkServer::handle_event(Loop& loop, int fd, uint32_t events)
+{
+    auto it = loop.connections.find(fd);
+    if (it == loop.connections.end())
+    {
+        return;
+    }
+    Connection& conn = *it->second;
+
+    if (events & EPOLLERR)
+    {
+        close_connection(loop, fd);
+        return;
+    }
+
+    // 暂停读取的连接在可写(响应发出去了)或被恢复时继续读
+    bool readable = (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) || conn.read_paused;
+    if (readable && !conn.closing && !read_requests(conn))
+    {
+        close_connection(loop, fd);
+        return;
     }
 
-    close(server_fd_);
-    server_fd_ = -1;
+    // 响应在这一轮结束时发送
+    if (!conn.pending)
+    {
+        conn.pending = true;
+        loop.pending.push_back(fd);
+    }
 }
 
-// 处理客户端连接
-void NetworkServer::handle_client(int client_fd)
+// 等待这一轮的写入持久化，然后发送响应
+void NetworkServer::flush_pending(Loop& loop)
 {
-    char buffer[1024];
+    bool durable = true;
+    try {
+        store_.sync_deferred();
+    } catch (const std::exception& e) {
+        // 写入没有持久化，不能确认，断开这些连接
+        std::cerr << "Failed to persist writes: " << e.what() << std::endl;
+        durable = false;
+    }
 
-    while (running_.load())
+    for (size_t i = 0; i < loop.pending.size(); ++i)
+    {
+        auto it = loop.connections.find(loop.pending[i]);
+        if (it == loop.connections.end())
+        {
+            continue;
+        }
+        Connection& conn = *it->second;
+        conn.pending = false;
+
+        // 发不完的等可写事件
+        if (!durable || !flush_output(conn) || (conn.closing && conn.output.empty()))
+        {
+            close_connection(loop, conn.fd);
+            continue;
+        }
+
+        // 因为读取次数用完而暂停，或者积压的响应已经发完，下一轮继续读
+        if (conn.read_paused && conn.output.pending() < OUTPUT_HIGH_WATER)
+        {
+            loop.resumed.push_back(conn.fd);
+        }
+    }
+    loop.pending.clear();
+}
+
+// 读取并处理请求
+bool NetworkServer::read_requests(Connection& conn)
+{
+    char buffer[READ_CHUNK_SIZE];
+    conn.read_paused = false;
+
+    for (size_t reads = 0; ; ++reads)
     {
-        memset(buffer, 0, sizeof(buffer));
+        if (reads == READ_BUDGET || conn.output.pending() >= OUTPUT_HIGH_WATER)
+        {
+            conn.read_paused = true;
+            return true;
+        }
 
-        // 从客户端套接字读取数据
-        int bytes_read = read(client_fd, buffer, sizeof(buffer) - 1);
+        ssize_t bytes_read = read(conn.fd, buffer, sizeof(buffer));
 
         if (bytes_read == 0)
         {
-            // 客户端断开连接
-            break;
+            // 客户端关闭了写端：最后一条没有换行的文本命令也执行，已有的响应发送完后关闭
+            if (conn.protocol == Connection::INLINE && conn.input_pos < conn.input.size())
+            {
+                conn.input.push_back('\n');
+                process_input(conn);
+            }
+            conn.closing = true;
+            return true;
         }
 
         if (bytes_read < 0)
         {
-            if (errno == EINTR) {
-                continue;
-            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (errno == EINTR)
+            {
                 continue;
-            } else {
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return true;
+            }
+            if (errno != ECONNRESET)
+            {
                 std::cerr << "Read error: " << strerror(errno) << std::endl;
-                break;
             }
+            return false;
         }
 
-        // 解析并处理请求
-        std::string request(buffer, bytes_read);
+        conn.input.append(buffer, static_cast<size_t>(bytes_read));
+        Metrics::instance().bytes_in.add(static_cast<uint64_t>(bytes_read));
+        if (!process_input(conn))
+        {
+            conn.closing = true;
+            return true;
+        }
+    }
+}
+
+// 执行输入缓冲区中所有完整的命令
+bool NetworkServer::process_input(Connection& conn)
+{
+    if (conn.protocol == Connection::UNKNOWN)
+    {
+        if (conn.input.empty())
+        {
+            return true;
+        }
+        conn.protocol = conn.input[0] == '*' ? Connection::RESP : Connection::INLINE;
+    }
+    if (conn.protocol == Connection::RESP)
+    {
+        return process_resp(conn);
+    }
 
-        // 去除末尾的换行和回车符
-        while (!request.empty() && (request.back() == '\n' || request.back() == '\r'))
+    // 每条命令以换行结尾，按顺序执行，响应追加到输出缓冲区
+    // 不完整的命令只查找新到达的部分，长命令分多次到达时不会反复扫描
+    for (;;)
+    {
+        size_t end = conn.input.find('\n', std::max(conn.input_pos, conn.scan_pos));
+        if (end == std::string::npos)
         {
-            request.pop_back();
+            conn.scan_pos = conn.input.size();
+            break;
         }
 
-        if (!request.empty())
+        // 去除末尾的回车符
+        size_t len = end - conn.input_pos;
+        while (len > 0 && conn.input[conn.input_pos + len - 1] == '\r')
         {
-            std::string response = ProtocolParser::parse(store_, request);
+            --len;
+        }
+        if (len > 0)
+        {
+            ProtocolParser::parse(store_, std::string_view(conn.input).substr(conn.input_pos, len), conn.output);
+        }
+        conn.input_pos = end + 1;
+    }
 
-            // 将处理结果发送回客户端
-            ssize_t bytes_sent = send(client_fd, response.c_str(), response.size(), 0);
-            if (bytes_sent < 0) {
+    // 丢掉已经执行的部分，剩下不完整的命令
+    compact_input(conn);
+
+    // 不完整的命令过长时拒绝，避免输入缓冲区无限增长
+    if (conn.input.size() > config_.max_request_size)
+    {
+        conn.output.text() += "ERR request too large\n";
+        conn.input.clear();
+        conn.scan_pos = 0;
+        return false;
+    }
+    return true;
+}
+
+// 执行缓冲区中完整的RESP命令
+bool NetworkServer::process_resp(Connection& conn)
+{
+    // input_pos是下一条命令的起点，参数直接引用输入缓冲区，执行完之前缓冲区不能修改
+    for (;;)
+    {
+        const size_t start = conn.input_pos;
+        RespParser::Status status = conn.resp.parse(conn.input.data(), conn.input.size(), conn.input_pos);
+        if (status == RespParser::NEED_MORE)
+        {
+            break;
+        }
+        if (status == RespParser::ERROR)
+        {
+            RespWriter::error(conn.output.text(), "ERR Protocol error: " + conn.resp.error());
+            conn.input.clear();
+            conn.input_pos = 0;
+            return false;
+        }
+        // 一次读到的完整命令也要受长度限制
+        if (conn.input_pos - start > config_.max_request_size)
+        {
+            return reject_too_large(conn);
+        }
+        ProtocolParser::execute(store_, conn.resp.args(), conn.output);
+    }
+
+    // 丢掉已经执行的命令，保留不完整的命令(解析器记录了它已解析的部分)
+    compact_input(conn);
+
+    // 解析器只限制单个参数的长度，参数个数很多时一条命令仍可能很大；
+    // 不完整的命令(或正在接收的参数结束后)超过上限时拒绝，避免输入缓冲区无限增长
+    if (conn.input.size() - conn.input_pos > config_.max_request_size ||
+        conn.resp.expected_size() > config_.max_request_size)
+    {
+        return reject_too_large(conn);
+    }
+
+    // 正在接收的参数长度已知，一次预留好，之后的数据直接追加到这块内存，不再扩容复制
+    size_t expected = conn.resp.expected_size();
+    if (expected > conn.input.capacity())
+    {
+        conn.input.reserve(expected);
+    }
+    return true;
+}
+
+// 命令超过max_request_size：回复错误，丢弃输入，返回false关闭连接
+bool NetworkServer::reject_too_large(Connection& conn)
+{
+    RespWriter::error(conn.output.text(), "ERR request too large");
+    std::string().swap(conn.input);
+    conn.input_pos = 0;
+    conn.scan_pos = 0;
+    return false;
+}
+
+// 丢掉输入缓冲区中已经执行的部分
+void NetworkServer::compact_input(Connection& conn)
+{
+    // 查找位置随数据一起前移
+    conn.scan_pos = conn.scan_pos > conn.input_pos ? conn.scan_pos - conn.input_pos : 0;
+    if (conn.input_pos == conn.input.size())
+    {
+        // 接收过大参数的缓冲区用完就释放
+        if (conn.input.capacity() > INPUT_KEEP_CAPACITY)
+        {
+            std::string().swap(conn.input);
+        }
+        else
+        {
+            conn.input.clear();
+        }
+        conn.input_pos = 0;
+    }
+    else if (conn.input_pos > 0)
+    {
+        conn.input.erase(0, conn.input_pos);
+        conn.input_pos = 0;
+    }
+}
+
+// 发送缓冲的响应
+bool NetworkServer::flush_output(Connection& conn)
+{
+    struct iovec iov[SEND_IOV_MAX];
+    while (!conn.output.empty())
+    {
+        // 文本和大值按顺序组成iovec，一次发出
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = conn.output.fill_iovec(iov, SEND_IOV_MAX);
+        ssize_t bytes_sent = sendmsg(conn.fd, &msg, MSG_NOSIGNAL);
+        if (bytes_sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return true;
+            }
+            if (errno != EPIPE && errno != ECONNRESET)
+            {
                 std::cerr << "Send error: " << strerror(errno) << std::endl;
-                break;
             }
+            return false;
         }
+        conn.output.consume(static_cast<size_t>(bytes_sent));
+        Metrics::instance().bytes_out.add(static_cast<uint64_t>(bytes_sent));
     }
-}
\ No newline at end of file
+    return true;
+}
+
+// 关闭连接
+void NetworkServer::close_connection(Loop& loop, int fd)
+{
+    // close会自动从epoll中移除
+    close(fd);
+    if (loop.connections.erase(fd))
+    {
+        Metrics::instance().connected_clients.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+// 关闭事件循环的监听socket、epoll和eventfd
+void NetworkServer::close_loop(Loop& loop)
+{
+    if (loop.server_fd >= 0)
+    {
+        close(loop.server_fd);
+        loop.server_fd = -1;
+    }
+    if (loop.epoll_fd >= 0)
+    {
+        close(loop.epoll_fd);
+        loop.epoll_fd = -1;
+    }
+    if (loop.wakeup_fd >= 0)
+    {
+        close(loop.wakeup_fd);
+        loop.wakeup_fd = -1;
+    }
+}
@@ -0,0 +1,144 @@
+#include "../include/ordered_index.h"
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+// 构造函数：哨兵节点拥有全部层
+OrderedIndex::OrderedIndex() : head_(nullptr), height_(1), size_(0), memory_(0), random_(0x9e3779b97f4a7c15ULL)
+{
+    head_ = static_cast<Node*>(::operator new(node_size(MAX_HEIGHT, 0)));
+    head_->key_size = 0;
+    head_->height = MAX_HEIGHT;
+    for (int i = 0; i < MAX_HEIGHT; ++i)
+    {
+        head_->next[i] = nullptr;
+    }
+}
+
+OrderedIndex::~OrderedIndex()
+{
+    Node* node = head_->next[0];
+    while (node)
+    {
+        Node* next = node->next[0];
+        ::operator delete(node);
+        node = next;
+    }
+    ::operator delete(head_);
+}
+
+// 节点分配的字节数
+size_t OrderedIndex::node_size(uint32_t height, size_t key_size)
+{
+    return offsetof(Node, next) + sizeof(Node*) * height + key_size;
+}
+
+// 随机高度：每层以1/BRANCHING的概率继续向上
+uint32_t OrderedIndex::random_height()
+{
+    uint32_t height = 1;
+    while (height < MAX_HEIGHT)
+    {
+        random_ ^= random_ << 13;
+        random_ ^= random_ >> 7;
+        random_ ^= random_ << 17;
+        if (random_ % BRANCHING != 0)
+        {
+            break;
+        }
+        ++height;
+    }
+    return height;
+}
+
+// 从最高层向下查找第一个不小于key的节点
+OrderedIndex::Node* OrderedIndex::lower_bound(std::string_view key, Node** prev) const
+{
+    Node* node = head_;
+    for (int level = static_cast<int>(height_) - 1; level >= 0; --level)
+    {
+        Node* next = node->next[level];
+        while (next && next->key() < key)
+        {
+            node = next;
+            next = node->next[level];
+        }
+        if (prev)
+        {
+            prev[level] = node;
+        }
+    }
+    return node->next[0];
+}
+
+// 插入键
+size_t OrderedIndex::insert(std::string_view key)
+{
+    Node* prev[MAX_HEIGHT];
+    lower_bound(key, prev);
+
+    uint32_t height = random_height();
+    if (height > height_)
+    {
+        for (uint32_t level = height_; level < height; ++level)
+        {
+            prev[level] = head_;
+        }
+        height_ = height;
+    }
+
+    size_t bytes = node_size(height, key.size());
+    Node* node = static_cast<Node*>(::operator new(bytes));
+    node->key_size = static_cast<uint32_t>(key.size());
+    node->height = height;
+    std::memcpy(reinterpret_cast<char*>(node->next + height), key.data(), key.size());
+    for (uint32_t level = 0; level < height; ++level)
+    {
+        node->next[level] = prev[level]->next[level];
+        prev[level]->next[level] = node;
+    }
+    ++size_;
+    memory_ += bytes;
+    return bytes;
+}
+
+// 删除键
+size_t OrderedIndex::erase(std::string_view key)
+{
+    Node* prev[MAX_HEIGHT];
+    Node* node = lower_bound(key, prev);
+    if (!node || node->key() != key)
+    {
+        return 0;
+    }
+
+    for (uint32_t level = 0; level < node->height; ++level)
+    {
+        prev[level]->next[level] = node->next[level];
+    }
+    while (height_ > 1 && head_->next[height_ - 1] == nullptr)
+    {
+        --height_;
+    }
+    const size_t bytes = node_size(node->height, node->key_size);
+    --size_;
+    memory_ -= bytes;
+    ::operator delete(node);
+    return bytes;
+}
+
+// 范围查询
+size_t OrderedIndex::range(std::string_view start, std::string_view end, size_t n, std::vector<std::string>& out) const
+{
+    size_t added = 0;
+    for (Node* node = lower_bound(start, nullptr); node && added < n; node = node->next[0])
+    {
+        if (!end.empty() && node->key() >= end)
+        {
+            break;
+        }
+        out.emplace_back(node->key_data(), node->key_size);
+        ++added;
+    }
+    return added;
+}
@@ -0,0 +1,129 @@
+#include "../include/output_buffer.h"
+
+// 发送完后保留的文本缓冲区容量，超过时释放，避免偶尔的大响应长期占用内存
+static const size_t TEXT_KEEP_CAPACITY = 1 << 20;
+
+// 已发送的文本前缀超过这个大小(并且超过一半)时删除，客户端读得慢时缓冲区不会只增不减
+static const size_t TEXT_COMPACT_THRESHOLD = 64 * 1024;
+
+// 插入值
+void OutputBuffer::append_value(EntryRef&& ref)
+{
+    if (!ref || ref.get()->value_size == 0)
+    {
+        return;
+    }
+    value_bytes_ += ref.get()->value_size;
+    splices_.push_back(Splice{text_.size(), std::move(ref)});
+}
+
+// 填充iovec
+size_t OutputBuffer::fill_iovec(struct iovec* iov, size_t max) const
+{
+    size_t count = 0;
+    size_t cursor = text_pos_;
+    size_t skip = value_pos_;
+
+    for (size_t i = 0; i < splices_.size() && count < max; ++i)
+    {
+        const Splice& splice = splices_[i];
+        if (splice.offset > cursor)
+        {
+            iov[count].iov_base = const_cast<char*>(text_.data() + cursor);
+            iov[count].iov_len = splice.offset - cursor;
+            if (++count == max)
+            {
+                return count;
+            }
+            cursor = splice.offset;
+        }
+
+        const Entry* e = splice.value.get();
+        iov[count].iov_base = const_cast<char*>(e->value_data() + skip);
+        iov[count].iov_len = e->value_size - skip;
+        ++count;
+        skip = 0;
+    }
+
+    if (count < max && cursor < text_.size())
+    {
+        iov[count].iov_base = const_cast<char*>(text_.data() + cursor);
+        iov[count].iov_len = text_.size() - cursor;
+        ++count;
+    }
+    return count;
+}
+
+// 标记已发送
+void OutputBuffer::consume(size_t n)
+{
+    while (n > 0 && !splices_.empty())
+    {
+        // 值之前的文本
+        Splice& splice = splices_.front();
+        size_t text_part = splice.offset - text_pos_;
+        if (n < text_part)
+        {
+            text_pos_ += n;
+            return;
+        }
+        text_pos_ += text_part;
+        n -= text_part;
+
+        // 值本身
+        size_t value_size = splice.value.get()->value_size;
+        if (n < value_size - value_pos_)
+        {
+            value_pos_ += n;
+            return;
+        }
+        n -= value_size - value_pos_;
+        value_bytes_ -= value_size;
+        value_pos_ = 0;
+        splices_.pop_front();
+    }
+    text_pos_ += n;
+
+    // 全部发完后复用文本缓冲区
+    if (splices_.empty() && text_pos_ == text_.size())
+    {
+        if (text_.capacity() > TEXT_KEEP_CAPACITY)
+        {
+            std::string().swap(text_);
+        }
+        else
+        {
+            text_.clear();
+        }
+        text_pos_ = 0;
+    }
+    else if (text_pos_ >= TEXT_COMPACT_THRESHOLD && text_pos_ * 2 >= text_.size())
+    {
+        // 删除已发送的前缀，值的插入位置随之前移
+        text_.erase(0, text_pos_);
+        for (Splice& splice : splices_)
+        {
+            splice.offset -= text_pos_;
+        }
+        text_pos_ = 0;
+    }
+}
+
+// 复制成字符串
+std::string OutputBuffer::str() const
+{
+    std::string result;
+    result.reserve(pending());
+    size_t cursor = text_pos_;
+    size_t skip = value_pos_;
+    for (const Splice& splice : splices_)
+    {
+        result.append(text_, cursor, splice.offset - cursor);
+        cursor = splice.offset;
+        const Entry* e = splice.value.get();
+        result.append(e->value_data() + skip, e->value_size - skip);
+        skip = 0;
+    }
+    result.append(text_, cursor, std::string::npos);
+    return result;
+}
@@ -1,197 +1,1186 @@
 #include "../include/protocol_parser.h"
 #include "../include/kvstore.h"
-#include <sstream>
-#include <vector>
+#include "../include/resp.h"
+#include "../include/output_buffer.h"
+#include "../include/metrics.h"
 #include <algorithm>
-#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
 
-// 解析协议请求
-std::string ProtocolParser::parse(KVStore& store, const std::string& request)
+// 命令编号
+enum class CommandId {
+    GET, SET, SETEX, DEL, EXISTS, MGET, MSET, MDEL, PING, ECHO, SAVE, BGSAVE, COMMAND, CONFIG, HOTKEYS, INFO, STATS, SCAN,
+    RANGE, PREFIX
+};
+
+// 命令表项：名称(大写)、RESP参数个数范围(含命令名，max_args为-1表示不限)、文本协议是否支持
+struct CommandSpec {
+    std::string_view name;
+    CommandId id;
+    int min_args;
+    int max_args;
+    bool inline_protocol;
+};
+
+// 编译期命令表
+static constexpr CommandSpec COMMAND_TABLE[] = {
+    {"GET",     CommandId::GET,     2,  2, true},
+    {"SET",     CommandId::SET,     3, -1, true},
+    {"DEL",     CommandId::DEL,     2, -1, true},
+    {"SETEX",   CommandId::SETEX,   4,  4, false},
+    {"EXISTS",  CommandId::EXISTS,  2, -1, false},
+    {"MGET",    CommandId::MGET,    2, -1, true},
+    {"MSET",    CommandId::MSET,    3, -1, true},
+    {"MDEL",    CommandId::MDEL,    2, -1, true},
+    {"PING",    CommandId::PING,    1,  2, false},
+    {"ECHO",    CommandId::ECHO,    2,  2, false},
+    {"SAVE",    CommandId::SAVE,    1, -1, true},
+    {"BGSAVE",  CommandId::BGSAVE,  1, -1, true},
+    {"COMMAND", CommandId::COMMAND, 1, -1, false},
+    {"CONFIG",  CommandId::CONFIG,  1, -1, false},
+    {"HOTKEYS", CommandId::HOTKEYS, 1,  2, true},
+    {"INFO",    CommandId::INFO,    1,  2, true},
+    {"STATS",   CommandId::STATS,   1,  2, true},
+    {"SCAN",    CommandId::SCAN,    2,  6, true},
+    {"RANGE",   CommandId::RANGE,   3,  7, true},
+    {"PREFIX",  CommandId::PREFIX,  2,  6, true},
+};
+
+static_assert(sizeof(COMMAND_TABLE) / sizeof(COMMAND_TABLE[0]) <= Metrics::MAX_COMMANDS,
+              "every command needs a latency histogram");
+
+// ASCII转大写
+static constexpr char to_upper(char c)
 {
-    if (request.empty())
+    return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+// 不区分大小写地比较，upper必须是大写
+static constexpr bool equals_ignore_case(std::string_view text, std::string_view upper)
+{
+    if (text.size() != upper.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < text.size(); ++i)
     {
-        return "ERR empty request\n";
+        if (to_upper(text[i]) != upper[i])
+        {
+            return false;
+        }
     }
+    return true;
+}
 
-    // 使用字符串流来解析命令
-    std::istringstream iss(request);
-    std::string command;
-    iss >> command;
+// 查命令表，未知命令返回nullptr
+static constexpr const CommandSpec* find_command(std::string_view name)
+{
+    for (const CommandSpec& spec : COMMAND_TABLE)
+    {
+        if (equals_ignore_case(name, spec.name))
+        {
+            return &spec;
+        }
+    }
+    return nullptr;
+}
 
-    if (command.empty())
+static_assert(find_command("get")->id == CommandId::GET, "command lookup must be case-insensitive");
+static_assert(find_command("BgSave")->id == CommandId::BGSAVE, "command lookup must be case-insensitive");
+static_assert(find_command("GETX") == nullptr, "unknown commands must not match");
+
+// 记录一条命令的执行时间(析构时)
+class CommandTimer {
+public:
+    explicit CommandTimer(CommandId id)
+        : histogram_(Metrics::instance().command(static_cast<size_t>(id))), start_(std::chrono::steady_clock::now())
     {
-        return "ERR invalid command\n";
     }
 
-    // 转换为大写以便不区分大小写
-    std::transform(command.begin(), command.end(), command.begin(), ::toupper);
-    // 去除命令中的空白字符
-    command.erase(std::remove(command.begin(), command.end(), ' '), command.end());
+    ~CommandTimer() { histogram_.record_since(start_); }
+
+private:
+    LatencyHistogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// 不小于该大小的值不复制到响应中，而是引用条目，发送时直接从条目写出
+static const size_t ZERO_COPY_MIN_VALUE = 16 * 1024;
 
-    if (command == "SET")
+// 追加值：小值复制，大值插入条目引用
+static void append_value(OutputBuffer& response, const Entry& e)
+{
+    if (e.value_size < ZERO_COPY_MIN_VALUE)
+    {
+        response.text().append(e.value_data(), e.value_size);
+    }
+    else
     {
-        std::string key, value_part, ttl_str;
-        iss >> key;
+        response.append_value(EntryRef(&e));
+    }
+}
 
-        // 检查是否有TTL参数
-        bool has_ttl = false;
-        int64_t ttl_seconds = 0;
+// RESP批量字符串形式的值
+static void append_bulk(OutputBuffer& response, const Entry& e)
+{
+    if (e.value_size < ZERO_COPY_MIN_VALUE)
+    {
+        RespWriter::bulk(response.text(), e.value_data(), e.value_size);
+    }
+    else
+    {
+        RespWriter::bulk_header(response.text(), e.value_size);
+        response.append_value(EntryRef(&e));
+        response.text().append("\r\n", 2);
+    }
+}
 
-        // 获取剩余部分
-        std::string rest;
-        std::getline(iss, rest);
+// 空白字符(与istream的>>一致)
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
 
-        // 查找TTL关键字
-        size_t ttl_pos = rest.find("TTL");
-        if (ttl_pos != std::string::npos)
+// 取下一个空白分隔的词，rest推进到词之后
+static std::string_view next_token(std::string_view& rest)
+{
+    size_t begin = 0;
+    while (begin < rest.size() && is_space(rest[begin]))
+    {
+        ++begin;
+    }
+    size_t end = begin;
+    while (end < rest.size() && !is_space(rest[end]))
+    {
+        ++end;
+    }
+    std::string_view token = rest.substr(begin, end - begin);
+    rest.remove_prefix(end);
+    return token;
+}
+
+// 去除前导空格和制表符
+static std::string_view trim_left(std::string_view text)
+{
+    size_t pos = text.find_first_not_of(" \t");
+    return pos == std::string_view::npos ? std::string_view() : text.substr(pos);
+}
+
+// 去除尾随空格和制表符
+static std::string_view trim_right(std::string_view text)
+{
+    size_t pos = text.find_last_not_of(" \t");
+    return pos == std::string_view::npos ? std::string_view() : text.substr(0, pos + 1);
+}
+
+// 解析十进制整数参数，整个字符串都必须是数字
+static bool parse_int(std::string_view text, int64_t& value)
+{
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end && !text.empty();
+}
+
+// HOTKEYS的数量参数，省略时默认10个，不超过统计保留的键数
+static const size_t HOTKEYS_DEFAULT_COUNT = 10;
+
+static bool parse_hotkey_count(KVStore& store, std::string_view text, size_t& count)
+{
+    int64_t n = static_cast<int64_t>(HOTKEYS_DEFAULT_COUNT);
+    if (!text.empty() && (!parse_int(text, n) || n <= 0))
+    {
+        return false;
+    }
+    count = std::min(static_cast<size_t>(n), store.hotkey_capacity());
+    return true;
+}
+
+// SCAN的参数：cursor [MATCH pattern] [COUNT n]，args从游标开始；出错时返回错误信息(不含ERR前缀)
+static const size_t SCAN_DEFAULT_COUNT = 10;
+
+static const char* parse_scan_args(const std::vector<std::string_view>& args, uint64_t& cursor,
+                                   std::string_view& pattern, size_t& count)
+{
+    const char* end = args[0].data() + args[0].size();
+    auto result = std::from_chars(args[0].data(), end, cursor);
+    if (result.ec != std::errc() || result.ptr != end || args[0].empty())
+    {
+        return "invalid cursor";
+    }
+    pattern = std::string_view();
+    count = SCAN_DEFAULT_COUNT;
+    for (size_t i = 1; i < args.size(); i += 2)
+    {
+        if (i + 1 >= args.size())
+        {
+            return "syntax error";
+        }
+        if (equals_ignore_case(args[i], "MATCH"))
+        {
+            // "*"匹配所有键，等同于不过滤
+            pattern = args[i + 1] == "*" ? std::string_view() : args[i + 1];
+        }
+        else if (equals_ignore_case(args[i], "COUNT"))
         {
-            // 提取value部分
-            value_part = rest.substr(0, ttl_pos);
-            // 去除前导和尾随空格
-            value_part.erase(0, value_part.find_first_not_of(" \t"));
-            value_part.erase(value_part.find_last_not_of(" \t") + 1);
+            int64_t n = 0;
+            if (!parse_int(args[i + 1], n) || n <= 0)
+            {
+                return "value is out of range, must be positive";
+            }
+            count = static_cast<size_t>(n);
+        }
+        else
+        {
+            return "syntax error";
+        }
+    }
+    return nullptr;
+}
 
-            // 提取TTL值
-            std::istringstream ttl_iss(rest.substr(ttl_pos + 3)); // +3 跳过 "TTL"
-            ttl_iss >> ttl_str;
+// RANGE/PREFIX的可选参数：[LIMIT n] [AFTER key]，从args[first]开始；出错时返回错误信息(不含ERR前缀)
+static const size_t RANGE_DEFAULT_LIMIT = 100;
 
-            try {
-                ttl_seconds = std::stoll(ttl_str);
-                has_ttl = true;
-            } catch (const std::invalid_argument& e) {
-                return "ERR invalid TTL value\n";
-            } catch (const std::out_of_range& e) {
-                return "ERR TTL value out of range\n";
+static const char* parse_range_options(const std::vector<std::string_view>& args, size_t first, size_t& limit,
+                                       std::string_view& after)
+{
+    limit = RANGE_DEFAULT_LIMIT;
+    after = std::string_view();
+    for (size_t i = first; i < args.size(); i += 2)
+    {
+        if (i + 1 >= args.size())
+        {
+            return "syntax error";
+        }
+        if (equals_ignore_case(args[i], "LIMIT"))
+        {
+            int64_t n = 0;
+            if (!parse_int(args[i + 1], n) || n <= 0)
+            {
+                return "value is out of range, must be positive";
             }
+            limit = static_cast<size_t>(n);
+        }
+        else if (equals_ignore_case(args[i], "AFTER"))
+        {
+            after = args[i + 1];
+        }
+        else
+        {
+            return "syntax error";
+        }
+    }
+    return nullptr;
+}
+
+// 执行RANGE(args为start end [选项])或PREFIX(args为prefix [选项])，按字节序把键追加到keys；出错时返回错误信息
+static const char* ordered_keys(KVStore& store, bool prefix, const std::vector<std::string_view>& args,
+                                std::vector<std::string>& keys)
+{
+    if (!store.ordered_index_enabled())
+    {
+        return "ordered index is disabled (start the server with --ordered-index on)";
+    }
+    size_t limit = 0;
+    std::string_view after;
+    const char* error = parse_range_options(args, prefix ? 1 : 2, limit, after);
+    if (error)
+    {
+        return error;
+    }
+    if (prefix)
+    {
+        store.prefix(args[0], after, limit, keys);
+        return nullptr;
+    }
+
+    // RANGE两端都包含：[start, end]即[start, end后接'\0')；AFTER把起点移到该键之后
+    std::string start(args[0]);
+    if (!after.empty() && after >= start)
+    {
+        start.assign(after.data(), after.size()).push_back('\0');
+    }
+    std::string end(args[1]);
+    end.push_back('\0');
+    store.range(start, end, limit, keys);
+    return nullptr;
+}
 
-        }else
+// 大写的命令名，用于错误信息
+static std::string upper_name(std::string_view name)
+{
+    std::string upper(name);
+    for (char& c : upper)
+    {
+        c = to_upper(c);
+    }
+    return upper;
+}
+
+// 小写的命令名，用于统计项名称
+static std::string lower_name(std::string_view name)
+{
+    std::string lower(name);
+    for (char& c : lower)
+    {
+        if (c >= 'A' && c <= 'Z')
         {
-            // 没有TTL参数
-            value_part = rest;
-            // 去除前导空格
-            value_part.erase(0, value_part.find_first_not_of(" \t"));
+            c = static_cast<char>(c - 'A' + 'a');
         }
+    }
+    return lower;
+}
+
+// INFO输出的一行"name:value"
+static void info_line(std::string& out, const char* eol, std::string_view name, uint64_t value)
+{
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(name).push_back(':');
+    out.append(buf, static_cast<size_t>(result.ptr - buf)).append(eol);
+}
 
-        if (key.empty() || value_part.empty()) {
-            return "ERR SET requires key and value\n";
+// 纳秒转成带三位小数的微秒
+static void append_usec(std::string& out, uint64_t ns)
+{
+    char buf[32];
+    int n = std::snprintf(buf, sizeof(buf), "%.3f", static_cast<double>(ns) / 1000.0);
+    out.append(buf, static_cast<size_t>(n));
+}
+
+// 延迟分位数"p50=..,p99=..,p99.9=..,max=.."(微秒)
+static void append_percentiles(std::string& out, const LatencyHistogram::Summary& s)
+{
+    out.append("p50=");
+    append_usec(out, s.p50);
+    out.append(",p99=");
+    append_usec(out, s.p99);
+    out.append(",p99.9=");
+    append_usec(out, s.p999);
+    out.append(",max=");
+    append_usec(out, s.max);
+}
+
+// INFO的各节，section为空或"all"时输出全部；未知的节输出为空
+// 格式与Redis相同：每节以"# Name"开头，之后每行"name:value"，节之间空一行；
+// commandstats的每行是"cmdstat_<命令>:calls=..,usec=..,usec_per_call=..,p50=..,p99=..,p99.9=..,max=.."，
+// latencystats的每行是"latency_<名称>:count=..,usec=..,p50=..,p99=..,p99.9=..,max=.."，时间单位都是微秒
+static void append_info(KVStore& store, std::string_view section, const char* eol, std::string& out)
+{
+    const bool all = section.empty() || equals_ignore_case(section, "ALL");
+    const Metrics& metrics = Metrics::instance();
+    bool first = true;
+    auto begin = [&](std::string_view upper, const char* title) {
+        if (!all && !equals_ignore_case(section, upper))
+        {
+            return false;
+        }
+        if (!first)
+        {
+            out.append(eol);
         }
-        
-        if (has_ttl) {
-            if (ttl_seconds <= 0) {
-                return "ERR TTL must be positive\n";
+        first = false;
+        out.append("# ").append(title).append(eol);
+        return true;
+    };
+
+    if (begin("SERVER", "Server"))
+    {
+        info_line(out, eol, "uptime_in_seconds", metrics.uptime_seconds());
+        info_line(out, eol, "shards", store.shard_count());
+    }
+    if (begin("CLIENTS", "Clients"))
+    {
+        int64_t clients = metrics.connected_clients.load(std::memory_order_relaxed);
+        info_line(out, eol, "connected_clients", static_cast<uint64_t>(std::max<int64_t>(clients, 0)));
+    }
+    if (begin("MEMORY", "Memory"))
+    {
+        info_line(out, eol, "used_memory", store.used_memory());
+        info_line(out, eol, "maxmemory", store.max_memory());
+        out.append("maxmemory_policy:").append(eviction_policy_name(store.eviction_policy())).append(eol);
+        info_line(out, eol, "ordered_index_memory", store.ordered_index_memory());
+    }
+    if (begin("STATS", "Stats"))
+    {
+        uint64_t commands = 0;
+        for (const CommandSpec& spec : COMMAND_TABLE)
+        {
+            commands += metrics.command(static_cast<size_t>(spec.id)).summary().count;
+        }
+        info_line(out, eol, "total_connections_received", metrics.connections_received.value());
+        info_line(out, eol, "total_commands_processed", commands);
+        info_line(out, eol, "total_net_input_bytes", metrics.bytes_in.value());
+        info_line(out, eol, "total_net_output_bytes", metrics.bytes_out.value());
+        info_line(out, eol, "expired_keys", store.expired_count());
+        info_line(out, eol, "evicted_keys", store.evicted_count());
+    }
+    if (begin("COMMANDSTATS", "Commandstats"))
+    {
+        // 只输出执行过的命令
+        for (const CommandSpec& spec : COMMAND_TABLE)
+        {
+            LatencyHistogram::Summary s = metrics.command(static_cast<size_t>(spec.id)).summary();
+            if (s.count == 0)
+            {
+                continue;
             }
-            return parse_set_with_ttl(store, key, value_part, ttl_seconds);
-        } else {
-            return parse_set(store, key, value_part);
+            out.append("cmdstat_").append(lower_name(spec.name)).append(":calls=");
+            char buf[24];
+            auto result = std::to_chars(buf, buf + sizeof(buf), s.count);
+            out.append(buf, static_cast<size_t>(result.ptr - buf)).append(",usec=");
+            append_usec(out, s.sum);
+            out.append(",usec_per_call=");
+            append_usec(out, s.sum / s.count);
+            out.push_back(',');
+            append_percentiles(out, s);
+            out.append(eol);
         }
     }
-    else if (command == "GET")
+    if (begin("LATENCYSTATS", "Latencystats"))
     {
-        std::string key;
-        iss >> key;
-        if (key.empty())
+        const std::pair<const char*, const LatencyHistogram*> histograms[] = {
+            {"wal_append", &metrics.wal_append},
+            {"wal_sync", &metrics.wal_sync},
+            {"wal_flush", &metrics.wal_flush},
+            {"lock_wait", &metrics.lock_wait},
+        };
+        for (const auto& h : histograms)
+        {
+            LatencyHistogram::Summary s = h.second->summary();
+            out.append("latency_").append(h.first).append(":count=");
+            char buf[24];
+            auto result = std::to_chars(buf, buf + sizeof(buf), s.count);
+            out.append(buf, static_cast<size_t>(result.ptr - buf)).append(",usec=");
+            append_usec(out, s.sum);
+            out.push_back(',');
+            append_percentiles(out, s);
+            out.append(eol);
+        }
+    }
+    if (begin("KEYSPACE", "Keyspace"))
+    {
+        info_line(out, eol, "keys", store.size());
+        out.append("ordered_index:").append(store.ordered_index_enabled() ? "on" : "off").append(eol);
+        info_line(out, eol, "ordered_index_keys", store.ordered_index_size());
+    }
+}
+
+// 清零统计(STATS RESET)
+static void reset_stats(KVStore& store)
+{
+    Metrics::instance().reset();
+    store.reset_stats();
+}
+
+// 解析协议请求
+void ProtocolParser::parse(KVStore& store, std::string_view request, OutputBuffer& response)
+{
+    std::string& out = response.text();
+    if (request.empty())
+    {
+        out.append("ERR empty request\n");
+        return;
+    }
+
+    std::string_view rest = request;
+    std::string_view command = next_token(rest);
+    if (command.empty())
+    {
+        out.append("ERR invalid command\n");
+        return;
+    }
+
+    const CommandSpec* spec = find_command(command);
+    if (!spec || !spec->inline_protocol)
+    {
+        out.append("ERR unkown command '").append(upper_name(command)).append("'\n");
+        return;
+    }
+
+    CommandTimer timer(spec->id);
+    switch (spec->id)
+    {
+    case CommandId::SET:
+    {
+        // SET key value [TTL seconds]，值是key之后到TTL之前的部分
+        std::string_view key = next_token(rest);
+        std::string_view value;
+        int64_t ttl_seconds = 0;
+        bool has_ttl = false;
+
+        size_t ttl_pos = rest.find("TTL");
+        if (ttl_pos != std::string_view::npos)
+        {
+            value = trim_right(trim_left(rest.substr(0, ttl_pos)));
+
+            // 与stoll一致：允许正号，忽略数字之后的字符
+            std::string_view ttl_rest = rest.substr(ttl_pos + 3);
+            std::string_view ttl_str = next_token(ttl_rest);
+            if (ttl_str.size() > 1 && ttl_str[0] == '+' && ttl_str[1] != '-')
+            {
+                ttl_str.remove_prefix(1);
+            }
+            auto result = std::from_chars(ttl_str.data(), ttl_str.data() + ttl_str.size(), ttl_seconds);
+            if (result.ec == std::errc::invalid_argument)
+            {
+                out.append("ERR invalid TTL value\n");
+                return;
+            }
+            if (result.ec == std::errc::result_out_of_range)
+            {
+                out.append("ERR TTL value out of range\n");
+                return;
+            }
+            has_ttl = true;
+        }
+        else
+        {
+            value = trim_left(rest);
+        }
+
+        if (key.empty() || value.empty())
         {
-            return "ERR GET requires key\n";
+            out.append("ERR SET requires key and value\n");
+            return;
         }
 
-        return parse_get(store, key);
+        if (has_ttl)
+        {
+            if (ttl_seconds <= 0)
+            {
+                out.append("ERR TTL must be positive\n");
+                return;
+            }
+            parse_set_with_ttl(store, key, value, ttl_seconds, out);
+        }
+        else
+        {
+            parse_set(store, key, value, out);
+        }
+        return;
+    }
+    case CommandId::GET:
+    {
+        std::string_view key = next_token(rest);
+        if (key.empty())
+        {
+            out.append("ERR GET requires key\n");
+            return;
+        }
+        parse_get(store, key, response);
+        return;
     }
-    else if (command == "DEL")
+    case CommandId::DEL:
     {
-        std::string key;
-        iss >> key;
+        std::string_view key = next_token(rest);
         if (key.empty())
         {
-            return "ERR DEL requires key\n";
+            out.append("ERR DEL requires key\n");
+            return;
+        }
+        parse_del(store, key, out);
+        return;
+    }
+    case CommandId::MGET:
+    case CommandId::MSET:
+    case CommandId::MDEL:
+    {
+        // 批量命令的参数都是空白分隔的词(MSET的值不能含空白)
+        std::vector<std::string_view> args;
+        for (std::string_view token = next_token(rest); !token.empty(); token = next_token(rest))
+        {
+            args.push_back(token);
+        }
+        if (args.empty() || (spec->id == CommandId::MSET && args.size() % 2 != 0))
+        {
+            out.append("ERR ").append(spec->name).append(spec->id == CommandId::MSET ? " requires key value pairs\n" : " requires keys\n");
+            return;
+        }
+        if (spec->id == CommandId::MGET)
+        {
+            parse_mget(store, args, response);
+        }
+        else if (spec->id == CommandId::MSET)
+        {
+            parse_mset(store, args, out);
+        }
+        else
+        {
+            parse_mdel(store, args, out);
+        }
+        return;
+    }
+    case CommandId::HOTKEYS:
+        parse_hotkeys(store, next_token(rest), out);
+        return;
+    case CommandId::INFO:
+        parse_info(store, next_token(rest), out);
+        return;
+    case CommandId::SCAN:
+    {
+        std::vector<std::string_view> args;
+        for (std::string_view token = next_token(rest); !token.empty(); token = next_token(rest))
+        {
+            args.push_back(token);
+        }
+        if (args.empty())
+        {
+            out.append("ERR SCAN requires cursor\n");
+            return;
+        }
+        parse_scan(store, args, out);
+        return;
+    }
+    case CommandId::RANGE:
+    case CommandId::PREFIX:
+    {
+        std::vector<std::string_view> args;
+        for (std::string_view token = next_token(rest); !token.empty(); token = next_token(rest))
+        {
+            args.push_back(token);
         }
+        const bool prefix = spec->id == CommandId::PREFIX;
+        if (args.size() < (prefix ? 1u : 2u))
+        {
+            out.append(prefix ? "ERR PREFIX requires prefix\n" : "ERR RANGE requires start and end\n");
+            return;
+        }
+        parse_range(store, prefix, args, out);
+        return;
+    }
+    case CommandId::STATS:
+    {
+        std::string_view arg = next_token(rest);
+        if (equals_ignore_case(arg, "RESET"))
+        {
+            reset_stats(store);
+            out.append("OK\n");
+        }
+        else if (arg.empty())
+        {
+            parse_info(store, arg, out);
+        }
+        else
+        {
+            out.append("ERR STATS accepts only RESET\n");
+        }
+        return;
+    }
+    case CommandId::SAVE:
+        parse_save(store, out);
+        return;
+    case CommandId::BGSAVE:
+        parse_bgsave(store, out);
+        return;
+    default:
+        return;
+    }
+}
+
+// 解析协议请求，返回响应
+std::string ProtocolParser::parse(KVStore& store, const std::string& request)
+{
+    OutputBuffer response;
+    parse(store, std::string_view(request), response);
+    return response.str();
+}
 
-        return parse_del(store, key);
+// 执行一条RESP命令
+void ProtocolParser::execute(KVStore& store, const std::vector<std::string_view>& args, OutputBuffer& response)
+{
+    std::string& out = response.text();
+    const std::string_view command = args[0];
+    const size_t argc = args.size();
+
+    const CommandSpec* spec = find_command(command);
+    if (!spec)
+    {
+        RespWriter::error(out, "ERR unknown command '" + std::string(command) + "'");
+        return;
+    }
+    if (argc < static_cast<size_t>(spec->min_args) ||
+        (spec->max_args >= 0 && argc > static_cast<size_t>(spec->max_args)))
+    {
+        std::string name(spec->name);
+        for (char& c : name)
+        {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+        RespWriter::error(out, "ERR wrong number of arguments for '" + name + "' command");
+        return;
     }
 
-    return "ERR unkown command '" + command + "'\n";
+    CommandTimer timer(spec->id);
+    try {
+        switch (spec->id)
+        {
+        case CommandId::GET:
+            if (!store.read(args[1], [&response](const Entry& e) { append_bulk(response, e); }))
+            {
+                RespWriter::null_bulk(out);
+            }
+            break;
+        case CommandId::SET:
+        {
+            // SET key value [EX seconds|PX milliseconds]
+            if (argc == 3)
+            {
+                store.set(args[1], args[2]);
+                RespWriter::simple(out, "OK");
+                break;
+            }
+            const bool seconds = equals_ignore_case(args[3], "EX");
+            if (argc != 5 || (!seconds && !equals_ignore_case(args[3], "PX")))
+            {
+                RespWriter::error(out, "ERR syntax error");
+                break;
+            }
+            int64_t ttl = 0;
+            if (!parse_int(args[4], ttl) || ttl <= 0 || ttl > (seconds ? INT64_MAX / 1000000000 : INT64_MAX / 1000000))
+            {
+                RespWriter::error(out, "ERR invalid expire time in 'set' command");
+                break;
+            }
+            auto deadline = std::chrono::steady_clock::now() +
+                std::chrono::milliseconds(seconds ? ttl * 1000 : ttl);
+            store.set_with_deadline(args[1], args[2], deadline);
+            RespWriter::simple(out, "OK");
+            break;
+        }
+        case CommandId::SETEX:
+        {
+            // SETEX key seconds value
+            int64_t ttl = 0;
+            if (!parse_int(args[2], ttl) || ttl <= 0 || ttl > INT64_MAX / 1000000000)
+            {
+                RespWriter::error(out, "ERR invalid expire time in 'setex' command");
+                break;
+            }
+            store.set_with_ttl(args[1], args[3], std::chrono::seconds(ttl));
+            RespWriter::simple(out, "OK");
+            break;
+        }
+        case CommandId::DEL:
+        case CommandId::MDEL:
+            if (argc == 2)
+            {
+                RespWriter::integer(out, store.del(args[1]) ? 1 : 0);
+            }
+            else
+            {
+                // 多个键一次加锁、一条日志
+                std::vector<std::string_view> keys(args.begin() + 1, args.end());
+                RespWriter::integer(out, static_cast<int64_t>(store.multi_del(keys)));
+            }
+            break;
+        case CommandId::MGET:
+        {
+            std::vector<std::string_view> keys(args.begin() + 1, args.end());
+            RespWriter::array(out, keys.size());
+            store.multi_read(keys, [&response](size_t, const Entry* e) {
+                if (e)
+                {
+                    append_bulk(response, *e);
+                }
+                else
+                {
+                    RespWriter::null_bulk(response.text());
+                }
+            });
+            break;
+        }
+        case CommandId::MSET:
+        {
+            if (argc % 2 == 0)
+            {
+                RespWriter::error(out, "ERR wrong number of arguments for 'mset' command");
+                break;
+            }
+            std::vector<std::pair<std::string_view, std::string_view>> items;
+            items.reserve(argc / 2);
+            for (size_t i = 1; i + 1 < argc; i += 2)
+            {
+                items.emplace_back(args[i], args[i + 1]);
+            }
+            store.multi_set(items);
+            RespWriter::simple(out, "OK");
+            break;
+        }
+        case CommandId::EXISTS:
+        {
+            int64_t found = 0;
+            for (size_t i = 1; i < argc; ++i)
+            {
+                found += store.read(args[i], [](const Entry&) {}) ? 1 : 0;
+            }
+            RespWriter::integer(out, found);
+            break;
+        }
+        case CommandId::PING:
+            if (argc == 2)
+            {
+                RespWriter::bulk(out, args[1].data(), args[1].size());
+            }
+            else
+            {
+                RespWriter::simple(out, "PONG");
+            }
+            break;
+        case CommandId::ECHO:
+            RespWriter::bulk(out, args[1].data(), args[1].size());
+            break;
+        case CommandId::SAVE:
+            if (store.save())
+            {
+                RespWriter::simple(out, "OK");
+            }
+            else
+            {
+                RespWriter::error(out, "ERR snapshot already in progress");
+            }
+            break;
+        case CommandId::BGSAVE:
+            if (store.bgsave())
+            {
+                RespWriter::simple(out, "Background saving started");
+            }
+            else
+            {
+                RespWriter::error(out, "ERR snapshot already in progress");
+            }
+            break;
+        case CommandId::HOTKEYS:
+        {
+            // HOTKEYS [count]：每个热点键是[键, 估计的读写次数, 分片]
+            size_t count = 0;
+            if (!parse_hotkey_count(store, argc == 2 ? args[1] : std::string_view(), count))
+            {
+                RespWriter::error(out, "ERR count must be a positive integer");
+                break;
+            }
+            std::vector<HotKey> hot = store.hot_keys(count);
+            RespWriter::array(out, hot.size());
+            for (const HotKey& h : hot)
+            {
+                RespWriter::array(out, 3);
+                RespWriter::bulk(out, h.key.data(), h.key.size());
+                RespWriter::integer(out, static_cast<int64_t>(h.count));
+                RespWriter::integer(out, static_cast<int64_t>(store.shard_index(hash_key(h.key))));
+            }
+            break;
+        }
+        case CommandId::SCAN:
+        {
+            // SCAN cursor [MATCH pattern] [COUNT n]：返回[下一个游标, [键...]]
+            uint64_t cursor = 0;
+            std::string_view pattern;
+            size_t count = 0;
+            const char* error = parse_scan_args(std::vector<std::string_view>(args.begin() + 1, args.end()),
+                                                cursor, pattern, count);
+            if (error)
+            {
+                RespWriter::error(out, std::string("ERR ") + error);
+                break;
+            }
+            std::vector<std::string> keys;
+            cursor = store.scan(cursor, keys, count, pattern);
+            char buf[24];
+            auto result = std::to_chars(buf, buf + sizeof(buf), cursor);
+            RespWriter::array(out, 2);
+            RespWriter::bulk(out, buf, static_cast<size_t>(result.ptr - buf));
+            RespWriter::array(out, keys.size());
+            for (const std::string& key : keys)
+            {
+                RespWriter::bulk(out, key.data(), key.size());
+            }
+            break;
+        }
+        case CommandId::RANGE:
+        case CommandId::PREFIX:
+        {
+            // RANGE start end / PREFIX prefix，可选[LIMIT n] [AFTER key]：按字节序返回键的数组
+            std::vector<std::string> keys;
+            const char* error = ordered_keys(store, spec->id == CommandId::PREFIX,
+                                             std::vector<std::string_view>(args.begin() + 1, args.end()), keys);
+            if (error)
+            {
+                RespWriter::error(out, std::string("ERR ") + error);
+                break;
+            }
+            RespWriter::array(out, keys.size());
+            for (const std::string& key : keys)
+            {
+                RespWriter::bulk(out, key.data(), key.size());
+            }
+            break;
+        }
+        case CommandId::INFO:
+        case CommandId::STATS:
+        {
+            // INFO [section] / STATS：统计信息作为一个批量字符串返回；STATS RESET清零
+            if (spec->id == CommandId::STATS && argc == 2)
+            {
+                if (!equals_ignore_case(args[1], "RESET"))
+                {
+                    RespWriter::error(out, "ERR syntax error");
+                    break;
+                }
+                reset_stats(store);
+                RespWriter::simple(out, "OK");
+                break;
+            }
+            std::string info;
+            append_info(store, argc == 2 ? args[1] : std::string_view(), "\r\n", info);
+            RespWriter::bulk(out, info.data(), info.size());
+            break;
+        }
+        case CommandId::CONFIG:
+            // CONFIG RESETSTAT与STATS RESET相同
+            if (argc == 2 && equals_ignore_case(args[1], "RESETSTAT"))
+            {
+                reset_stats(store);
+                RespWriter::simple(out, "OK");
+                break;
+            }
+            // 其他CONFIG子命令是客户端连接时的探测(redis-benchmark会发送CONFIG GET)，返回空数组
+            RespWriter::array(out, 0);
+            break;
+        case CommandId::COMMAND:
+            // 客户端连接时的探测命令，返回空数组
+            RespWriter::array(out, 0);
+            break;
+        }
+    } catch (const OutOfMemoryError& e) {
+        // 与Redis相同的OOM错误前缀
+        RespWriter::error(out, e.what());
+    } catch (const std::exception& e) {
+        RespWriter::error(out, "ERR " + std::string(e.what()));
+    }
 }
 
 // 检查命令是否有效
 bool ProtocolParser::is_valid_command(const std::string& command)
 {
-    std::string cmd = command;
     // 提取命令部分（忽略参数）
-    size_t space_pos = cmd.find(' ');
-    if (space_pos != std::string::npos) {
-        cmd = cmd.substr(0, space_pos);
-    }
-    std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::toupper);
-    return cmd == "SET" || cmd == "GET" || cmd == "DEL";
+    std::string_view cmd(command);
+    cmd = cmd.substr(0, cmd.find(' '));
+    const CommandSpec* spec = find_command(cmd);
+    return spec && spec->inline_protocol;
 }
 
 // 获取命令类型
 std::string ProtocolParser::get_command_type(const std::string& request)
 {
-    std::istringstream iss(request);
-    std::string command;
-    iss >> command;
-    
-    if (!command.empty())
-    {
-        std::transform(command.begin(), command.end(), command.begin(), ::toupper);
-        return command;
-    }
-
-    return "";
+    std::string_view rest(request);
+    return upper_name(next_token(rest));
 }
 
 // 解析SET命令
-std::string ProtocolParser::parse_set(KVStore& store, const std::string& key, const std::string& value)
+void ProtocolParser::parse_set(KVStore& store, std::string_view key, std::string_view value, std::string& out)
 {
     try {
         store.set(key, value);
-        return "OK\n";
+        out.append("OK\n");
     } catch (const std::exception& e)
     {
-        return "ERR " + std::string(e.what()) + "\n";
+        parse_error(e.what(), out);
     }
 }
 
 // 接下带有TTL的SET命令
-std::string ProtocolParser::parse_set_with_ttl(KVStore& store, const std::string& key, const std::string& value, int64_t ttl_seconds)
+void ProtocolParser::parse_set_with_ttl(KVStore& store, std::string_view key, std::string_view value,
+                                        int64_t ttl_seconds, std::string& out)
 {
     try {
         store.set_with_ttl(key, value, std::chrono::seconds(ttl_seconds));
-        return "OK\n";
+        out.append("OK\n");
     } catch (const std::exception& e)
     {
-        return "ERR " + std::string(e.what()) + "\n"; 
+        parse_error(e.what(), out);
     }
 
 }
 
-// 解析GET命令
-std::string ProtocolParser::parse_get(KVStore& store, const std::string& key)
+// 解析GET命令：值直接从条目复制到输出缓冲区(大值引用条目)
+void ProtocolParser::parse_get(KVStore& store, std::string_view key, OutputBuffer& response)
 {
     try {
-        std::string value = store.get(key);
-        if (value == "NOTFOUND") {
-            return "NOT_FOUND\n";
+        if (store.read(key, [&response](const Entry& e) { append_value(response, e); }))
+        {
+            response.text().push_back('\n');
+        }
+        else
+        {
+            response.text().append("NOT_FOUND\n");
         }
-        return value + "\n";
     } catch (const std::exception& e) {
-        return "ERR " + std::string(e.what()) + "\n";
+        parse_error(e.what(), response.text());
     }
 }
 
 // 解析DEL命令
-std::string ProtocolParser::parse_del(KVStore& store, const std::string& key)
+void ProtocolParser::parse_del(KVStore& store, std::string_view key, std::string& out)
 {
     try {
         bool deleted = store.del(key);
-        return deleted ? "OK\n" : "NOT_FOUND\n";
+        out.append(deleted ? "OK\n" : "NOT_FOUND\n");
+    } catch (const std::exception& e) {
+        parse_error(e.what(), out);
+    }
+}
+
+// 解析MGET命令：每个键一行，值或NOT_FOUND
+void ProtocolParser::parse_mget(KVStore& store, const std::vector<std::string_view>& keys, OutputBuffer& response)
+{
+    try {
+        store.multi_read(keys, [&response](size_t, const Entry* e) {
+            if (e)
+            {
+                append_value(response, *e);
+                response.text().push_back('\n');
+            }
+            else
+            {
+                response.text().append("NOT_FOUND\n");
+            }
+        });
+    } catch (const std::exception& e) {
+        parse_error(e.what(), response.text());
+    }
+}
+
+// 解析MSET命令：参数是键值对
+void ProtocolParser::parse_mset(KVStore& store, const std::vector<std::string_view>& args, std::string& out)
+{
+    try {
+        std::vector<std::pair<std::string_view, std::string_view>> items;
+        items.reserve(args.size() / 2);
+        for (size_t i = 0; i + 1 < args.size(); i += 2)
+        {
+            items.emplace_back(args[i], args[i + 1]);
+        }
+        store.multi_set(items);
+        out.append("OK\n");
     } catch (const std::exception& e) {
-        return "ERR " + std::string(e.what()) + "\n";
+        parse_error(e.what(), out);
     }
 }
 
+// 解析MDEL命令：返回删除的键数
+void ProtocolParser::parse_mdel(KVStore& store, const std::vector<std::string_view>& keys, std::string& out)
+{
+    try {
+        char buf[24];
+        auto result = std::to_chars(buf, buf + sizeof(buf), store.multi_del(keys));
+        out.append(buf, static_cast<size_t>(result.ptr - buf)).push_back('\n');
+    } catch (const std::exception& e) {
+        parse_error(e.what(), out);
+    }
+}
+
+// 解析HOTKEYS命令：第一行是键数，之后每行"<键> <估计的读写次数> <分片>"
+void ProtocolParser::parse_hotkeys(KVStore& store, std::string_view count_arg, std::string& out)
+{
+    size_t count = 0;
+    if (!parse_hotkey_count(store, count_arg, count))
+    {
+        out.append("ERR HOTKEYS count must be a positive integer\n");
+        return;
+    }
+
+    char buf[24];
+    std::vector<HotKey> hot = store.hot_keys(count);
+    auto result = std::to_chars(buf, buf + sizeof(buf), hot.size());
+    out.append(buf, static_cast<size_t>(result.ptr - buf)).push_back('\n');
+    for (const HotKey& h : hot)
+    {
+        out.append(h.key).push_back(' ');
+        result = std::to_chars(buf, buf + sizeof(buf), h.count);
+        out.append(buf, static_cast<size_t>(result.ptr - buf)).push_back(' ');
+        result = std::to_chars(buf, buf + sizeof(buf), store.shard_index(hash_key(h.key)));
+        out.append(buf, static_cast<size_t>(result.ptr - buf)).push_back('\n');
+    }
+}
+
+// 解析SCAN命令：第一行是下一个游标(0表示结束)，第二行是键数，之后每行一个键
+void ProtocolParser::parse_scan(KVStore& store, const std::vector<std::string_view>& args, std::string& out)
+{
+    uint64_t cursor = 0;
+    std::string_view pattern;
+    size_t count = 0;
+    const char* error = parse_scan_args(args, cursor, pattern, count);
+    if (error)
+    {
+        out.append("ERR ").append(error).push_back('\n');
+        return;
+    }
+
+    try {
+        std::vector<std::string> keys;
+        cursor = store.scan(cursor, keys, count, pattern);
+        char buf[24];
+        auto result = std::to_chars(buf, buf + sizeof(buf), cursor);
+        out.append(buf, static_cast<size_t>(result.ptr - buf)).push_back('\n');
+        result = std::to_chars(buf, buf + sizeof(buf), keys.size());
+        out.append(buf, static_cast<size_t>(result.ptr - buf)).push_back('\n');
+        for (const std::string& key : keys)
+        {
+            out.append(key).push_back('\n');
+        }
+    } catch (const std::exception& e) {
+        parse_error(e.what(), out);
+    }
+}
+
+// 解析RANGE/PREFIX命令：第一行是键数，之后按字节序每行一个键
+void ProtocolParser::parse_range(KVStore& store, bool prefix, const std::vector<std::string_view>& args, std::string& out)
+{
+    try {
+        std::vector<std::string> keys;
+        const char* error = ordered_keys(store, prefix, args, keys);
+        if (error)
+        {
+            out.append("ERR ").append(error).push_back('\n');
+            return;
+        }
+        char buf[24];
+        auto result = std::to_chars(buf, buf + sizeof(buf), keys.size());
+        out.append(buf, static_cast<size_t>(result.ptr - buf)).push_back('\n');
+        for (const std::string& key : keys)
+        {
+            out.append(key).push_back('\n');
+        }
+    } catch (const std::exception& e) {
+        parse_error(e.what(), out);
+    }
+}
+
+// 解析INFO命令：INFO的各行，最后一行是END
+void ProtocolParser::parse_info(KVStore& store, std::string_view section, std::string& out)
+{
+    append_info(store, section, "\n", out);
+    out.append("END\n");
+}
+
+// 解析SAVE命令
+void ProtocolParser::parse_save(KVStore& store, std::string& out)
+{
+    try {
+        out.append(store.save() ? "OK\n" : "ERR snapshot already in progress\n");
+    } catch (const std::exception& e) {
+        parse_error(e.what(), out);
+    }
+}
+
+// 解析BGSAVE命令
+void ProtocolParser::parse_bgsave(KVStore& store, std::string& out)
+{
+    out.append(store.bgsave() ? "OK\n" : "ERR snapshot already in progress\n");
+}
+
 // 解析错误响应
-std::string ProtocolParser::parse_error(const std::string& message)
+void ProtocolParser::parse_error(std::string_view message, std::string& out)
 {
-    return "ERR " + message + "\n";
-}
\ No newline at end of file
+    out.append("ERR ").append(message).push_back('\n');
+}
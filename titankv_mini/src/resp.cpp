@@ -0,0 +1,215 @@
+#include "../include/resp.h"
+#include <cstring>
+#include <charconv>
+
+// 头部行(*<n>或$<n>)的最大长度
+static const size_t MAX_HEADER_SIZE = 32;
+// 一条命令的最大参数个数
+static const int64_t MAX_ARGS = 1024 * 1024;
+
+// 构造
+RespParser::RespParser(size_t max_bulk_size)
+    : max_bulk_size_(max_bulk_size), argc_(0), offset_(0), bulk_size_(-1)
+{
+}
+
+// 继续解析
+RespParser::Status RespParser::parse(const char* data, size_t size, size_t& pos)
+{
+    for (;;)
+    {
+        // 上次停下的位置
+        size_t cursor = pos + offset_;
+
+        // 新命令从数组头开始
+        if (argc_ == 0)
+        {
+            int64_t argc = 0;
+            Status status = parse_header(data, size, cursor, '*', argc);
+            if (status != COMMAND)
+            {
+                return status;
+            }
+            if (argc > MAX_ARGS)
+            {
+                error_ = "invalid multibulk length";
+                return ERROR;
+            }
+            // 空数组没有命令，直接跳过
+            if (argc <= 0)
+            {
+                pos = cursor;
+                continue;
+            }
+            argc_ = argc;
+            offset_ = cursor - pos;
+            spans_.clear();
+        }
+
+        while (static_cast<int64_t>(spans_.size()) < argc_)
+        {
+            if (bulk_size_ < 0)
+            {
+                int64_t bulk_size = 0;
+                Status status = parse_header(data, size, cursor, '$', bulk_size);
+                if (status != COMMAND)
+                {
+                    return status;
+                }
+                if (bulk_size < 0 || static_cast<uint64_t>(bulk_size) > max_bulk_size_)
+                {
+                    error_ = "invalid bulk length";
+                    return ERROR;
+                }
+                bulk_size_ = bulk_size;
+                offset_ = cursor - pos;
+            }
+
+            // 长度已知，数据不够时等待，下次直接从这里继续
+            const size_t need = static_cast<size_t>(bulk_size_) + 2;
+            if (size - cursor < need)
+            {
+                return NEED_MORE;
+            }
+            if (data[cursor + need - 2] != '\r' || data[cursor + need - 1] != '\n')
+            {
+                error_ = "expected CRLF after bulk string";
+                return ERROR;
+            }
+            spans_.push_back(Span{offset_, static_cast<size_t>(bulk_size_)});
+            cursor += need;
+            offset_ = cursor - pos;
+            bulk_size_ = -1;
+        }
+
+        // 命令完整，参数指向调用方的缓冲区
+        args_.clear();
+        for (const Span& span : spans_)
+        {
+            args_.emplace_back(data + pos + span.offset, span.size);
+        }
+        pos = cursor;
+        argc_ = 0;
+        offset_ = 0;
+        return COMMAND;
+    }
+}
+
+// 读取一行头部
+RespParser::Status RespParser::parse_header(const char* data, size_t size, size_t& pos, char prefix, int64_t& value)
+{
+    if (pos == size)
+    {
+        return NEED_MORE;
+    }
+    if (data[pos] != prefix)
+    {
+        error_ = std::string("expected '") + prefix + "', got '" + data[pos] + "'";
+        return ERROR;
+    }
+
+    const size_t avail = size - pos;
+    const char* begin = data + pos;
+    const char* nl = static_cast<const char*>(std::memchr(begin, '\n', avail < MAX_HEADER_SIZE ? avail : MAX_HEADER_SIZE));
+    if (!nl)
+    {
+        if (avail < MAX_HEADER_SIZE)
+        {
+            return NEED_MORE;
+        }
+        error_ = "header too long";
+        return ERROR;
+    }
+
+    // <前缀>[-]<数字>\r\n
+    const char* p = begin + 1;
+    const char* end = nl - 1;
+    if (end < p || *end != '\r')
+    {
+        error_ = "expected CRLF after header";
+        return ERROR;
+    }
+    bool negative = false;
+    if (p < end && *p == '-')
+    {
+        negative = true;
+        ++p;
+    }
+    if (p == end || end - p > 18)
+    {
+        error_ = "invalid length";
+        return ERROR;
+    }
+    int64_t n = 0;
+    for (; p < end; ++p)
+    {
+        if (*p < '0' || *p > '9')
+        {
+            error_ = "invalid length";
+            return ERROR;
+        }
+        n = n * 10 + (*p - '0');
+    }
+
+    value = negative ? -n : n;
+    pos += static_cast<size_t>(nl - begin) + 1;
+    return COMMAND;
+}
+
+// 追加十进制整数，不经过临时字符串
+static void append_number(std::string& out, int64_t value)
+{
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, static_cast<size_t>(result.ptr - buf));
+}
+
+// 响应序列化
+void RespWriter::simple(std::string& out, const char* text)
+{
+    out.push_back('+');
+    out.append(text);
+    out.append("\r\n", 2);
+}
+
+void RespWriter::error(std::string& out, const std::string& message)
+{
+    out.push_back('-');
+    out.append(message);
+    out.append("\r\n", 2);
+}
+
+void RespWriter::integer(std::string& out, int64_t value)
+{
+    out.push_back(':');
+    append_number(out, value);
+    out.append("\r\n", 2);
+}
+
+void RespWriter::bulk(std::string& out, const char* data, size_t size)
+{
+    out.push_back('$');
+    append_number(out, static_cast<int64_t>(size));
+    out.append("\r\n", 2);
+    out.append(data, size);
+    out.append("\r\n", 2);
+}
+
+void RespWriter::bulk_header(std::string& out, size_t size)
+{
+    out.push_back('$');
+    append_number(out, static_cast<int64_t>(size));
+    out.append("\r\n", 2);
+}
+
+void RespWriter::null_bulk(std::string& out)
+{
+    out.append("$-1\r\n", 5);
+}
+
+void RespWriter::array(std::string& out, size_t count)
+{
+    out.push_back('*');
+    append_number(out, static_cast<int64_t>(count));
+    out.append("\r\n", 2);
+}
@@ -0,0 +1,496 @@
+#include "../include/slab_allocator.h"
+#include <sys/mman.h>
+#include <algorithm>
+#include <new>
+#include <cstdlib>
+
+// 线程缓存最多占用的字节数(每个size class)
+static const size_t THREAD_CACHE_BYTES = 64 * 1024;
+// 线程缓存累计的请求字节变化超过该值时同步到全局计数
+static const int64_t REQUESTED_FLUSH_BYTES = 64 * 1024;
+
+// 线程本地缓存：每个size class一个小数组
+struct SlabAllocator::ThreadCache {
+    std::vector<std::vector<void*> > bins;
+    int64_t requested_delta;
+
+    ThreadCache() : requested_delta(0) {}
+
+    // 线程退出时把缓存的chunk全部还给中心链表
+    ~ThreadCache()
+    {
+        SlabAllocator& alloc = SlabAllocator::instance();
+        for (size_t cls = 0; cls < bins.size(); ++cls)
+        {
+            if (!bins[cls].empty())
+            {
+                alloc.flush(static_cast<int>(cls), bins[cls].data(), bins[cls].size());
+            }
+        }
+        alloc.add_requested(requested_delta);
+    }
+};
+
+static thread_local SlabAllocator::ThreadCache t_slab_cache;
+
+// 构造函数：size class按1.25倍递增，8字节对齐
+SlabAllocator::SlabAllocator() : requested_bytes_(0), large_count_(0), large_bytes_(0), slabs_released_(0)
+{
+    size_t size = MIN_CHUNK;
+    while (true)
+    {
+        SizeClass* sc = new SizeClass();
+        sc->chunk_size = size;
+        sc->cache_limit = std::max<size_t>(1, std::min<size_t>(64, THREAD_CACHE_BYTES / size));
+        sc->partial = nullptr;
+        sc->free_chunks = 0;
+        classes_.push_back(sc);
+
+        if (size >= MAX_CHUNK)
+        {
+            break;
+        }
+        size = std::min<size_t>(size_t(MAX_CHUNK), ((size * 5 / 4) + 7) & ~static_cast<size_t>(7));
+    }
+}
+
+SlabAllocator& SlabAllocator::instance()
+{
+    // 故意不释放，保证线程退出时依旧可以访问
+    static SlabAllocator* allocator = new SlabAllocator();
+    return *allocator;
+}
+
+// 根据大小找size class
+int SlabAllocator::class_of(size_t size) const
+{
+    if (size > MAX_CHUNK)
+    {
+        return -1;
+    }
+
+    size_t lo = 0;
+    size_t hi = classes_.size() - 1;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (classes_[mid]->chunk_size < size)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return static_cast<int>(lo);
+}
+
+// 实际占用的字节数
+size_t SlabAllocator::chunk_size(size_t size) const
+{
+    int cls = class_of(size);
+    return cls < 0 ? size : classes_[cls]->chunk_size;
+}
+
+// 分配
+void* SlabAllocator::allocate(size_t size)
+{
+    int cls = class_of(size);
+    if (cls < 0)
+    {
+        large_count_.fetch_add(1, std::memory_order_relaxed);
+        large_bytes_.fetch_add(size, std::memory_order_relaxed);
+        return ::operator new(size);
+    }
+
+    ThreadCache& tc = t_slab_cache;
+    if (tc.bins.size() != classes_.size())
+    {
+        tc.bins.resize(classes_.size());
+    }
+
+    std::vector<void*>& bin = tc.bins[cls];
+    void* ptr = nullptr;
+    while (!ptr)
+    {
+        if (bin.empty())
+        {
+            size_t n = std::max<size_t>(1, classes_[cls]->cache_limit / 2);
+            bin.resize(n);
+            bin.resize(refill(cls, bin.data(), n));
+        }
+
+        ptr = bin.back();
+        bin.pop_back();
+
+        // 缓存里的chunk所在slab可能已经被标记为搬迁，不能再使用
+        if (slab_of(ptr)->evacuating.load(std::memory_order_relaxed))
+        {
+            flush(cls, &ptr, 1);
+            ptr = nullptr;
+        }
+    }
+
+    tc.requested_delta += static_cast<int64_t>(size);
+    if (tc.requested_delta > REQUESTED_FLUSH_BYTES)
+    {
+        add_requested(tc.requested_delta);
+        tc.requested_delta = 0;
+    }
+    return ptr;
+}
+
+// 释放
+void SlabAllocator::deallocate(void* ptr, size_t size)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    int cls = class_of(size);
+    if (cls < 0)
+    {
+        large_count_.fetch_sub(1, std::memory_order_relaxed);
+        large_bytes_.fetch_sub(size, std::memory_order_relaxed);
+        ::operator delete(ptr);
+        return;
+    }
+
+    ThreadCache& tc = t_slab_cache;
+    tc.requested_delta -= static_cast<int64_t>(size);
+    if (tc.requested_delta < -REQUESTED_FLUSH_BYTES)
+    {
+        add_requested(tc.requested_delta);
+        tc.requested_delta = 0;
+    }
+
+    // 搬迁中的slab直接归还，让它尽快变空
+    if (slab_of(ptr)->evacuating.load(std::memory_order_relaxed))
+    {
+        flush(cls, &ptr, 1);
+        return;
+    }
+
+    if (tc.bins.size() != classes_.size())
+    {
+        tc.bins.resize(classes_.size());
+    }
+
+    std::vector<void*>& bin = tc.bins[cls];
+    bin.push_back(ptr);
+
+    // 缓存满了就归还一半
+    const size_t limit = classes_[cls]->cache_limit;
+    if (bin.size() > limit)
+    {
+        size_t n = bin.size() - limit / 2;
+        flush(cls, bin.data() + bin.size() - n, n);
+        bin.resize(bin.size() - n);
+    }
+}
+
+// 从中心链表批量取chunk
+size_t SlabAllocator::refill(int cls, void** out, size_t n)
+{
+    SizeClass& sc = *classes_[cls];
+    std::lock_guard<std::mutex> lock(sc.mutex);
+
+    size_t got = 0;
+    while (got < n)
+    {
+        if (!sc.partial && !new_slab(cls))
+        {
+            break;
+        }
+        out[got++] = take_chunk(sc, sc.partial);
+    }
+
+    if (n > 0 && got == 0)
+    {
+        throw std::bad_alloc();
+    }
+    return got;
+}
+
+// 批量归还chunk
+void SlabAllocator::flush(int cls, void* const* chunks, size_t n)
+{
+    SizeClass& sc = *classes_[cls];
+    std::lock_guard<std::mutex> lock(sc.mutex);
+    for (size_t i = 0; i < n; ++i)
+    {
+        put_chunk(sc, chunks[i]);
+    }
+}
+
+// 向系统申请一个按SLAB_SIZE对齐的slab
+SlabAllocator::Slab* SlabAllocator::new_slab(int cls)
+{
+    SizeClass& sc = *classes_[cls];
+
+    // 多申请一倍再裁掉两端，得到对齐的地址
+    void* raw = mmap(nullptr, SLAB_SIZE * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (start + SLAB_SIZE - 1) & ~(uintptr_t)(SLAB_SIZE - 1);
+    if (aligned > start)
+    {
+        munmap(raw, aligned - start);
+    }
+    if (aligned + SLAB_SIZE < start + SLAB_SIZE * 2)
+    {
+        munmap(reinterpret_cast<void*>(aligned + SLAB_SIZE), start + SLAB_SIZE * 2 - aligned - SLAB_SIZE);
+    }
+
+    Slab* slab = new (reinterpret_cast<void*>(aligned)) Slab();
+    const size_t header = (sizeof(Slab) + 63) & ~static_cast<size_t>(63);
+    slab->class_id = static_cast<uint32_t>(cls);
+    slab->capacity = static_cast<uint32_t>((SLAB_SIZE - header) / sc.chunk_size);
+    slab->used = 0;
+    slab->carved = 0;
+    slab->free_list = nullptr;
+    slab->chunks = reinterpret_cast<char*>(aligned + header);
+    slab->prev = nullptr;
+    slab->next = nullptr;
+    slab->in_partial = false;
+    slab->evacuating.store(false, std::memory_order_relaxed);
+
+    sc.slabs.push_back(slab);
+    sc.free_chunks += slab->capacity;
+    link_partial(sc, slab);
+    return slab;
+}
+
+// 从slab取一个chunk：优先复用已释放的，其次惰性切分新的
+void* SlabAllocator::take_chunk(SizeClass& sc, Slab* slab)
+{
+    void* chunk;
+    if (slab->free_list)
+    {
+        chunk = slab->free_list;
+        slab->free_list = *static_cast<void**>(chunk);
+    }
+    else
+    {
+        chunk = slab->chunks + static_cast<size_t>(slab->carved) * sc.chunk_size;
+        ++slab->carved;
+    }
+
+    ++slab->used;
+    --sc.free_chunks;
+    if (slab->used == slab->capacity)
+    {
+        unlink_partial(sc, slab);
+    }
+    return chunk;
+}
+
+// 把chunk放回所属slab
+void SlabAllocator::put_chunk(SizeClass& sc, void* chunk)
+{
+    Slab* slab = slab_of(chunk);
+    *static_cast<void**>(chunk) = slab->free_list;
+    slab->free_list = chunk;
+    --slab->used;
+    ++sc.free_chunks;
+
+    if (!slab->in_partial && !slab->evacuating.load(std::memory_order_relaxed))
+    {
+        link_partial(sc, slab);
+    }
+}
+
+void SlabAllocator::link_partial(SizeClass& sc, Slab* slab)
+{
+    slab->prev = nullptr;
+    slab->next = sc.partial;
+    if (sc.partial)
+    {
+        sc.partial->prev = slab;
+    }
+    sc.partial = slab;
+    slab->in_partial = true;
+}
+
+void SlabAllocator::unlink_partial(SizeClass& sc, Slab* slab)
+{
+    if (!slab->in_partial)
+    {
+        return;
+    }
+    if (slab->prev)
+    {
+        slab->prev->next = slab->next;
+    }
+    else
+    {
+        sc.partial = slab->next;
+    }
+    if (slab->next)
+    {
+        slab->next->prev = slab->prev;
+    }
+    slab->prev = nullptr;
+    slab->next = nullptr;
+    slab->in_partial = false;
+}
+
+// 归还空slab
+size_t SlabAllocator::release_empty_slabs()
+{
+    size_t released = 0;
+
+    for (size_t cls = 0; cls < classes_.size(); ++cls)
+    {
+        SizeClass& sc = *classes_[cls];
+        std::lock_guard<std::mutex> lock(sc.mutex);
+        bool spare_kept = false;
+
+        for (size_t i = 0; i < sc.slabs.size(); )
+        {
+            Slab* slab = sc.slabs[i];
+            bool evacuating = slab->evacuating.load(std::memory_order_relaxed);
+            if (slab->used != 0 || (!evacuating && !spare_kept))
+            {
+                // 保留一个普通空slab作为备用，避免反复申请释放
+                if (slab->used == 0)
+                {
+                    spare_kept = true;
+                }
+                ++i;
+                continue;
+            }
+
+            unlink_partial(sc, slab);
+            sc.free_chunks -= slab->capacity;
+            sc.slabs[i] = sc.slabs.back();
+            sc.slabs.pop_back();
+            munmap(slab, SLAB_SIZE);
+            ++released;
+        }
+    }
+
+    slabs_released_.fetch_add(released, std::memory_order_relaxed);
+    return released;
+}
+
+// 选出搬迁对象：按占用率从低到高，只要其余slab的空闲空间放得下它们的存活chunk
+size_t SlabAllocator::begin_evacuation()
+{
+    size_t marked = 0;
+
+    for (size_t cls = 0; cls < classes_.size(); ++cls)
+    {
+        SizeClass& sc = *classes_[cls];
+        std::lock_guard<std::mutex> lock(sc.mutex);
+        if (sc.slabs.size() < 2)
+        {
+            continue;
+        }
+
+        std::vector<Slab*> candidates;
+        for (size_t i = 0; i < sc.slabs.size(); ++i)
+        {
+            Slab* slab = sc.slabs[i];
+            // 只考虑占用不到一半的slab
+            if (slab->used > 0 && slab->used * 2 < slab->capacity &&
+                !slab->evacuating.load(std::memory_order_relaxed))
+            {
+                candidates.push_back(slab);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Slab* a, const Slab* b) {
+            return a->used < b->used;
+        });
+
+        size_t free_remaining = sc.free_chunks;
+        size_t live_moving = 0;
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            Slab* slab = candidates[i];
+            size_t slab_free = slab->capacity - slab->used;
+            if (live_moving + slab->used > free_remaining - slab_free)
+            {
+                break;
+            }
+            free_remaining -= slab_free;
+            live_moving += slab->used;
+
+            slab->evacuating.store(true, std::memory_order_relaxed);
+            unlink_partial(sc, slab);
+            ++marked;
+        }
+    }
+
+    return marked;
+}
+
+// 对象是否位于搬迁中的slab
+bool SlabAllocator::is_evacuating(const void* ptr, size_t size) const
+{
+    return class_of(size) >= 0 && slab_of(ptr)->evacuating.load(std::memory_order_relaxed);
+}
+
+// 结束本轮搬迁
+void SlabAllocator::end_evacuation()
+{
+    for (size_t cls = 0; cls < classes_.size(); ++cls)
+    {
+        SizeClass& sc = *classes_[cls];
+        std::lock_guard<std::mutex> lock(sc.mutex);
+
+        for (size_t i = 0; i < sc.slabs.size(); ++i)
+        {
+            Slab* slab = sc.slabs[i];
+            if (!slab->evacuating.load(std::memory_order_relaxed))
+            {
+                continue;
+            }
+            slab->evacuating.store(false, std::memory_order_relaxed);
+            if (slab->used < slab->capacity)
+            {
+                link_partial(sc, slab);
+            }
+        }
+    }
+}
+
+// 统计信息
+SlabStats SlabAllocator::stats() const
+{
+    SlabStats s = SlabStats();
+
+    for (size_t cls = 0; cls < classes_.size(); ++cls)
+    {
+        const SizeClass& sc = *classes_[cls];
+        std::lock_guard<std::mutex> lock(sc.mutex);
+
+        s.slab_count += sc.slabs.size();
+        s.free_chunk_bytes += sc.free_chunks * sc.chunk_size;
+        for (size_t i = 0; i < sc.slabs.size(); ++i)
+        {
+            s.chunk_bytes += static_cast<size_t>(sc.slabs[i]->used) * sc.chunk_size;
+            if (sc.slabs[i]->evacuating.load(std::memory_order_relaxed))
+            {
+                ++s.evacuating_slabs;
+            }
+        }
+    }
+
+    s.slab_bytes = s.slab_count * SLAB_SIZE;
+    s.large_count = large_count_.load(std::memory_order_relaxed);
+    s.large_bytes = large_bytes_.load(std::memory_order_relaxed);
+    int64_t requested = requested_bytes_.load(std::memory_order_relaxed);
+    s.requested_bytes = (requested > 0 ? static_cast<size_t>(requested) : 0) + s.large_bytes;
+    s.slabs_released = slabs_released_.load(std::memory_order_relaxed);
+    s.fragmentation_ratio = s.requested_bytes > 0
+        ? static_cast<double>(s.slab_bytes + s.large_bytes) / s.requested_bytes
+        : 0.0;
+    return s;
+}
@@ -0,0 +1,175 @@
+#include "../include/snapshot.h"
+#include "../include/kvstore.h"
+#include "../include/wal.h"
+#include "../include/wal_record.h"
+#include "../include/wal_recovery.h"
+#include "../include/coding.h"
+#include <stdexcept>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char SNAPSHOT_MAGIC[6] = {'T', 'K', 'V', 'S', 'N', 'P'};
+// 写入缓冲区达到该大小时写出
+static const size_t SNAPSHOT_WRITE_SIZE = 1 << 20;
+
+// 写入器
+SnapshotWriter::SnapshotWriter(const std::string& path, uint64_t covered)
+    : path_(path), tmp_path_(path + ".tmp"), fd_(-1), count_(0), bytes_(0), committed_(false),
+      steady_base_(std::chrono::steady_clock::now()),
+      unix_base_ms_(std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch()).count())
+{
+    fd_ = open(tmp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+    {
+        throw std::runtime_error("Failed to create snapshot file: " + tmp_path_ + ": " + strerror(errno));
+    }
+
+    buffer_.reserve(SNAPSHOT_WRITE_SIZE + 4096);
+    buffer_.append(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    buffer_.push_back(static_cast<char>(SNAPSHOT_FORMAT_VERSION & 0xFF));
+    buffer_.push_back(static_cast<char>(SNAPSHOT_FORMAT_VERSION >> 8));
+    put_fixed64(buffer_, covered);
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+    }
+    if (!committed_)
+    {
+        unlink(tmp_path_.c_str());
+    }
+}
+
+// 追加一个条目
+void SnapshotWriter::add(const Entry* entry)
+{
+    int64_t expire_at_ms = 0;
+    if (entry->expiry != std::chrono::steady_clock::time_point::max())
+    {
+        if (entry->expiry <= steady_base_)
+        {
+            return;
+        }
+        // 每个条目都取一次时钟太慢，用构造时的基准换算为unix毫秒
+        expire_at_ms = unix_base_ms_ + std::chrono::duration_cast<std::chrono::milliseconds>(
+            entry->expiry - steady_base_).count();
+    }
+
+    encode_wal_set(buffer_, entry->key_data(), entry->key_size, entry->value_data(), entry->value_size,
+                   expire_at_ms);
+    ++count_;
+
+    if (buffer_.size() >= SNAPSHOT_WRITE_SIZE)
+    {
+        write_buffer();
+    }
+}
+
+// 写出缓冲区
+void SnapshotWriter::write_buffer()
+{
+    const char* p = buffer_.data();
+    size_t left = buffer_.size();
+    while (left > 0)
+    {
+        ssize_t n = ::write(fd_, p, left);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            throw std::runtime_error("Failed to write snapshot file: " + tmp_path_ + ": " + strerror(errno));
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    bytes_ += buffer_.size();
+    buffer_.clear();
+}
+
+// 写入结尾并替换正式快照
+void SnapshotWriter::commit()
+{
+    put_varint32(buffer_, 0);
+    put_fixed64(buffer_, count_);
+    write_buffer();
+
+    if (fsync(fd_) != 0)
+    {
+        throw std::runtime_error("Failed to sync snapshot file: " + tmp_path_ + ": " + strerror(errno));
+    }
+    close(fd_);
+    fd_ = -1;
+
+    if (rename(tmp_path_.c_str(), path_.c_str()) != 0)
+    {
+        throw std::runtime_error("Failed to replace snapshot file: " + path_ + ": " + strerror(errno));
+    }
+    committed_ = true;
+    WAL::sync_parent_dir(path_);
+}
+
+// 加载快照
+uint64_t load_snapshot(const std::string& path, KVStore& store, size_t threads, uint64_t* keys)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        if (errno == ENOENT)
+        {
+            return 0;
+        }
+        throw std::runtime_error("Failed to open snapshot file: " + path + ": " + strerror(errno));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    MappedFile file;
+    try {
+        file.map(fd, path);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+
+    const char* data = file.data();
+    if (file.size() < SNAPSHOT_HEADER_SIZE || std::memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+        (static_cast<unsigned char>(data[6]) | (static_cast<unsigned char>(data[7]) << 8)) != SNAPSHOT_FORMAT_VERSION)
+    {
+        throw std::runtime_error("Invalid snapshot file " + path + ": bad header");
+    }
+    uint64_t covered = decode_fixed64(data + 8);
+
+    // 记录与WAL格式相同，同样并行解码和应用
+    WalRecovery recovery(store, threads);
+    WalRecovery::Result result = recovery.replay(data + SNAPSHOT_HEADER_SIZE, file.size() - SNAPSHOT_HEADER_SIZE);
+
+    // 最后一条记录之后必须是结尾标记和记录数
+    size_t end = SNAPSHOT_HEADER_SIZE + result.valid_size;
+    if (result.status != WalReader::END || file.size() - end < 1 + 8 || data[end] != 0)
+    {
+        throw std::runtime_error("Invalid snapshot file " + path + ": truncated or corrupt at offset " +
+                                 std::to_string(end));
+    }
+    if (decode_fixed64(data + end + 1) != result.records)
+    {
+        throw std::runtime_error("Invalid snapshot file " + path + ": record count mismatch");
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Snapshot loaded. Restored " << result.records << " keys (" << file.size() / (1024.0 * 1024.0)
+              << " MB) in " << elapsed << "s using " << recovery.threads() << " threads." << std::endl;
+    if (keys)
+    {
+        *keys = result.records;
+    }
+    return covered;
+}
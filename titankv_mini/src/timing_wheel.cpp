@@ -0,0 +1,110 @@
+#include "../include/timing_wheel.h"
+
+// 构造函数
+TimingWheel::TimingWheel(std::chrono::milliseconds tick, time_point start)
+    : tick_(tick.count() > 0 ? tick : std::chrono::milliseconds(1)), start_(start), current_tick_(0), size_(0)
+{
+}
+
+// 到期时间换算成tick：按时钟精度向上取整，先截断到毫秒会让定时器最多提前1ms到期
+uint64_t TimingWheel::tick_of(time_point deadline) const
+{
+    if (deadline <= start_)
+    {
+        return 0;
+    }
+    auto elapsed = (deadline - start_).count();
+    auto tick = std::chrono::duration_cast<time_point::duration>(tick_).count();
+    return static_cast<uint64_t>((elapsed + tick - 1) / tick);
+}
+
+// 添加定时器
+void TimingWheel::add(const std::string& key, time_point deadline)
+{
+    Timer timer = {key, deadline};
+    ++size_;
+    place(timer, tick_of(deadline));
+}
+
+// 放入合适的层：距离当前tick不足64^(L+1)的放在第L层
+void TimingWheel::place(Timer& timer, uint64_t expire_tick)
+{
+    if (expire_tick <= current_tick_)
+    {
+        ready_.push_back(std::move(timer));
+        return;
+    }
+
+    uint64_t delta = expire_tick - current_tick_;
+    for (unsigned level = 0; level < LEVELS; ++level)
+    {
+        if (delta < (SLOTS << (SLOT_BITS * level)))
+        {
+            slots_[level][(expire_tick >> (SLOT_BITS * level)) & SLOT_MASK].push_back(std::move(timer));
+            return;
+        }
+    }
+
+    // 超出时间轮范围的放在最高层最远的槽，下移时会重新计算
+    const unsigned top = LEVELS - 1;
+    uint64_t capped = current_tick_ + (SLOTS << (SLOT_BITS * top)) - 1;
+    slots_[top][(capped >> (SLOT_BITS * top)) & SLOT_MASK].push_back(std::move(timer));
+}
+
+// 下移第level层当前槽
+void TimingWheel::cascade(unsigned level)
+{
+    std::vector<Timer> timers;
+    timers.swap(slots_[level][(current_tick_ >> (SLOT_BITS * level)) & SLOT_MASK]);
+
+    for (size_t i = 0; i < timers.size(); ++i)
+    {
+        place(timers[i], tick_of(timers[i].deadline));
+    }
+}
+
+// 推进时间轮
+void TimingWheel::advance(time_point now)
+{
+    if (now <= start_)
+    {
+        return;
+    }
+    uint64_t target = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - start_).count() / tick_.count());
+
+    while (current_tick_ < target)
+    {
+        ++current_tick_;
+
+        // 低层转完一圈时，把高层对应槽的定时器下移
+        for (unsigned level = 1; level < LEVELS; ++level)
+        {
+            if ((current_tick_ & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) != 0)
+            {
+                break;
+            }
+            cascade(level);
+        }
+
+        std::vector<Timer>& slot = slots_[0][current_tick_ & SLOT_MASK];
+        for (size_t i = 0; i < slot.size(); ++i)
+        {
+            ready_.push_back(std::move(slot[i]));
+        }
+        slot.clear();
+    }
+}
+
+// 取出就绪的定时器
+bool TimingWheel::pop_ready(Timer& timer)
+{
+    if (ready_.empty())
+    {
+        return false;
+    }
+    timer = std::move(ready_.front());
+    ready_.pop_front();
+    --size_;
+    return true;
+}
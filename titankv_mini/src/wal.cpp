@@ -1,121 +1,1195 @@
 #include "../include/wal.h"
 #include "../include/kvstore.h"
+#include "../include/wal_recovery.h"
+#include "../include/metrics.h"
 #include <stdexcept>
 #include <iostream>
+#include <unordered_map>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// 后台线程写出缓冲区的间隔
+static const std::chrono::milliseconds BACKGROUND_FLUSH_INTERVAL(100);
+// everysec策略下fdatasync的间隔
+static const std::chrono::seconds EVERYSEC_SYNC_INTERVAL(1);
+// 完成线程每次最多取出的完成事件数
+static const size_t REAP_BATCH = 32;
+
+const uint64_t WAL::DEFAULT_SEGMENT_SIZE;
+const size_t WAL::DIRECT_ALIGNMENT;
+
+// 策略名转换
+bool parse_sync_policy(const std::string& name, WalSyncPolicy& policy)
+{
+    if (name == "always")
+    {
+        policy = WalSyncPolicy::Always;
+    }
+    else if (name == "everysec")
+    {
+        policy = WalSyncPolicy::EverySec;
+    }
+    else if (name == "os")
+    {
+        policy = WalSyncPolicy::Os;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+const char* sync_policy_name(WalSyncPolicy policy)
+{
+    switch (policy)
+    {
+    case WalSyncPolicy::Always:
+        return "always";
+    case WalSyncPolicy::EverySec:
+        return "everysec";
+    case WalSyncPolicy::Os:
+        return "os";
+    }
+    return "unknown";
+}
+
+// 写入方式名转换
+bool parse_io_mode(const std::string& name, WalIoMode& mode)
+{
+    if (name == "sync")
+    {
+        mode = WalIoMode::Sync;
+    }
+    else if (name == "io_uring")
+    {
+        mode = WalIoMode::Uring;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+const char* io_mode_name(WalIoMode mode)
+{
+    switch (mode)
+    {
+    case WalIoMode::Sync:
+        return "sync";
+    case WalIoMode::Uring:
+        return "io_uring";
+    }
+    return "unknown";
+}
+
+// 对齐的缓冲区
+WAL::AlignedBuffer::~AlignedBuffer()
+{
+    free(data);
+}
+
+void WAL::AlignedBuffer::reserve(size_t size)
+{
+    if (size <= capacity)
+    {
+        return;
+    }
+    free(data);
+    data = nullptr;
+    capacity = 0;
+
+    size_t rounded = (size + DIRECT_ALIGNMENT - 1) & ~(DIRECT_ALIGNMENT - 1);
+    void* p = nullptr;
+    if (posix_memalign(&p, DIRECT_ALIGNMENT, rounded) != 0)
+    {
+        throw std::bad_alloc();
+    }
+    data = static_cast<char*>(p);
+    capacity = rounded;
+}
+
+// 在指定位置写入全部数据
+static bool pwrite_all(int fd, const char* data, size_t size, uint64_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t n = pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+// 数据是否全为0
+static bool all_zero(const char* data, size_t size)
+{
+    static const char zeros[4096] = {0};
+    while (size > 0)
+    {
+        size_t n = size < sizeof(zeros) ? size : sizeof(zeros);
+        if (std::memcmp(data, zeros, n) != 0)
+        {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
 
 // 构造函数
-WAL::WAL(const std::string& path) : log_path(path), last_flush_size(0)
+WAL::WAL(const std::string& path, WalSyncPolicy policy, uint64_t segment_size, const WalIoOptions& io)
+    : log_path(path), log_fd(-1), policy_(policy), segment_size_(segment_size), appended_lsn_(0), written_lsn_(0),
+      durable_lsn_(0), flushing_(false), failed_(false), legacy_text_(false), segment_no_(0),
+      write_offset_(WAL_HEADER_SIZE), append_segment_no_(0), append_segment_bytes_(WAL_HEADER_SIZE), log_bytes_(0),
+      next_fd_(-1), next_segment_no_(0), preparing_(false), prepare_failed_(false), running_(false),
+      direct_(io.direct), max_inflight_(io.inflight > 0 ? io.inflight : 1), submitted_lsn_(0)
 {
-    // 以追加模式和二进制模式打开日志文件
-    log_file.open(log_path, std::ios::app | std::ios::binary);
-    // 检查是否打开成功
-    if (!log_file.is_open())
+    if (segment_size_ < 4096)
+    {
+        throw std::invalid_argument("WAL segment size must be at least 4096 bytes");
+    }
+
+    // 旧版本的单文件日志：二进制格式的直接作为最新的段，文本格式的在重放后迁移
+    int fd = open(log_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        char header[WAL_HEADER_SIZE];
+        ssize_t n = pread(fd, header, sizeof(header), 0);
+        close(fd);
+
+        uint16_t version = n > 0 ? decode_wal_header(header, static_cast<size_t>(n)) : 0;
+        if (n == 0)
+        {
+            unlink(log_path.c_str());
+        }
+        else if (version == WAL_FORMAT_VERSION)
+        {
+            std::vector<uint64_t> segments = list_segments();
+            std::string target = segment_path(segments.empty() ? 1 : segments.back() + 1);
+            if (rename(log_path.c_str(), target.c_str()) != 0)
+            {
+                throw std::runtime_error("Failed to rename WAL file " + log_path + " to " + target);
+            }
+            sync_parent_dir(log_path);
+        }
+        else if (version != 0)
+        {
+            throw std::runtime_error("Unsupported WAL format version: " + log_path);
+        }
+        else
+        {
+            legacy_text_ = true;
+        }
+    }
+    else if (errno != ENOENT)
     {
-        throw std::runtime_error("Failed to open WAL file: " + log_path);
+        throw std::runtime_error("Failed to open WAL file: " + log_path + ": " + strerror(errno));
     }
-    // 将文件指针移动到文件末尾
-    log_file.seekp(0, std::ios::end);
-    // 记录当前文件大小
-    last_flush_size = log_file.tellp();
+
+    // 每个批次最多占用两个提交项(写入和fdatasync)，另外留一个给停止完成线程的NOP
+    if (io.mode == WalIoMode::Uring)
+    {
+        if (ring_.init(static_cast<unsigned>(max_inflight_ * 2 + 1)))
+        {
+            for (size_t i = 0; i < max_inflight_; ++i)
+            {
+                batches_.emplace_back(new UringBatch());
+                free_batches_.push_back(batches_.back().get());
+            }
+            reap_thread_ = std::thread(&WAL::reap_completions, this);
+        }
+        else
+        {
+            std::cerr << "Warning: io_uring is not available (" << strerror(errno)
+                      << "), falling back to synchronous WAL I/O" << std::endl;
+        }
+    }
+
+    // 启动后台写出线程
+    running_ = true;
+    flush_thread_ = std::thread(&WAL::background_flush, this);
+}
+
+// 实际生效的I/O配置
+WalIoOptions WAL::io_options() const
+{
+    WalIoOptions io;
+    io.mode = ring_.active() ? WalIoMode::Uring : WalIoMode::Sync;
+    io.direct = direct_.load();
+    io.inflight = max_inflight_;
+    return io;
 }
 
 // 析构函数
 WAL::~WAL()
 {
-    if (log_file.is_open())
     {
-        // 强制刷新缓冲区到磁盘
-        log_file.flush();
-        log_file.close();
+        std::lock_guard<std::mutex> lock(log_mutex);
+        running_ = false;
+    }
+    stop_cv_.notify_all();
+    if (flush_thread_.joinable())
+    {
+        flush_thread_.join();
+    }
+
+    if (log_fd >= 0)
+    {
+        // 强制把剩余记录写到磁盘
+        try {
+            flush();
+        } catch (const std::exception& e) {
+            std::cerr << "WAL flush on close failed: " << e.what() << std::endl;
+        }
+        close(log_fd);
+        log_fd = -1;
+    }
+
+    // 用一个NOP唤醒完成线程让它退出；提交失败时完成线程无法唤醒，只能分离
+    if (reap_thread_.joinable())
+    {
+        io_uring_sqe* sqe = ring_.get_sqe();
+        if (sqe)
+        {
+            IoUring::prep_nop(sqe, 0);
+        }
+        if (sqe && ring_.submit())
+        {
+            reap_thread_.join();
+        }
+        else
+        {
+            std::cerr << "Failed to stop WAL completion thread: " << strerror(errno) << std::endl;
+            reap_thread_.detach();
+        }
+    }
+
+    // 没用上的预分配段直接删除
+    if (next_fd_ >= 0)
+    {
+        close(next_fd_);
+        unlink(segment_path(next_segment_no_).c_str());
+        next_fd_ = -1;
     }
 }
 
-// log_set
-void WAL::log_set(const std::string& key, const std::string& value)
+// 追加记录后更新计数
+uint64_t WAL::appended(size_t before, std::chrono::steady_clock::time_point start)
 {
-    // 加锁保护线程安全
-    std::lock_guard<std::mutex> lock(log_mutex);
-    // 构建日志条目
-    std::string entry = "SET " + key + " " + value + "\n";
-    // 将条目写入文件
-    log_file << entry;
-    // 立即刷新缓冲区，确保数据持久化到硬盘
-    log_file.flush();
-
-    // 检查是否写入成功
-    if (!log_file.good())
+    const size_t size = buffer_.size() - before;
+    // 当前段放不下时，这条记录从新段开始(单条记录超过段大小时独占一个段)
+    if (append_segment_bytes_ > WAL_HEADER_SIZE && append_segment_bytes_ + size > segment_size_)
     {
-        throw std::runtime_error("Failed to write to WAL file");
+        boundaries_.push_back(before);
+        ++append_segment_no_;
+        append_segment_bytes_ = WAL_HEADER_SIZE;
     }
+    append_segment_bytes_ += size;
+    appended_lsn_ += size;
+    log_bytes_ += size;
+    Metrics::instance().wal_append.record_since(start);
+    return appended_lsn_;
+}
+
+// 在缓冲区末尾标记段边界
+void WAL::mark_boundary()
+{
+    boundaries_.push_back(buffer_.size());
+    ++append_segment_no_;
+    append_segment_bytes_ = WAL_HEADER_SIZE;
+}
+
+// log_set，expire_at_ms为unix毫秒时间戳，0表示永不过期
+uint64_t WAL::log_set(std::string_view key, std::string_view value, int64_t expire_at_ms)
+{
+    // 直接在缓冲区中编码，不构建临时字符串
+    auto start = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(log_mutex);
+    size_t before = buffer_.size();
+    encode_wal_set(buffer_, key, value, expire_at_ms);
+    return appended(before, start);
 }
 
 // log_del
-void WAL::log_del(const std::string& key)
+uint64_t WAL::log_del(std::string_view key)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(log_mutex);
+    size_t before = buffer_.size();
+    encode_wal_del(buffer_, key);
+    return appended(before, start);
+}
+
+// log_mset
+uint64_t WAL::log_mset(const std::vector<std::pair<std::string_view, std::string_view>>& items)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(log_mutex);
+    size_t before = buffer_.size();
+    encode_wal_mset(buffer_, items);
+    return appended(before, start);
+}
+
+// log_mdel
+uint64_t WAL::log_mdel(const std::vector<std::string_view>& keys)
 {
+    auto start = std::chrono::steady_clock::now();
     std::lock_guard<std::mutex> lock(log_mutex);
-    std::string entry = "DEL " + key + "\n";
-    log_file << entry;
-    log_file.flush();
+    size_t before = buffer_.size();
+    encode_wal_mdel(buffer_, keys);
+    return appended(before, start);
+}
+
+// 写出一个批次：取走整个缓冲区，释放锁后做I/O，完成后唤醒所有等待者
+void WAL::write_batch(std::unique_lock<std::mutex>& lock, bool do_sync)
+{
+    flushing_ = true;
+    // io_uring模式下先等在途的批次完成，之后的写入和fdatasync才能覆盖它们
+    while (!inflight_.empty() && !failed_)
+    {
+        flushed_cv_.wait(lock);
+    }
+    if (failed_)
+    {
+        flushing_ = false;
+        flushed_cv_.notify_all();
+        return;
+    }
+
+    spare_.clear();
+    spare_.swap(buffer_);
+    spare_boundaries_.clear();
+    spare_boundaries_.swap(boundaries_);
+    const uint64_t end = appended_lsn_;
+    submitted_lsn_ = end;
+    lock.unlock();
+    auto start = std::chrono::steady_clock::now();
+
+    // 按段边界分成几段写，遇到边界时切换到下一个段
+    bool ok = true;
+    size_t pos = 0;
+    for (size_t i = 0; ok && i <= spare_boundaries_.size(); ++i)
+    {
+        size_t stop = i < spare_boundaries_.size() ? spare_boundaries_[i] : spare_.size();
+        ok = write_segment(spare_.data() + pos, stop - pos);
+        pos = stop;
+
+        if (ok && i < spare_boundaries_.size())
+        {
+            ok = switch_segment();
+        }
+    }
+
+    if (ok && do_sync && fdatasync(log_fd) != 0)
+    {
+        ok = false;
+    }
+    Metrics::instance().wal_flush.record_since(start);
+
+    lock.lock();
+    flushing_ = false;
+    if (ok)
+    {
+        written_lsn_ = end;
+        if (do_sync)
+        {
+            durable_lsn_ = end;
+        }
+    }
+    else
+    {
+        failed_ = true;
+        std::cerr << "WAL write failed: " << strerror(errno) << std::endl;
+    }
+    flushed_cv_.notify_all();
+}
+
+// 切换到下一个段
+bool WAL::switch_segment()
+{
+    // 旧段先落盘，新段中的记录才可能被确认，保证段之间没有空洞
+    if (fdatasync(log_fd) != 0)
+    {
+        return false;
+    }
+
+    const uint64_t no = segment_no_ + 1;
+    int fd = -1;
+    {
+        std::unique_lock<std::mutex> lock(log_mutex);
+        while (preparing_)
+        {
+            flushed_cv_.wait(lock);
+        }
+        if (next_fd_ >= 0 && next_segment_no_ == no)
+        {
+            fd = next_fd_;
+            next_fd_ = -1;
+        }
+        else
+        {
+            // 后台还没准备好，自己创建，期间不让后台线程重复创建
+            preparing_ = true;
+        }
+    }
 
-    if (!log_file.good())
+    if (fd < 0)
+    {
+        fd = create_segment(no);
+        std::lock_guard<std::mutex> lock(log_mutex);
+        preparing_ = false;
+        if (fd < 0)
+        {
+            return false;
+        }
+    }
+    enable_direct(fd, WAL_HEADER_SIZE);
+
+    int old_fd = log_fd;
+    {
+        std::lock_guard<std::mutex> lock(log_mutex);
+        log_fd = fd;
+        segment_no_ = no;
+        write_offset_ = WAL_HEADER_SIZE;
+        prepare_failed_ = false;
+    }
+    close(old_fd);
+
+    // 让后台线程准备再下一个段
+    stop_cv_.notify_all();
+    return true;
+}
+
+// 创建并预分配一个新段
+int WAL::create_segment(uint64_t n)
+{
+    const std::string path = segment_path(n);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to create WAL segment " << path << ": " << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    std::string h;
+    encode_wal_header(h);
+    if (!pwrite_all(fd, h.data(), h.size(), 0) || !preallocate(fd) || fdatasync(fd) != 0)
+    {
+        std::cerr << "Failed to preallocate WAL segment " << path << ": " << strerror(errno) << std::endl;
+        close(fd);
+        unlink(path.c_str());
+        return -1;
+    }
+    sync_parent_dir(path);
+    return fd;
+}
+
+// 预分配段空间
+bool WAL::preallocate(int fd)
+{
+    if (fallocate(fd, 0, 0, static_cast<off_t>(segment_size_)) == 0)
+    {
+        return true;
+    }
+    if (errno != EOPNOTSUPP && errno != ENOSYS)
+    {
+        return false;
+    }
+
+    // 文件系统不支持fallocate时由glibc写0填充
+    int rc = posix_fallocate(fd, 0, static_cast<off_t>(segment_size_));
+    if (rc != 0)
+    {
+        errno = rc;
+        return false;
+    }
+    return true;
+}
+
+// 等待LSN之前的记录按策略持久化
+void WAL::sync(uint64_t lsn)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(log_mutex);
+    const bool need_sync = policy_ == WalSyncPolicy::Always;
+
+    while ((need_sync ? durable_lsn_ : written_lsn_) < lsn)
+    {
+        if (failed_)
+        {
+            throw std::runtime_error("Failed to write to WAL file");
+        }
+
+        if (flushing_)
+        {
+            // 已有leader在写，等它完成后再看自己的记录是否包含在内
+            flushed_cv_.wait(lock);
+            continue;
+        }
+
+        // 已写出但还需要fdatasync时(例如rotate写出的记录)走同步路径
+        if (ring_.active() && boundaries_.empty() && written_lsn_ < lsn)
+        {
+            // 记录已经提交，或者在途批次已满，等完成线程确认
+            if (submitted_lsn_ >= lsn || free_batches_.empty())
+            {
+                flushed_cv_.wait(lock);
+                continue;
+            }
+            submit_batch(lock);
+            continue;
+        }
+
+        write_batch(lock, need_sync);
+    }
+    Metrics::instance().wal_sync.record_since(start);
+}
+
+// 写出缓冲区并fdatasync
+void WAL::flush()
+{
+    std::unique_lock<std::mutex> lock(log_mutex);
+    while (flushing_)
+    {
+        flushed_cv_.wait(lock);
+    }
+    write_batch(lock, true);
+
+    if (failed_)
     {
         throw std::runtime_error("Failed to write to WAL file");
     }
 }
 
-// 记录TTL信息到日志
-void WAL::log_ttl(const std::string& key, int64_t ttl_seconds)
+// 后台线程
+void WAL::background_flush()
 {
-    // 加锁确保线程安全
+    auto last_sync = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(log_mutex);
+
+    while (running_)
+    {
+        stop_cv_.wait_for(lock, BACKGROUND_FLUSH_INTERVAL);
+        if (!running_ || log_fd < 0)
+        {
+            continue;
+        }
+
+        if (!flushing_)
+        {
+            // 不需要等待确认的记录(例如过期删除)也要及时写出
+            bool everysec_due = policy_ == WalSyncPolicy::EverySec &&
+                std::chrono::steady_clock::now() - last_sync >= EVERYSEC_SYNC_INTERVAL;
+            bool sync_due = policy_ == WalSyncPolicy::Always || everysec_due;
+
+            if (ring_.active() && !everysec_due && boundaries_.empty())
+            {
+                // io_uring模式下同样异步提交，Always策略的批次自带fdatasync
+                if (!buffer_.empty() && !free_batches_.empty())
+                {
+                    submit_batch(lock);
+                }
+            }
+            else if (!buffer_.empty() || !boundaries_.empty() || (sync_due && durable_lsn_ < written_lsn_))
+            {
+                write_batch(lock, sync_due);
+            }
+            if (sync_due)
+            {
+                last_sync = std::chrono::steady_clock::now();
+            }
+        }
+
+        // 提前准备好下一个段，写满时切换不需要等待创建和预分配
+        if (running_ && next_fd_ < 0 && !preparing_ && !prepare_failed_)
+        {
+            const uint64_t no = segment_no_ + 1;
+            preparing_ = true;
+            lock.unlock();
+            int fd = create_segment(no);
+            lock.lock();
+            preparing_ = false;
+
+            if (fd < 0)
+            {
+                prepare_failed_ = true;
+            }
+            else if (no == segment_no_ + 1)
+            {
+                next_fd_ = fd;
+                next_segment_no_ = no;
+            }
+            else
+            {
+                close(fd);
+                unlink(segment_path(no).c_str());
+            }
+            flushed_cv_.notify_all();
+        }
+    }
+}
+
+// 在正在写入的段中写入数据
+bool WAL::write_segment(const char* data, size_t size)
+{
+    size_t io_size = 0;
+    uint64_t io_offset = 0;
+    const char* io_data = prepare_write(data, size, direct_buffer_, io_size, io_offset);
+    return pwrite_all(log_fd, io_data, io_size, io_offset);
+}
+
+// 计算实际写入的数据和位置
+const char* WAL::prepare_write(const char* data, size_t size, AlignedBuffer& buf, size_t& io_size,
+                               uint64_t& io_offset)
+{
+    if (!direct_.load(std::memory_order_relaxed) || size == 0)
+    {
+        io_size = size;
+        io_offset = write_offset_;
+        write_offset_ += size;
+        return data;
+    }
+
+    // 从所在块的开头写起，末尾补0到整块；补的0会被下一次写入覆盖，崩溃后读到的是段尾
+    const size_t head = direct_tail_.size();
+    const size_t total = head + size;
+    const size_t padded = (total + DIRECT_ALIGNMENT - 1) & ~(DIRECT_ALIGNMENT - 1);
+    buf.reserve(padded);
+    std::memcpy(buf.data, direct_tail_.data(), head);
+    std::memcpy(buf.data + head, data, size);
+    std::memset(buf.data + total, 0, padded - total);
+
+    const size_t tail = total % DIRECT_ALIGNMENT;
+    direct_tail_.assign(buf.data + total - tail, tail);
+    io_size = padded;
+    io_offset = write_offset_ - head;
+    write_offset_ += size;
+    return buf.data;
+}
+
+// 为段开启O_DIRECT
+void WAL::enable_direct(int fd, uint64_t offset)
+{
+    if (!direct_.load())
+    {
+        return;
+    }
+
+    // 先用普通读取取出写入位置所在块的已有内容，之后的写入从块的开头开始
+    const size_t head = offset % DIRECT_ALIGNMENT;
+    std::string tail(head, '\0');
+    bool ok = head == 0 || pread(fd, &tail[0], head, static_cast<off_t>(offset - head)) == static_cast<ssize_t>(head);
+    int flags = ok ? fcntl(fd, F_GETFL) : -1;
+    if (flags >= 0 && fcntl(fd, F_SETFL, flags | O_DIRECT) == 0)
+    {
+        direct_tail_.swap(tail);
+        return;
+    }
+
+    std::cerr << "Warning: O_DIRECT is not supported for WAL " << log_path << " (" << strerror(errno)
+              << "), falling back to buffered writes" << std::endl;
+    direct_ = false;
+    direct_tail_.clear();
+}
+
+// 把缓冲区作为一个批次提交到io_uring
+void WAL::submit_batch(std::unique_lock<std::mutex>& lock)
+{
+    UringBatch* batch = free_batches_.back();
+    free_batches_.pop_back();
+    flushing_ = true;
+    batch->data.clear();
+    batch->data.swap(buffer_);
+    batch->end = appended_lsn_;
+    batch->sync = policy_ == WalSyncPolicy::Always;
+    batch->done = false;
+    batch->ok = false;
+    // O_DIRECT时与上一个在途批次写同一个块，必须等它完成再写，否则旧内容可能覆盖新内容
+    const bool overlap = !inflight_.empty() && direct_.load(std::memory_order_relaxed) && !direct_tail_.empty();
+    submitted_lsn_ = appended_lsn_;
+    inflight_.push_back(batch);
+    lock.unlock();
+
+    batch->fd = log_fd;
+    batch->io_data = prepare_write(batch->data.data(), batch->data.size(), batch->aligned, batch->io_size,
+                                   batch->io_offset);
+    batch->pending = batch->sync ? 2 : 1;
+    batch->write_res = 0;
+    batch->sync_res = 0;
+    batch->submitted = std::chrono::steady_clock::now();
+
+    // 批次数有上限，提交队列不会满
+    const uint64_t user_data = reinterpret_cast<uint64_t>(batch);
+    io_uring_sqe* sqe = ring_.get_sqe();
+    IoUring::prep_write(sqe, batch->fd, batch->io_data, batch->io_size, batch->io_offset, user_data);
+    if (overlap)
+    {
+        sqe->flags |= IOSQE_IO_DRAIN;
+    }
+    if (batch->sync)
+    {
+        // 写入完成后才执行fdatasync；写入失败或只写了一部分时fdatasync被取消
+        sqe->flags |= IOSQE_IO_LINK;
+        IoUring::prep_fdatasync(ring_.get_sqe(), batch->fd, user_data | 1);
+    }
+    bool ok = ring_.submit();
+
+    lock.lock();
+    flushing_ = false;
+    if (!ok)
+    {
+        failed_ = true;
+        std::cerr << "WAL io_uring submit failed: " << strerror(errno) << std::endl;
+    }
+    flushed_cv_.notify_all();
+}
+
+// 完成线程
+void WAL::reap_completions()
+{
+    io_uring_cqe cqes[REAP_BATCH];
+    for (;;)
+    {
+        size_t n = ring_.wait(cqes, REAP_BATCH);
+        if (n == 0)
+        {
+            std::cerr << "WAL io_uring wait failed: " << strerror(errno) << std::endl;
+            std::lock_guard<std::mutex> lock(log_mutex);
+            failed_ = true;
+            flushed_cv_.notify_all();
+            return;
+        }
+
+        bool stop = false;
+        for (size_t i = 0; i < n; ++i)
+        {
+            // user_data为0是析构时提交的NOP；最低位区分写入和fdatasync
+            if (cqes[i].user_data == 0)
+            {
+                stop = true;
+                continue;
+            }
+            UringBatch* batch = reinterpret_cast<UringBatch*>(cqes[i].user_data & ~uint64_t(1));
+            if (cqes[i].user_data & 1)
+            {
+                batch->sync_res = cqes[i].res;
+            }
+            else
+            {
+                batch->write_res = cqes[i].res;
+            }
+            if (--batch->pending == 0)
+            {
+                finish_batch(batch);
+            }
+        }
+        if (stop)
+        {
+            return;
+        }
+    }
+}
+
+// 确认一个批次
+void WAL::finish_batch(UringBatch* batch)
+{
+    // 只写了一部分或者被拒绝(例如内核不支持该操作)时，剩余部分同步补写，被取消的fdatasync也同步执行
+    bool ok = true;
+    size_t done = batch->write_res > 0 ? static_cast<size_t>(batch->write_res) : 0;
+    if (done < batch->io_size)
+    {
+        ok = pwrite_all(batch->fd, batch->io_data + done, batch->io_size - done, batch->io_offset + done);
+    }
+    if (ok && batch->sync && (batch->sync_res < 0 || done < batch->io_size))
+    {
+        ok = fdatasync(batch->fd) == 0;
+    }
+    Metrics::instance().wal_flush.record_since(batch->submitted);
+
     std::lock_guard<std::mutex> lock(log_mutex);
-    // 构建日志条目：格式："TTL KEY TTL_SECONDS TIMESTAMP\n"
-    auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count();
-    std::string entry = "TTL " + key + " " + std::to_string(ttl_seconds) + " " + std::to_string(timestamp) + "\n";
-    // 将条目写入文件
-    log_file << entry;
-    // 立即刷新缓冲区，确保数据持久化到硬盘
-    log_file.flush();
-
-    //检查是否写入成功
-    if (!log_file.good())
+    batch->done = true;
+    batch->ok = ok;
+    batch->error = ok ? 0 : errno;
+
+    // 批次可能乱序完成，只确认从最早的批次开始连续完成的部分
+    while (!inflight_.empty() && inflight_.front()->done)
+    {
+        UringBatch* front = inflight_.front();
+        inflight_.pop_front();
+        if (!front->ok && !failed_)
+        {
+            failed_ = true;
+            std::cerr << "WAL write failed: " << strerror(front->error) << std::endl;
+        }
+        if (!failed_)
+        {
+            written_lsn_ = front->end;
+            if (front->sync)
+            {
+                durable_lsn_ = front->end;
+            }
+        }
+        free_batches_.push_back(front);
+    }
+    flushed_cv_.notify_all();
+}
+
+// 重放日志以恢复数据
+void WAL::replay(KVStore& store, uint64_t covered, size_t threads)
+{
+    auto start = std::chrono::steady_clock::now();
+    WalRecovery recovery(store, threads);
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+
+    // 旧版文本日志中的数据比所有段都早
+    if (legacy_text_)
+    {
+        replay_text(store);
+    }
+
+    // 已被快照覆盖的段是上次删除前崩溃留下的
+    remove_segments(covered);
+
+    std::vector<uint64_t> segments = list_segments();
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        bool last = i + 1 == segments.size();
+        const std::string path = segment_path(segments[i]);
+        int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to open WAL segment: " + path + ": " + strerror(errno));
+        }
+
+        uint64_t valid_end = 0;
+        bool clean;
+        try {
+            clean = replay_file(fd, path, recovery, records, bytes, valid_end);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+
+        if (!last && clean)
+        {
+            close(fd);
+            continue;
+        }
+
+        // 中间的段在有效记录之后损坏：只能恢复到这里为止，跳过空洞继续重放之后的段会让更晚的修改叠加在丢失的修改之上。
+        // 之后的段只是预分配好、还没有写入记录时(切换前崩溃)删除它们，把这个段作为最后一个段继续追加；
+        // 之后的段中还有记录时无法得到一致的前缀，拒绝启动，由管理员处理
+        if (!last)
+        {
+            for (size_t j = i + 1; j < segments.size(); ++j)
+            {
+                if (!segment_empty(segments[j]))
+                {
+                    close(fd);
+                    throw std::runtime_error("WAL segment " + path + " is damaged at offset " + std::to_string(valid_end) +
+                                             " but later segment " + segment_path(segments[j]) +
+                                             " contains records; refusing to replay past the gap");
+                }
+            }
+            for (size_t j = i + 1; j < segments.size(); ++j)
+            {
+                const std::string later = segment_path(segments[j]);
+                std::cerr << "Warning: WAL " << later << ": removing empty segment after damaged segment " << path << std::endl;
+                if (unlink(later.c_str()) != 0)
+                {
+                    close(fd);
+                    throw std::runtime_error("Failed to remove WAL segment: " + later + ": " + strerror(errno));
+                }
+            }
+            segments.resize(i + 1);
+            last = true;
+        }
+
+        // 在最后一个段上继续追加；损坏或写了一半的尾部清零，之后追加的记录才能被正常读到
+        if (!clean)
+        {
+            std::cerr << "Warning: WAL " << path << ": discarding data after offset " << valid_end << std::endl;
+            std::string h;
+            encode_wal_header(h);
+            bool ok = ftruncate(fd, static_cast<off_t>(valid_end)) == 0;
+            if (ok && valid_end < WAL_HEADER_SIZE)
+            {
+                ok = pwrite_all(fd, h.data(), h.size(), 0);
+                valid_end = WAL_HEADER_SIZE;
+            }
+            if (!ok || !preallocate(fd) || fdatasync(fd) != 0)
+            {
+                close(fd);
+                throw std::runtime_error("Failed to reset WAL segment tail: " + path);
+            }
+        }
+
+        enable_direct(fd, valid_end);
+        std::lock_guard<std::mutex> lock(log_mutex);
+        log_fd = fd;
+        segment_no_ = segments[i];
+        write_offset_ = valid_end;
+    }
+
+    // 没有可用的段时新建一个，编号必须大于快照覆盖的段
+    if (log_fd < 0)
+    {
+        int fd = create_segment(covered + 1);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to create WAL segment: " + segment_path(covered + 1));
+        }
+        enable_direct(fd, WAL_HEADER_SIZE);
+        std::lock_guard<std::mutex> lock(log_mutex);
+        log_fd = fd;
+        segment_no_ = covered + 1;
+        write_offset_ = WAL_HEADER_SIZE;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(log_mutex);
+        append_segment_no_ = segment_no_;
+        append_segment_bytes_ = write_offset_;
+        log_bytes_ = bytes;
+    }
+    stop_cv_.notify_all();
+
+    if (legacy_text_)
+    {
+        migrate(store);
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double mb = bytes / (1024.0 * 1024.0);
+    std::cout << "WAL recovery completed. Restored " << records << " operations (" << mb << " MB, "
+              << segments.size() << " segments) in " << elapsed << "s using " << recovery.threads() << " threads";
+    if (elapsed > 0)
+    {
+        std::cout << ", " << static_cast<uint64_t>(records / elapsed) << " ops/s, " << mb / elapsed << " MB/s";
+    }
+    std::cout << "." << std::endl;
+}
+
+// 段中是否没有任何记录(没有文件头，或文件头之后全为0)
+bool WAL::segment_empty(uint64_t n) const
+{
+    const std::string path = segment_path(n);
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open WAL segment: " + path + ": " + strerror(errno));
+    }
+    MappedFile file;
+    try {
+        file.map(fd, path);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+    if (file.size() <= WAL_HEADER_SIZE || all_zero(file.data(), WAL_HEADER_SIZE))
+    {
+        return true;
+    }
+    return all_zero(file.data() + WAL_HEADER_SIZE, file.size() - WAL_HEADER_SIZE);
+}
+
+// 重放一个段：映射到内存后并行解码和应用
+bool WAL::replay_file(int fd, const std::string& path, WalRecovery& recovery, uint64_t& records,
+                      uint64_t& bytes, uint64_t& valid_end)
+{
+    MappedFile file;
+    file.map(fd, path);
+    const char* data = file.data();
+
+    // 创建段时崩溃可能留下没有文件头的段
+    if (file.size() < WAL_HEADER_SIZE || all_zero(data, WAL_HEADER_SIZE))
+    {
+        valid_end = 0;
+        return false;
+    }
+    if (decode_wal_header(data, file.size()) != WAL_FORMAT_VERSION)
+    {
+        throw std::runtime_error("Invalid WAL segment header: " + path);
+    }
+
+    WalRecovery::Result result = recovery.replay(data + WAL_HEADER_SIZE, file.size() - WAL_HEADER_SIZE);
+    records += result.records;
+    bytes += result.valid_size;
+    valid_end = WAL_HEADER_SIZE + result.valid_size;
+
+    // 有效记录之后应当全是预分配的0
+    if (all_zero(data + valid_end, file.size() - valid_end))
+    {
+        return true;
+    }
+    std::cerr << "Warning: WAL " << path << ": " << (result.status == WalReader::CORRUPT ? "corrupt" : "torn")
+              << " record at offset " << valid_end << std::endl;
+    return false;
+}
+
+// 结束当前段
+uint64_t WAL::rotate()
+{
+    std::unique_lock<std::mutex> lock(log_mutex);
+    if (failed_)
     {
         throw std::runtime_error("Failed to write to WAL file");
     }
 
+    // 当前段为空时不需要切换
+    uint64_t covered = append_segment_no_ - 1;
+    if (append_segment_bytes_ > WAL_HEADER_SIZE)
+    {
+        covered = append_segment_no_;
+        mark_boundary();
+    }
+    log_bytes_ = 0;
+
+    // 等到写入端也切换过去，返回时新段已经存在，被覆盖的段不会再被写入
+    while (segment_no_ <= covered)
+    {
+        if (failed_)
+        {
+            throw std::runtime_error("Failed to write to WAL file");
+        }
+        if (flushing_)
+        {
+            flushed_cv_.wait(lock);
+            continue;
+        }
+        write_batch(lock, false);
+    }
+    return covered;
 }
 
-// 重放日志以恢复数据
-void WAL::replay(KVStore& store)
+// 删除已被快照覆盖的段
+void WAL::remove_segments(uint64_t upto)
+{
+    std::vector<uint64_t> segments = list_segments();
+    bool removed = false;
+    for (size_t i = 0; i < segments.size() && segments[i] <= upto; ++i)
+    {
+        if (unlink(segment_path(segments[i]).c_str()) == 0)
+        {
+            removed = true;
+        }
+    }
+    if (removed)
+    {
+        sync_parent_dir(log_path);
+    }
+}
+
+// 未被快照覆盖的日志字节数
+uint64_t WAL::log_size()
 {
     std::lock_guard<std::mutex> lock(log_mutex);
+    return log_bytes_;
+}
 
-    // 如果文件没有打开，直接返回
-    /*if (!log_file.is_open()) {
-        log_file.open(log_path, std::ios::app | std::ios::binary);
-        if (!log_file.is_open()) {
-            throw std::runtime_error("Failed to reopen WAL file");
+// 段文件路径
+std::string WAL::segment_path(uint64_t n) const
+{
+    return log_path + "." + std::to_string(n);
+}
+
+// 列出已有段的编号
+std::vector<uint64_t> WAL::list_segments() const
+{
+    size_t slash = log_path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : log_path.substr(0, slash == 0 ? 1 : slash);
+    std::string prefix = (slash == std::string::npos ? log_path : log_path.substr(slash + 1)) + ".";
+
+    std::vector<uint64_t> segments;
+    DIR* d = opendir(dir.c_str());
+    if (!d)
+    {
+        return segments;
+    }
+    while (struct dirent* ent = readdir(d))
+    {
+        std::string name = ent->d_name;
+        if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0)
+        {
+            continue;
         }
-        return;
-    }*/
+        std::string suffix = name.substr(prefix.size());
+        if (suffix.size() > 18 || suffix.find_first_not_of("0123456789") != std::string::npos)
+        {
+            continue;
+        }
+        segments.push_back(std::stoull(suffix));
+    }
+    closedir(d);
+
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
 
-    // 如果写文件流是打开的，先关闭它
-    if (log_file.is_open()) {
-        log_file.close();
+// 把旧版文本日志中的数据写入段中
+void WAL::migrate(KVStore& store)
+{
+    const std::string backup_path = log_path + ".legacy";
+
+    // 与普通写入一样先持分片锁再追加日志
+    store.for_each_entry([&](const Entry* e) {
+        log_set(e->key(), e->value(), steady_to_unix_ms(e->expiry));
+    });
+    flush();
+
+    // 数据已经落盘，原文件只作为备份保留
+    if (rename(log_path.c_str(), backup_path.c_str()) != 0)
+    {
+        throw std::runtime_error("Failed to rename legacy WAL file: " + log_path);
     }
-    
-    // 关闭当前输出文件流，现在写入不需要了
-    //log_file.close();
-    
-    // 以输入模式重新打开日志文件，以供读操作
+    sync_parent_dir(log_path);
+    legacy_text_ = false;
+
+    std::cout << "Migrated legacy text WAL to binary format (" << store.size() << " keys, backup: "
+              << backup_path << ")" << std::endl;
+}
+
+// fsync文件所在目录，保证rename持久化
+void WAL::sync_parent_dir(const std::string& path)
+{
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash == 0 ? 1 : slash);
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// 重放旧版文本日志
+void WAL::replay_text(KVStore& store)
+{
+    // 以输入模式打开日志文件，以供读操作(追加用的描述符不受影响)
     std::ifstream infile(log_path, std::ios::binary);
     if (!infile.is_open())
     {
-        // 如果打开失败，那么重新打开输出文件流
-        log_file.open(log_path, std::ios::app | std::ios::binary);
-        if (!log_file.is_open()) {
-            throw std::runtime_error("Failed to reopen WAL file for writing");
-        }
         return;
     }
 
@@ -240,12 +1314,4 @@ void WAL::replay(KVStore& store)
     infile.close();
 
     std::cout << "WAL recovery completed. Restored " << count << " operations." << std::endl;
-
-    // 重新打开文件为追加模式
-    log_file.open(log_path, std::ios::app | std::ios::binary);
-    if (!log_file.is_open())
-    {
-        throw std::runtime_error("Failed to reopen WAL file for appending");
-    }
-    last_flush_size = log_file.tellp();
 }
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include "../include/wal_record.h"
+#include "../include/coding.h"
+#include "../include/crc32c.h"
+
+static const char WAL_MAGIC[6] = {'T', 'K', 'V', 'W', 'A', 'L'};
+
+// 文件头
+void encode_wal_header(std::string& dst)
+{
+    dst.append(WAL_MAGIC, sizeof(WAL_MAGIC));
+    dst.push_back(static_cast<char>(WAL_FORMAT_VERSION & 0xFF));
+    dst.push_back(static_cast<char>(WAL_FORMAT_VERSION >> 8));
+}
+
+uint16_t decode_wal_header(const char* data, size_t size)
+{
+    if (size < WAL_HEADER_SIZE || std::memcmp(data, WAL_MAGIC, sizeof(WAL_MAGIC)) != 0)
+    {
+        return 0;
+    }
+    return static_cast<uint16_t>(static_cast<unsigned char>(data[6]) |
+                                 (static_cast<unsigned char>(data[7]) << 8));
+}
+
+// 先写长度和占位的校验和，payload写完后回填校验和
+static size_t begin_record(std::string& dst, size_t payload_size)
+{
+    put_varint32(dst, static_cast<uint32_t>(payload_size));
+    dst.append(4, '\0');
+    return dst.size();
+}
+
+static void finish_record(std::string& dst, size_t payload_start)
+{
+    uint32_t crc = crc32c(dst.data() + payload_start, dst.size() - payload_start);
+    encode_fixed32(&dst[payload_start - 4], crc);
+}
+
+// SET记录
+void encode_wal_set(std::string& dst, const char* key, size_t key_size,
+                    const char* value, size_t value_size, int64_t expire_at_ms)
+{
+    uint64_t expire = expire_at_ms > 0 ? static_cast<uint64_t>(expire_at_ms) : 0;
+    size_t payload_size = 1 + varint_length(key_size) + key_size +
+                          varint_length(value_size) + value_size + varint_length(expire);
+
+    size_t start = begin_record(dst, payload_size);
+    dst.push_back(static_cast<char>(WAL_OP_SET));
+    put_varint32(dst, static_cast<uint32_t>(key_size));
+    dst.append(key, key_size);
+    put_varint32(dst, static_cast<uint32_t>(value_size));
+    dst.append(value, value_size);
+    put_varint64(dst, expire);
+    finish_record(dst, start);
+}
+
+void encode_wal_set(std::string& dst, std::string_view key, std::string_view value, int64_t expire_at_ms)
+{
+    encode_wal_set(dst, key.data(), key.size(), value.data(), value.size(), expire_at_ms);
+}
+
+// DEL记录
+void encode_wal_del(std::string& dst, std::string_view key)
+{
+    size_t payload_size = 1 + varint_length(key.size()) + key.size();
+
+    size_t start = begin_record(dst, payload_size);
+    dst.push_back(static_cast<char>(WAL_OP_DEL));
+    put_varint32(dst, static_cast<uint32_t>(key.size()));
+    dst.append(key);
+    finish_record(dst, start);
+}
+
+// BATCH记录：多个SET，共用一个CRC
+void encode_wal_mset(std::string& dst, const std::vector<std::pair<std::string_view, std::string_view>>& items)
+{
+    size_t payload_size = 1 + varint_length(items.size());
+    for (const auto& item : items)
+    {
+        payload_size += 1 + varint_length(item.first.size()) + item.first.size() +
+                        varint_length(item.second.size()) + item.second.size() + varint_length(0);
+    }
+
+    size_t start = begin_record(dst, payload_size);
+    dst.push_back(static_cast<char>(WAL_OP_BATCH));
+    put_varint32(dst, static_cast<uint32_t>(items.size()));
+    for (const auto& item : items)
+    {
+        dst.push_back(static_cast<char>(WAL_OP_SET));
+        put_varint32(dst, static_cast<uint32_t>(item.first.size()));
+        dst.append(item.first);
+        put_varint32(dst, static_cast<uint32_t>(item.second.size()));
+        dst.append(item.second);
+        put_varint64(dst, 0);
+    }
+    finish_record(dst, start);
+}
+
+// BATCH记录：多个DEL
+void encode_wal_mdel(std::string& dst, const std::vector<std::string_view>& keys)
+{
+    size_t payload_size = 1 + varint_length(keys.size());
+    for (std::string_view key : keys)
+    {
+        payload_size += 1 + varint_length(key.size()) + key.size();
+    }
+
+    size_t start = begin_record(dst, payload_size);
+    dst.push_back(static_cast<char>(WAL_OP_BATCH));
+    put_varint32(dst, static_cast<uint32_t>(keys.size()));
+    for (std::string_view key : keys)
+    {
+        dst.push_back(static_cast<char>(WAL_OP_DEL));
+        put_varint32(dst, static_cast<uint32_t>(key.size()));
+        dst.append(key);
+    }
+    finish_record(dst, start);
+}
+
+// 解析下一条记录
+WalReader::Status WalReader::next(WalRecord& record)
+{
+    const char* p = data_ + offset_;
+    const char* limit = data_ + size_;
+    if (p == limit)
+    {
+        return END;
+    }
+
+    uint32_t payload_size = 0;
+    const char* q = get_varint32(p, limit, &payload_size);
+    if (!q)
+    {
+        // varint本身不完整
+        return (limit - p) < 5 ? TRUNCATED : CORRUPT;
+    }
+    if (payload_size == 0)
+    {
+        // 预分配区域或日志结尾
+        return END;
+    }
+    if (payload_size > WAL_MAX_RECORD_SIZE)
+    {
+        return CORRUPT;
+    }
+    if (static_cast<size_t>(limit - q) < 4 + static_cast<size_t>(payload_size))
+    {
+        return TRUNCATED;
+    }
+
+    uint32_t expected_crc = decode_fixed32(q);
+    const char* payload = q + 4;
+    const char* end = payload + payload_size;
+    if (crc32c(payload, payload_size) != expected_crc)
+    {
+        return CORRUPT;
+    }
+
+    if (!decode_wal_payload(payload, payload_size, record))
+    {
+        return CORRUPT;
+    }
+
+    offset_ = static_cast<size_t>(end - data_);
+    return OK;
+}
+
+// 解析一个SET/DEL条目
+const char* decode_wal_entry(const char* p, const char* end, WalRecord& record)
+{
+    if (p == end)
+    {
+        return nullptr;
+    }
+    record.entry = p;
+    record.op = static_cast<uint8_t>(*p);
+    const char* r = get_varint32(p + 1, end, &record.key_size);
+    if (!r || static_cast<size_t>(end - r) < record.key_size)
+    {
+        return nullptr;
+    }
+    record.key = r;
+    r += record.key_size;
+    record.value = nullptr;
+    record.value_size = 0;
+    record.expire_at_ms = 0;
+
+    if (record.op == WAL_OP_SET)
+    {
+        r = get_varint32(r, end, &record.value_size);
+        if (!r || static_cast<size_t>(end - r) < record.value_size)
+        {
+            return nullptr;
+        }
+        record.value = r;
+        r += record.value_size;
+
+        uint64_t expire = 0;
+        r = get_varint64(r, end, &expire);
+        if (!r)
+        {
+            return nullptr;
+        }
+        record.expire_at_ms = static_cast<int64_t>(expire);
+    }
+    else if (record.op != WAL_OP_DEL)
+    {
+        return nullptr;
+    }
+
+    return r;
+}
+
+// 解析payload
+bool decode_wal_payload(const char* payload, size_t size, WalRecord& record)
+{
+    const char* end = payload + size;
+    if (size == 0)
+    {
+        return false;
+    }
+    if (static_cast<uint8_t>(*payload) != WAL_OP_BATCH)
+    {
+        record.batch = nullptr;
+        record.batch_end = nullptr;
+        record.batch_count = 0;
+        return decode_wal_entry(payload, end, record) == end;
+    }
+
+    // BATCH：检查每个条目，之后重放时不再校验
+    uint32_t count = 0;
+    const char* r = get_varint32(payload + 1, end, &count);
+    if (!r || count == 0)
+    {
+        return false;
+    }
+    const char* batch = r;
+    WalRecord entry;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        r = decode_wal_entry(r, end, entry);
+        if (!r)
+        {
+            return false;
+        }
+    }
+    if (r != end)
+    {
+        return false;
+    }
+
+    record.op = WAL_OP_BATCH;
+    record.entry = payload;
+    record.key = nullptr;
+    record.key_size = 0;
+    record.value = nullptr;
+    record.value_size = 0;
+    record.expire_at_ms = 0;
+    record.batch = batch;
+    record.batch_end = end;
+    record.batch_count = count;
+    return true;
+}
+
+// 时间转换
+int64_t steady_to_unix_ms(std::chrono::steady_clock::time_point tp)
+{
+    if (tp == std::chrono::steady_clock::time_point::max())
+    {
+        return 0;
+    }
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(tp - std::chrono::steady_clock::now());
+    auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    int64_t at = (now_ms + remaining).count();
+    return at > 0 ? at : 1;
+}
+
+std::chrono::steady_clock::time_point unix_ms_to_steady(int64_t unix_ms)
+{
+    if (unix_ms <= 0)
+    {
+        return std::chrono::steady_clock::time_point::max();
+    }
+    auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return std::chrono::steady_clock::now() + std::chrono::milliseconds(unix_ms - now_ms);
+}
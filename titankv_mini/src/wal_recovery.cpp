@@ -0,0 +1,324 @@
+#include "../include/wal_recovery.h"
+#include "../include/kvstore.h"
+#include "../include/coding.h"
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// 每个块的目标字节数
+static const size_t RECOVERY_CHUNK_SIZE = 4 << 20;
+// 每个窗口的块数 = 线程数 * 该值，窗口内的记录引用全部放在内存中
+static const size_t RECOVERY_CHUNKS_PER_THREAD = 4;
+
+// 映射文件
+MappedFile::~MappedFile()
+{
+    if (data_)
+    {
+        munmap(data_, size_);
+    }
+}
+
+void MappedFile::map(int fd, const std::string& path)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        throw std::runtime_error("Failed to stat " + path + ": " + strerror(errno));
+    }
+    if (st.st_size == 0)
+    {
+        return;
+    }
+
+    void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED)
+    {
+        throw std::runtime_error("Failed to mmap " + path + ": " + strerror(errno));
+    }
+    // 顺序读取，让内核尽早预读
+    madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    data_ = static_cast<char*>(p);
+    size_ = static_cast<size_t>(st.st_size);
+}
+
+// 只读长度字段确定一条记录的范围，不校验CRC
+static WalReader::Status frame_record(const char* p, const char* limit, size_t* record_size)
+{
+    if (p == limit)
+    {
+        return WalReader::END;
+    }
+
+    uint32_t payload_size = 0;
+    const char* q = get_varint32(p, limit, &payload_size);
+    if (!q)
+    {
+        return (limit - p) < 5 ? WalReader::TRUNCATED : WalReader::CORRUPT;
+    }
+    if (payload_size == 0)
+    {
+        return WalReader::END;
+    }
+    if (payload_size > WAL_MAX_RECORD_SIZE)
+    {
+        return WalReader::CORRUPT;
+    }
+    if (static_cast<size_t>(limit - q) < 4 + static_cast<size_t>(payload_size))
+    {
+        return WalReader::TRUNCATED;
+    }
+
+    *record_size = static_cast<size_t>(q - p) + 4 + payload_size;
+    return WalReader::OK;
+}
+
+// 构造
+WalRecovery::WalRecovery(KVStore& store, size_t threads) : store_(store), threads_(threads)
+{
+    if (threads_ == 0)
+    {
+        threads_ = std::thread::hardware_concurrency();
+    }
+    if (threads_ == 0)
+    {
+        threads_ = 1;
+    }
+}
+
+// 重放
+WalRecovery::Result WalRecovery::replay(const char* data, size_t size)
+{
+    Result result;
+    result.status = WalReader::END;
+    result.valid_size = 0;
+    result.records = 0;
+
+    const size_t shard_count = store_.shard_count();
+    const size_t max_chunks = threads_ * RECOVERY_CHUNKS_PER_THREAD;
+    if (chunks_.size() < max_chunks)
+    {
+        chunks_.resize(max_chunks);
+    }
+    for (size_t i = 0; i < chunks_.size(); ++i)
+    {
+        chunks_[i].parts.resize(shard_count);
+    }
+
+    size_t pos = 0;
+    bool stop = false;
+    while (!stop)
+    {
+        // 划分窗口：每个块在记录边界处结束
+        size_t chunk_count = 0;
+        size_t chunk_begin = pos;
+        while (chunk_count < max_chunks)
+        {
+            size_t record_size = 0;
+            WalReader::Status status = frame_record(data + pos, data + size, &record_size);
+            if (status == WalReader::OK)
+            {
+                pos += record_size;
+            }
+            else
+            {
+                result.status = status;
+                stop = true;
+            }
+
+            if (pos > chunk_begin && (stop || pos - chunk_begin >= RECOVERY_CHUNK_SIZE))
+            {
+                Chunk& chunk = chunks_[chunk_count++];
+                chunk.begin = chunk_begin;
+                chunk.end = pos;
+                chunk_begin = pos;
+            }
+            if (stop)
+            {
+                break;
+            }
+        }
+
+        if (chunk_count == 0)
+        {
+            break;
+        }
+
+        // 并行解码
+        parallel_for(chunk_count, [&](size_t i) {
+            decode_chunk(data, chunks_[i]);
+        });
+
+        // 遇到损坏的记录时只保留它之前的部分
+        for (size_t i = 0; i < chunk_count; ++i)
+        {
+            if (chunks_[i].corrupt)
+            {
+                chunk_count = i + 1;
+                pos = chunks_[i].valid_end;
+                result.status = WalReader::CORRUPT;
+                stop = true;
+                break;
+            }
+        }
+
+        // 并行按分片应用
+        std::atomic<uint64_t> applied(0);
+        parallel_for(shard_count, [&](size_t shard) {
+            applied.fetch_add(apply_shard(data, shard, chunk_count), std::memory_order_relaxed);
+        });
+        result.records += applied.load();
+        result.valid_size = pos;
+    }
+
+    return result;
+}
+
+// 解码一个块：校验CRC，按分片记录每条记录的位置
+void WalRecovery::decode_chunk(const char* data, Chunk& chunk)
+{
+    for (size_t s = 0; s < chunk.parts.size(); ++s)
+    {
+        chunk.parts[s].clear();
+    }
+    chunk.corrupt = false;
+    chunk.valid_end = chunk.end;
+
+    const char* base = data + chunk.begin;
+    WalReader reader(base, chunk.end - chunk.begin);
+    WalRecord rec;
+    size_t offset = 0;
+    WalReader::Status status;
+    while ((status = reader.next(rec)) == WalReader::OK)
+    {
+        if (rec.op == WAL_OP_BATCH)
+        {
+            // 整批已经校验过，各条目按自己的键分到分片
+            WalRecord entry;
+            const char* p = rec.batch;
+            for (uint32_t i = 0; i < rec.batch_count; ++i)
+            {
+                p = decode_wal_entry(p, rec.batch_end, entry);
+                add_ref(chunk, base, entry);
+            }
+        }
+        else
+        {
+            add_ref(chunk, base, rec);
+        }
+        offset = reader.offset();
+    }
+
+    if (offset != chunk.end - chunk.begin)
+    {
+        chunk.corrupt = true;
+        chunk.valid_end = chunk.begin + offset;
+    }
+}
+
+// 记录一个条目的位置
+void WalRecovery::add_ref(Chunk& chunk, const char* base, const WalRecord& entry)
+{
+    RecordRef ref;
+    ref.hash = hash_key(std::string_view(entry.key, entry.key_size));
+    ref.offset = static_cast<uint32_t>(entry.entry - base);
+    chunk.parts[store_.shard_index(ref.hash)].push_back(ref);
+}
+
+// 应用一个分片的记录
+uint64_t WalRecovery::apply_shard(const char* data, size_t shard, size_t chunk_count)
+{
+    // 日志中是绝对过期时间，用同一个基准换算为steady_clock时间点
+    const auto steady_now = std::chrono::steady_clock::now();
+    const int64_t unix_now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::string key;
+    uint64_t count = 0;
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+        const Chunk& chunk = chunks_[i];
+        const std::vector<RecordRef>& refs = chunk.parts[shard];
+        for (size_t j = 0; j < refs.size(); ++j)
+        {
+            // 解码阶段已经校验过，这里直接解析条目
+            WalRecord rec;
+            decode_wal_entry(data + chunk.begin + refs[j].offset, data + chunk.end, rec);
+
+            key.assign(rec.key, rec.key_size);
+            if (rec.op == WAL_OP_SET && rec.expire_at_ms == 0)
+            {
+                store_.recover_set(refs[j].hash, key, rec.value, rec.value_size,
+                                   std::chrono::steady_clock::time_point::max());
+            }
+            else if (rec.op == WAL_OP_SET && rec.expire_at_ms > unix_now_ms)
+            {
+                store_.recover_set(refs[j].hash, key, rec.value, rec.value_size,
+                                   steady_now + std::chrono::milliseconds(rec.expire_at_ms - unix_now_ms));
+            }
+            else
+            {
+                // DEL，或者重启期间已经过期的SET
+                store_.recover_del(refs[j].hash, key);
+            }
+            ++count;
+        }
+    }
+    return count;
+}
+
+// 并行执行任务
+void WalRecovery::parallel_for(size_t tasks, const std::function<void(size_t)>& fn)
+{
+    size_t n = threads_ < tasks ? threads_ : tasks;
+    if (n <= 1)
+    {
+        for (size_t i = 0; i < tasks; ++i)
+        {
+            fn(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto worker = [&]() {
+        try {
+            for (size_t i = next.fetch_add(1); i < tasks; i = next.fetch_add(1))
+            {
+                fn(i);
+            }
+        } catch (...) {
+            // 让其他线程尽快结束，异常在调用线程中重新抛出
+            next.store(tasks);
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(n - 1);
+    for (size_t t = 1; t < n; ++t)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (size_t t = 0; t < workers.size(); ++t)
+    {
+        workers[t].join();
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
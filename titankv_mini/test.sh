@@ -8,33 +8,137 @@ GREEN='\033[0;32m'
 YELLOW='\033[1;33m'
 NC='\033[0m' # No Color
 
+PORT=6380
+FAILED=0
+
 # 测试函数
 test_command() {
     local cmd="$1"
     local expected="$2"
-    
+
     echo -e "${YELLOW}测试: $cmd${NC}"
-    response=$(echo "$cmd" | nc -w 2 localhost 6380)
-    
+    # 末尾加一个x再去掉，保留响应末尾的换行
+    response=$(echo "$cmd" | nc -w 2 localhost $PORT; echo x)
+    response="${response%x}"
+
     if [[ "$response" == *"$expected"* ]]; then
         echo -e "${GREEN}✓ 通过${NC}"
         return 0
     else
         echo -e "${RED}✗ 失败 - 期望: $expected, 实际: $response${NC}"
+        FAILED=$((FAILED + 1))
+        return 1
+    fi
+}
+
+# 不应出现在响应中的内容
+test_absent() {
+    local cmd="$1"
+    local unexpected="$2"
+
+    echo -e "${YELLOW}测试: $cmd (不包含 $unexpected)${NC}"
+    response=$(echo "$cmd" | nc -w 2 localhost $PORT)
+
+    if [[ -n "$response" && "$response" != *"$unexpected"* ]]; then
+        echo -e "${GREEN}✓ 通过${NC}"
+        return 0
+    else
+        echo -e "${RED}✗ 失败 - 不应包含: $unexpected, 实际: $response${NC}"
+        FAILED=$((FAILED + 1))
         return 1
     fi
 }
 
+# 发送原始字节(RESP等)，data中的\r\n等转义按printf %b解释
+test_raw() {
+    local name="$1"
+    local data="$2"
+    local expected="$3"
+
+    echo -e "${YELLOW}测试: $name${NC}"
+    response=$(printf '%b' "$data" | nc -w 2 localhost $PORT; echo x)
+    response="${response%x}"
+
+    if [[ "$response" == *"$expected"* ]]; then
+        echo -e "${GREEN}✓ 通过${NC}"
+        return 0
+    else
+        echo -e "${RED}✗ 失败 - 期望: $(printf '%q' "$expected"), 实际: $(printf '%q' "$response")${NC}"
+        FAILED=$((FAILED + 1))
+        return 1
+    fi
+}
+
+# 检查条件
+check() {
+    local name="$1"
+    shift
+
+    echo -e "${YELLOW}测试: $name${NC}"
+    if "$@"; then
+        echo -e "${GREEN}✓ 通过${NC}"
+    else
+        echo -e "${RED}✗ 失败${NC}"
+        FAILED=$((FAILED + 1))
+    fi
+}
+
+# 启动服务器，参数是额外的选项；每次确认前都fdatasync，强制停止时也不会丢失已确认的写入
+# 控制台从命名管道读取命令：读到EOF时控制台循环会不停地输出提示符
+start_server() {
+    rm -f server.in
+    mkfifo server.in
+    exec 5<>server.in
+    ./titankv_mini $PORT wal.log --wal-sync always "$@" < server.in >> server.log 2>&1 &
+    SERVER_PID=$!
+    sleep 2
+}
+
+# 通过控制台停止服务器；正常退出超时时强制结束
+stop_server() {
+    echo quit >&5
+    for i in $(seq 1 50); do
+        kill -0 $SERVER_PID 2>/dev/null || break
+        sleep 0.1
+    done
+    kill -9 $SERVER_PID 2>/dev/null
+    wait $SERVER_PID 2>/dev/null
+    exec 5>&-
+    rm -f server.in
+}
+
+# 删除日志段和快照
+clean_data() {
+    rm -f wal.log wal.log.[0-9]* wal.log.snapshot wal.log.snapshot.tmp
+}
+
+# 包含给定内容的日志文件
+segment_with() {
+    grep -l -a "$1" wal.log wal.log.[0-9]* 2>/dev/null | head -1
+}
+
+# 在一个连接上逐条写入：SET <prefix><i> <value>，i从first到last，value默认是v
+bulk_set() {
+    local prefix="$1" first="$2" last="$3" value="${4:-v}" i line
+    exec 4<>/dev/tcp/localhost/$PORT
+    for ((i = first; i <= last; i++)); do
+        echo "SET $prefix$i $value" >&4
+        read -r -t 10 line <&4 || break
+    done
+    exec 4<&-
+}
+
+# INFO某一节中字段的值
+info_field() {
+    echo "INFO $1" | nc -w 2 localhost $PORT | grep "^$2:" | cut -d: -f2 | tr -d '\r'
+}
+
 # 清理旧文件
-rm -f wal.log
+clean_data
 
 # 启动服务器
 echo "启动服务器..."
-./titankv_mini 6380 wal.log > server.log 2>&1 &
-SERVER_PID=$!
-
-# 等待服务器启动
-sleep 2
+start_server
 
 # 测试基本功能
 echo "运行测试..."
@@ -48,24 +152,311 @@ test_command "GET nonexistent" "NOT_FOUND"
 test_command "INVALID_COMMAND" "ERR"
 
 # 停止服务器
-kill $SERVER_PID
-wait $SERVER_PID
+stop_server
 
 # 重启服务器测试数据持久化
 echo "测试数据持久化..."
-./titankv_mini 6380 wal.log > server2.log 2>&1 &
-SERVER_PID=$!
-sleep 2
+start_server
 
 test_command "GET test2" "value2"
+test_command "GET test1" "NOT_FOUND"
 
 # 停止服务器
-kill $SERVER_PID
-wait $SERVER_PID
+stop_server
+
+# TTL：到期的键由清理线程删除，不需要读取；刷新TTL沿用原来的定时器，到期时按新的过期时间重新挂上
+echo "测试TTL过期..."
+clean_data
+start_server
+test_command $'SET short v TTL 1\nSET refreshed v TTL 2\nSET refreshed v TTL 10\nSET persistent v TTL 2\nSET persistent v' $'OK\nOK\nOK\nOK\nOK\n'
+sleep 3
+test_command "GET refreshed" "v"
+test_command "GET persistent" "v"
+sleep 8
+test_command "INFO keyspace" $'# Keyspace\nkeys:1\n'
+test_command "INFO stats" "expired_keys:2"
+test_command "GET persistent" "v"
+test_command $'SET session v TTL 100\nSET session v TTL 100\nSET session v TTL 100' $'OK\nOK\nOK\n'
+# 控制台的stats输出待处理的定时器数量(退出时才写入日志)：反复刷新的键只有一个定时器
+echo stats >&5
+stop_server
+timers=$(grep 'Pending TTL timers' server.log | tail -1 | awk '{print $NF}')
+check "刷新TTL不堆积定时器(实际 $timers)" test "$timers" = 1
+
+# 日志中间的记录损坏：恢复到损坏记录之前为止，之后的记录都不重放
+echo "测试WAL损坏记录..."
+clean_data
+start_server
+test_command "SET keep1 v" "OK"
+test_command "SET victim CORRUPT_MARKER_VALUE" "OK"
+test_command "SET after_corrupt v" "OK"
+stop_server
+segment=$(segment_with CORRUPT_MARKER_VALUE)
+offset=$(grep -obUa CORRUPT_MARKER_VALUE "$segment" | head -1 | cut -d: -f1)
+printf 'X' | dd of="$segment" bs=1 seek=$((offset + 3)) conv=notrunc 2>/dev/null
+start_server
+test_command "GET keep1" "v"
+test_command "GET victim" "NOT_FOUND"
+test_command "GET after_corrupt" "NOT_FOUND"
+# 恢复后的写入接在有效记录之后，再次重启仍然存在
+test_command "SET written_after_recovery v" "OK"
+stop_server
+start_server
+test_command "GET keep1" "v"
+test_command "GET written_after_recovery" "v"
+stop_server
+
+# 写了一半的最后一条记录：丢弃这条记录，之前的记录照常恢复
+echo "测试WAL写了一半的记录..."
+clean_data
+start_server
+test_command "SET keep2 v" "OK"
+test_command "SET torn TORN_MARKER_VALUE_0123456789" "OK"
+stop_server
+segment=$(segment_with TORN_MARKER_VALUE)
+offset=$(grep -obUa TORN_MARKER_VALUE "$segment" | head -1 | cut -d: -f1)
+dd if=/dev/zero of="$segment" bs=1 seek=$((offset + 5)) count=64 conv=notrunc 2>/dev/null
+start_server
+test_command "GET keep2" "v"
+test_command "GET torn" "NOT_FOUND"
+stop_server
+
+# 快照之后继续写入，重启后应当同时恢复快照和之后的日志
+echo "测试快照和WAL重放..."
+clean_data
+start_server
+test_command "SET snap1 a" "OK"
+test_command "SET snap2 b" "OK"
+test_command "SAVE" "OK"
+check "生成快照文件" test -s wal.log.snapshot
+test_command "SET after1 x" "OK"
+test_command "DEL snap2" "OK"
+test_command "SET ttl v TTL 100" "OK"
+stop_server
+start_server
+test_command "GET snap1" "a"
+test_command "GET snap2" "NOT_FOUND"
+test_command "GET after1" "x"
+test_command "GET ttl" "v"
+stop_server
+
+# 段写满后切换到新的段，重启时所有段按顺序重放
+echo "测试WAL分段..."
+clean_data
+start_server --wal-segment-size 4096
+bulk_set seg: 1 300
+test_command "DEL seg:1" "OK"
+stop_server
+segments=$(ls wal.log.[0-9]* 2>/dev/null | wc -l)
+check "日志分成多个段(实际 $segments)" test "$segments" -gt 1
+start_server --wal-segment-size 4096
+test_command "GET seg:1" "NOT_FOUND"
+test_command "GET seg:2" "v"
+test_command "GET seg:300" "v"
+stop_server
+
+# io_uring后端：写入、段切换和重启恢复与同步后端一致，同步后端也能继续使用它写的日志
+echo "测试io_uring WAL..."
+clean_data
+start_server --wal-io io_uring --wal-segment-size 4096
+test_command "MSET ua 1 ub 2" "OK"
+bulk_set uring: 1 300
+test_command "DEL uring:1" "OK"
+test_command "SET uttl v TTL 100" "OK"
+stop_server
+start_server --wal-io io_uring --wal-segment-size 4096
+test_command "MGET ua ub uring:1 uring:300 uttl" $'1\n2\nNOT_FOUND\nv\nv\n'
+test_command "SET after_restart v" "OK"
+stop_server
+start_server --wal-segment-size 4096
+test_command "GET after_restart" "v"
+test_command "GET uring:300" "v"
+stop_server
+
+# 中间的段损坏而之后的段还有记录：拒绝启动，不能跳过缺口继续重放
+echo "测试中间的WAL段损坏..."
+clean_data
+start_server --wal-segment-size 4096
+test_command "SET gap_victim GAP_MARKER_VALUE" "OK"
+bulk_set gap: 1 300
+stop_server
+segment=$(segment_with GAP_MARKER_VALUE)
+offset=$(grep -obUa GAP_MARKER_VALUE "$segment" | head -1 | cut -d: -f1)
+printf 'X' | dd of="$segment" bs=1 seek=$((offset + 3)) conv=notrunc 2>/dev/null
+start_server --wal-segment-size 4096
+kill -0 $SERVER_PID 2>/dev/null
+check "服务器拒绝启动" test $? -ne 0
+check "日志说明了原因" grep -q "refusing to replay past the gap" server.log
+stop_server
+
+# RESP协议
+echo "测试RESP协议..."
+clean_data
+start_server
+test_raw "RESP SET/GET" '*3\r\n$3\r\nSET\r\n$4\r\nresp\r\n$5\r\nva lu\r\n*2\r\n$3\r\nGET\r\n$4\r\nresp\r\n' $'+OK\r\n$5\r\nva lu\r\n'
+test_raw "RESP GET不存在的键" '*2\r\n$3\r\nGET\r\n$7\r\nmissing\r\n' $'$-1\r\n'
+test_raw "RESP PING/ECHO/EXISTS" '*1\r\n$4\r\nPING\r\n*2\r\n$4\r\nECHO\r\n$2\r\nhi\r\n*3\r\n$6\r\nEXISTS\r\n$4\r\nresp\r\n$1\r\nz\r\n' $'+PONG\r\n$2\r\nhi\r\n:1\r\n'
+test_raw "RESP SET EX" '*5\r\n$3\r\nSET\r\n$3\r\nttl\r\n$1\r\nv\r\n$2\r\nEX\r\n$3\r\n100\r\n' $'+OK\r\n'
+test_raw "RESP 未知命令" '*1\r\n$4\r\nNOPE\r\n' "-ERR"
+test_raw "RESP 参数个数错误" '*1\r\n$3\r\nGET\r\n' "-ERR wrong number of arguments"
+
+# 一条命令分多次到达：解析器保留已解析的部分，数据到齐后才执行
+echo -e "${YELLOW}测试: RESP 命令分多次到达${NC}"
+response=$( { printf '*3\r\n$3\r\nSE'; sleep 0.3; printf 'T\r\n$5\r\nsplit\r\n$6\r\nval'; sleep 0.3; printf 'ue1\r'; sleep 0.3; printf '\n*2\r\n$3\r\nGET\r\n$5\r\nsplit\r\n'; } | nc -w 2 localhost $PORT; echo x)
+response="${response%x}"
+if [[ "$response" == $'+OK\r\n$6\r\nvalue1\r\n' ]]; then
+    echo -e "${GREEN}✓ 通过${NC}"
+else
+    echo -e "${RED}✗ 失败 - 实际: $(printf '%q' "$response")${NC}"
+    FAILED=$((FAILED + 1))
+fi
+stop_server
+start_server
+test_raw "RESP 重启后" '*2\r\n$3\r\nGET\r\n$4\r\nresp\r\n' $'$5\r\nva lu\r\n'
+test_command "GET ttl" "v"
+stop_server
+
+# 批量命令，重启后从BATCH记录恢复
+echo "测试批量命令..."
+clean_data
+start_server
+test_command "MSET a 1 b 2 c 3" "OK"
+test_command "MGET a b missing" $'1\n2\nNOT_FOUND\n'
+test_command "MDEL a missing" "1"
+test_command "MGET a c" $'NOT_FOUND\n3\n'
+test_raw "RESP MGET" '*3\r\n$4\r\nMGET\r\n$1\r\nb\r\n$1\r\nz\r\n' $'*2\r\n$1\r\n2\r\n$-1\r\n'
+stop_server
+start_server
+test_command "MGET a b c" $'NOT_FOUND\n2\n3\n'
+stop_server
+
+# 内存上限：allkeys-lru淘汰键，used_memory不超过maxmemory；淘汰记录到WAL，重启后被淘汰的键仍然不存在
+echo "测试内存上限和淘汰..."
+clean_data
+start_server --maxmemory 2000000 --maxmemory-policy allkeys-lru
+value=$(printf '%*s' 1000 '' | tr ' ' v)
+for round in 1 2 3 4; do
+    bulk_set "evict$round:" 1 1000 "$value"
+    used=$(info_field memory used_memory)
+    check "第${round}轮写入后used_memory不超过maxmemory(实际 $used)" test "$used" -le 2000000
+done
+evicted=$(info_field stats evicted_keys)
+check "淘汰了键(实际 $evicted)" test "$evicted" -gt 0
+keys=$(info_field keyspace keys)
+test_command "GET evict4:1000" "$value"
+stop_server
+start_server --maxmemory 2000000 --maxmemory-policy allkeys-lru
+recovered=$(info_field keyspace keys)
+check "重启后键数不变(之前 $keys，之后 $recovered)" test "$recovered" -eq "$keys"
+test_command "GET evict4:1000" "$value"
+stop_server
+
+# noeviction：超过上限时拒绝写入，已有的键不受影响
+clean_data
+start_server --maxmemory 2000000 --maxmemory-policy noeviction
+bulk_set full: 1 3000 "$value"
+test_command "SET one_more $value" "OOM command not allowed"
+test_command "GET full:1" "$value"
+test_command "INFO stats" "evicted_keys:0"
+stop_server
+
+# HOTKEYS(每次读写都采样)
+echo "测试HOTKEYS..."
+clean_data
+start_server --hotkey-sample-rate 1
+test_command "MSET b 2 c 3" "OK"
+test_command $'GET b\nGET b\nGET b\nGET b\nGET c' $'2\n2\n2\n2\n3\n'
+test_command "HOTKEYS 1" $'1\nb '
+test_command "HOTKEYS 0" "ERR"
+stop_server
+
+# INFO / STATS
+echo "测试INFO/STATS..."
+clean_data
+start_server
+test_command "MSET x 1 y 2 z 3" "OK"
+test_command "INFO" "# Server"
+test_command "INFO keyspace" $'# Keyspace\nkeys:3\n'
+test_command "INFO commandstats" "cmdstat_mset:calls=1,"
+test_command "STATS RESET" "OK"
+test_absent "INFO commandstats" "cmdstat_mset"
+test_raw "RESP INFO" '*2\r\n$4\r\nINFO\r\n$8\r\nkeyspace\r\n' $'# Keyspace\r\nkeys:3\r\n'
+stop_server
+
+# SCAN
+echo "测试SCAN..."
+clean_data
+start_server
+test_command "MSET scan1 a scan2 b other1 c other2 d other3 e" "OK"
+test_command "SCAN 0 COUNT 1000" $'0\n5\n'
+test_command "SCAN 0 MATCH scan* COUNT 1000" $'0\n2\nscan'
+test_command "SCAN x" "ERR invalid cursor"
+test_raw "RESP SCAN" '*4\r\n$4\r\nSCAN\r\n$1\r\n0\r\n$5\r\nCOUNT\r\n$4\r\n1000\r\n' $'*2\r\n$1\r\n0\r\n*5\r\n'
+stop_server
+
+# SCAN期间哈希表扩容：遍历开始时存在的键都要返回
+echo "测试SCAN期间扩容..."
+clean_data
+start_server
+bulk_set stable: 1 300
+exec 3<>/dev/tcp/localhost/$PORT
+: > scan_keys.txt
+cursor=0
+steps=0
+while :; do
+    echo "SCAN $cursor COUNT 50" >&3
+    read -r -t 10 cursor <&3 || break
+    read -r -t 10 count <&3 || break
+    for ((i = 0; i < count; i++)); do
+        read -r -t 10 key <&3 && echo "$key" >> scan_keys.txt
+    done
+    steps=$((steps + 1))
+    # 前几步之间写入大量新键，使各分片的哈希表扩容和迁移
+    if [ $steps -le 4 ]; then
+        bulk_set "grow$steps:" 1 2000
+    fi
+    [ "$cursor" = "0" ] && break
+done
+exec 3<&-
+seen=$(grep '^stable:' scan_keys.txt | sort -u | wc -l)
+check "SCAN在扩容期间返回全部300个原有的键(实际 $seen)" test "$seen" -eq 300
+stop_server
+rm -f scan_keys.txt
+
+# 有序索引：未启用时拒绝RANGE；启用后RANGE两端都包含，PREFIX按前缀，AFTER分页
+echo "测试RANGE/PREFIX..."
+clean_data
+start_server
+test_command "RANGE a z" "ERR ordered index is disabled"
+test_command "INFO keyspace" "ordered_index:off"
+stop_server
+start_server --ordered-index on
+test_command "MSET user:1:name x user:1:mail x user:2:name x user:10:name x" "OK"
+test_command "RANGE user:1 user:2" $'3\nuser:10:name\nuser:1:mail\nuser:1:name\n'
+test_command "PREFIX user:1: LIMIT 5" $'2\nuser:1:mail\nuser:1:name\n'
+test_command "PREFIX user: LIMIT 2 AFTER user:1:name" $'1\nuser:2:name\n'
+test_command "RANGE a b LIMIT 0" "ERR"
+test_raw "RESP PREFIX" '*2\r\n$6\r\nPREFIX\r\n$6\r\nuser:2\r\n' $'*1\r\n$11\r\nuser:2:name\r\n'
+# 重启后从快照和日志重建索引
+test_command "SAVE" "OK"
+test_command "MDEL user:2:name" "1"
+test_command "SET user:3:name x" "OK"
+stop_server
+start_server --ordered-index on
+test_command "PREFIX user: LIMIT 10" $'4\nuser:10:name\nuser:1:mail\nuser:1:name\nuser:3:name\n'
+test_command "INFO keyspace" "ordered_index_keys:4"
+stop_server
 
-echo -e "${GREEN}所有测试完成!${NC}"
 echo "服务器日志:"
 cat server.log 2>/dev/null || echo "无日志"
 
 # 清理
-rm -f server.log server2.log
\ No newline at end of file
+rm -f server.log
+clean_data
+
+if [ $FAILED -eq 0 ]; then
+    echo -e "${GREEN}所有测试完成!${NC}"
+else
+    echo -e "${RED}$FAILED 个测试失败${NC}"
+    exit 1
+fi